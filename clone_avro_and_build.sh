@@ -85,6 +85,9 @@ fi
 
 $PYTHON setup.py build
 
+# optional: needs python-config for the embedded interpreter
+PYTHON=$PYTHON examples/build_native_benchmark.sh || echo "native benchmark not built"
+
 cd build/lib*/pyavroc
 
 cd $MYDIR
@@ -0,0 +1,302 @@
+#!/usr/bin/env python
+
+"""Time reading, writing, serializing, deserializing and validating over a
+range of schema shapes and codecs, and write the results as JSON so they
+can be compared between releases."""
+
+from __future__ import print_function
+
+import sys
+import os
+import gc
+import json
+import random
+import shutil
+import tempfile
+import argparse
+import platform
+import resource
+import timeit
+
+import pyavroc
+
+CODECS = ['null', 'deflate', 'snappy', 'lzma']
+
+
+def _record(name, fields):
+    return {"type": "record", "name": name,
+            "fields": [{"name": n, "type": t} for n, t in fields]}
+
+
+def wide_shape(rnd):
+    fields = []
+    for i in range(50):
+        fields.append(('f%d' % i, ['int', 'string', 'double'][i % 3]))
+
+    def make():
+        rec = {}
+        for i in range(50):
+            if i % 3 == 0:
+                rec['f%d' % i] = rnd.randint(-1000000, 1000000)
+            elif i % 3 == 1:
+                rec['f%d' % i] = 'value %d' % rnd.randint(0, 1000)
+            else:
+                rec['f%d' % i] = rnd.random()
+        return rec
+
+    return _record('Wide', fields), make
+
+
+def deep_shape(rnd):
+    depth = 10
+    schema = _record('Level%d' % depth, [('value', 'long')])
+    for i in reversed(range(depth)):
+        schema = _record('Level%d' % i, [('value', 'long'), ('child', schema)])
+
+    def make():
+        rec = {'value': rnd.randint(0, 1 << 40)}
+        top = rec
+        for i in range(depth):
+            rec['child'] = {'value': rnd.randint(0, 1 << 40)}
+            rec = rec['child']
+        return top
+
+    return schema, make
+
+
+def map_shape(rnd):
+    schema = _record('Counts', [('counts', {"type": "map", "values": "long"})])
+
+    def make():
+        return {'counts': dict(('key%d' % i, rnd.randint(0, 1 << 30))
+                               for i in range(100))}
+
+    return schema, make
+
+
+def doubles_shape(rnd):
+    schema = _record('Series',
+                     [('values', {"type": "array", "items": "double"})])
+
+    def make():
+        return {'values': [rnd.random() for i in range(100)]}
+
+    return schema, make
+
+
+def ints_shape(rnd):
+    schema = _record('Counters',
+                     [('small', {"type": "array", "items": "int"}),
+                      ('large', {"type": "array", "items": "long"})])
+
+    def make():
+        return {'small': [rnd.randint(-60, 60) for i in range(100)],
+                'large': [rnd.randint(0, 1 << 40) for i in range(100)]}
+
+    return schema, make
+
+
+def unions_shape(rnd):
+    branches = ['null', 'int', 'string', 'double']
+    schema = _record('Sparse', [('u%d' % i, branches) for i in range(10)])
+    values = [lambda: None, lambda: rnd.randint(0, 1000),
+              lambda: 'text %d' % rnd.randint(0, 1000), rnd.random]
+
+    def make():
+        return dict(('u%d' % i, rnd.choice(values)()) for i in range(10))
+
+    return schema, make
+
+
+def strings_shape(rnd):
+    schema = _record('Text', [('s%d' % i, 'string') for i in range(10)])
+    words = ['alpha', 'beta', 'gamma', 'delta', 'epsilon', u'\u00e9t\u00e9']
+
+    def make():
+        return dict(('s%d' % i, ' '.join(rnd.choice(words) for j in range(8)))
+                    for i in range(10))
+
+    return schema, make
+
+
+SHAPES = {
+    'wide': wide_shape,
+    'deep': deep_shape,
+    'map': map_shape,
+    'doubles': doubles_shape,
+    'ints': ints_shape,
+    'unions': unions_shape,
+    'strings': strings_shape,
+}
+
+
+def peak_rss_mb():
+    rss = resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+    # kilobytes on Linux, bytes on macOS
+    if sys.platform == 'darwin':
+        return rss / (1024.0 * 1024.0)
+    return rss / 1024.0
+
+
+class Suite(object):
+
+    def __init__(self, args):
+        self.args = args
+        self.results = []
+        if args.data_dir:
+            # keep the files, e.g. for examples/native_benchmark.c
+            self.dirname = args.data_dir
+            if not os.path.isdir(self.dirname):
+                os.makedirs(self.dirname)
+        else:
+            self.dirname = tempfile.mkdtemp()
+
+    def close(self):
+        if not self.args.data_dir:
+            shutil.rmtree(self.dirname)
+
+    def time(self, fn):
+        """Best and median of the repeated runs, after the warmup runs."""
+        for i in range(self.args.warmup):
+            fn()
+        timings = []
+        for i in range(self.args.repeat):
+            gc.collect()
+            t0 = timeit.default_timer()
+            fn()
+            timings.append(timeit.default_timer() - t0)
+        timings.sort()
+        return timings[0], timings[len(timings) // 2]
+
+    def run(self, op, shape, fn, nrecords, nbytes, **params):
+        best, median = self.time(fn)
+        result = {
+            'op': op,
+            'shape': shape,
+            'records': nrecords,
+            'bytes': nbytes,
+            'best_seconds': best,
+            'median_seconds': median,
+            'records_per_sec': nrecords / best,
+            'mb_per_sec': nbytes / best / (1024.0 * 1024.0),
+            'peak_rss_mb': peak_rss_mb(),
+        }
+        result.update(params)
+        self.results.append(result)
+        print('%-14s %-8s %-36s %12.0f rec/s %8.1f MB/s' % (
+            op, shape, ' '.join('%s=%s' % kv for kv in sorted(params.items())),
+            result['records_per_sec'], result['mb_per_sec']))
+
+    def run_shape(self, name):
+        rnd = random.Random(42)
+        schema, make = SHAPES[name](rnd)
+        schema = json.dumps(schema)
+        records = [make() for i in range(self.args.records)]
+        n = len(records)
+
+        serializer = pyavroc.AvroSerializer(schema)
+        datums = [serializer.serialize(rec) for rec in records]
+        nbytes = sum(len(d) for d in datums)
+
+        self.run('serialize', name,
+                 lambda: [serializer.serialize(rec) for rec in records],
+                 n, nbytes)
+        self.run('serialize_many', name,
+                 lambda: serializer.serialize_many(records), n, nbytes)
+
+        for types in (False, True):
+            deserializer = pyavroc.AvroDeserializer(schema, types=types)
+            self.run('deserialize', name,
+                     lambda: [deserializer.deserialize(d) for d in datums],
+                     n, nbytes, types=types)
+
+        self.run('validate', name,
+                 lambda: [pyavroc.validate(rec, schema) for rec in records],
+                 n, nbytes)
+        validator = pyavroc.Schema(schema).validator()
+        self.run('validate_many', name,
+                 lambda: validator.validate_many(records), n, nbytes)
+
+        for codec in self.args.codecs:
+            filename = os.path.join(self.dirname, '%s-%s.avro' % (name, codec))
+
+            def write():
+                with open(filename, 'wb') as fp:
+                    writer = pyavroc.AvroFileWriter(fp, schema, codec=codec)
+                    for rec in records:
+                        writer.write(rec)
+                    writer.close()
+
+            try:
+                write()
+            except (IOError, ValueError) as e:
+                print('skipping codec %s: %s' % (codec, e), file=sys.stderr)
+                continue
+
+            self.run('write', name, write, n, nbytes, codec=codec,
+                     file_bytes=os.path.getsize(filename))
+
+            for types in (False, True):
+                def read():
+                    with open(filename, 'rb') as fp:
+                        reader = pyavroc.AvroFileReader(fp, types=types)
+                        for rec in reader:
+                            pass
+
+                self.run('read', name, read, n, nbytes, codec=codec,
+                         types=types, file_bytes=os.path.getsize(filename))
+
+            if name in ('ints', 'doubles'):
+                def read_typed():
+                    with open(filename, 'rb') as fp:
+                        reader = pyavroc.AvroFileReader(fp, typed_arrays=True)
+                        for rec in reader:
+                            pass
+
+                self.run('read', name, read_typed, n, nbytes, codec=codec,
+                         typed_arrays=True,
+                         file_bytes=os.path.getsize(filename))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('--records', type=int, default=20000,
+                        help='records per dataset')
+    parser.add_argument('--repeat', type=int, default=5,
+                        help='timed runs per benchmark')
+    parser.add_argument('--warmup', type=int, default=1,
+                        help='untimed runs before the timed ones')
+    parser.add_argument('--shapes', nargs='+', choices=sorted(SHAPES),
+                        default=sorted(SHAPES))
+    parser.add_argument('--codecs', nargs='+', choices=CODECS, default=CODECS)
+    parser.add_argument('--output', help='write JSON results here')
+    parser.add_argument('--data-dir',
+                        help='write the data files here and keep them')
+    args = parser.parse_args()
+
+    suite = Suite(args)
+    try:
+        for name in args.shapes:
+            suite.run_shape(name)
+    finally:
+        suite.close()
+
+    report = {
+        'pyavroc_version': pyavroc.__version__,
+        'python_version': platform.python_version(),
+        'platform': platform.platform(),
+        'records': args.records,
+        'repeat': args.repeat,
+        'warmup': args.warmup,
+        'results': suite.results,
+    }
+    if args.output:
+        with open(args.output, 'w') as fp:
+            json.dump(report, fp, indent=2, sort_keys=True)
+    else:
+        json.dump(report, sys.stdout, indent=2, sort_keys=True)
+        print()
+
+
+if __name__ == '__main__':
+    main()
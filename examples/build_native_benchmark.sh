@@ -0,0 +1,40 @@
+#!/bin/sh
+
+# Build examples/native_benchmark.c against the extension's conversion
+# sources, with the same PYAVROC_CFLAGS and LDFLAGS as setup.py, and an
+# embedded Python interpreter.  examples/varint_benchmark.c is built next
+# to it.
+#
+# Usage: examples/build_native_benchmark.sh [OUTPUT]
+
+set -eux
+
+cd $(dirname "$0")/..
+
+PYTHON=${PYTHON:-python}
+PYTHON_CONFIG=${PYTHON_CONFIG:-$PYTHON-config}
+CC=${CC:-cc}
+OUTPUT=${1:-build/native_benchmark}
+
+# python >= 3.8 needs --embed to link libpython
+PYLIBS=$($PYTHON_CONFIG --ldflags --embed 2>/dev/null || $PYTHON_CONFIG --ldflags)
+
+# PYAVROC_LIBS are library names, as for setup.py
+EXTRA_LIBS=
+for lib in ${PYAVROC_LIBS:-}
+do
+    EXTRA_LIBS="$EXTRA_LIBS -l$lib"
+done
+
+mkdir -p $(dirname $OUTPUT)
+
+$CC -O2 -g ${PYAVROC_CFLAGS:-} $($PYTHON_CONFIG --includes) -Isrc \
+    examples/native_benchmark.c \
+    src/convert.c src/record.c src/avroenum.c src/validator.c \
+    src/strcache.c src/varint.c src/util.c src/error.c \
+    ${LDFLAGS:-} -lavro -lz -lpthread $EXTRA_LIBS $PYLIBS \
+    -o $OUTPUT
+
+$CC -O2 -g ${PYAVROC_CFLAGS:-} -Isrc \
+    examples/varint_benchmark.c src/varint.c \
+    -o $(dirname $OUTPUT)/varint_benchmark
@@ -0,0 +1,401 @@
+/*
+ * Copyright 2015 Byhiras (Europe) Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Where does the time go: avro-c, or pyavroc's conversion to and from
+ * Python?  Runs the records of an Avro file through each stage separately:
+ *
+ *   decode            avro_value_read alone
+ *   decode+traverse   plus visiting every leaf through the generic value API
+ *   decode+to_python  plus avro_to_python, as dicts and as AvroTypes
+ *   encode            avro_value_write alone
+ *   from_python+encode  python_to_avro, then avro_value_write
+ *
+ * Usage: native_benchmark FILE.avro [REPEAT]
+ *
+ * Built by build_native_benchmark.sh against the extension's own sources,
+ * with an embedded interpreter for the conversion stages.
+ */
+
+#include "Python.h"
+#include "avro.h"
+#include "convert.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct {
+    avro_schema_t schema;
+    avro_value_iface_t *iface;
+    char *data;           /* all records, binary encoded back to back */
+    size_t *offsets;      /* count + 1 of them */
+    char *out;            /* where the encode stages write */
+    size_t count;
+    avro_value_t *values; /* decoded, for the encode stage */
+    PyObject *dicts;      /* converted, for the from_python stage */
+} Dataset;
+
+typedef int (*stage_fn)(Dataset *ds, ConvertInfo *info);
+
+static double
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void
+die(const char *what)
+{
+    if (PyErr_Occurred()) {
+        PyErr_Print();
+    }
+    fprintf(stderr, "%s: %s\n", what, avro_strerror());
+    exit(1);
+}
+
+static int
+load(const char *path, Dataset *ds)
+{
+    avro_file_reader_t file;
+    avro_value_t value;
+    avro_writer_t writer;
+    size_t data_size = 1 << 20;
+    size_t offsets_size = 1024;
+    size_t size;
+    size_t pos = 0;
+
+    if (avro_file_reader(path, &file)) {
+        return -1;
+    }
+    ds->schema = avro_schema_incref(avro_file_reader_get_writer_schema(file));
+    ds->iface = avro_generic_class_from_schema(ds->schema);
+    if (ds->iface == NULL) {
+        return -1;
+    }
+
+    ds->data = (char *)malloc(data_size);
+    ds->offsets = (size_t *)malloc(offsets_size * sizeof(size_t));
+    ds->count = 0;
+    writer = avro_writer_memory(ds->data, data_size);
+    avro_generic_value_new(ds->iface, &value);
+
+    while (avro_file_reader_read_value(file, &value) == 0) {
+        if (avro_value_sizeof(&value, &size)) {
+            return -1;
+        }
+        if (pos + size > data_size) {
+            while (pos + size > data_size) {
+                data_size *= 2;
+            }
+            ds->data = (char *)realloc(ds->data, data_size);
+        }
+        if (ds->count + 2 > offsets_size) {
+            offsets_size *= 2;
+            ds->offsets = (size_t *)realloc(ds->offsets,
+                                            offsets_size * sizeof(size_t));
+        }
+        avro_writer_memory_set_dest(writer, ds->data + pos, size);
+        if (avro_value_write(writer, &value)) {
+            return -1;
+        }
+        ds->offsets[ds->count++] = pos;
+        pos += size;
+    }
+    ds->offsets[ds->count] = pos;
+    ds->out = (char *)malloc(pos ? pos : 1);
+
+    avro_value_decref(&value);
+    avro_writer_free(writer);
+    avro_file_reader_close(file);
+    return 0;
+}
+
+/* touch every leaf, roughly what avro_to_python does minus the objects */
+static size_t
+traverse(avro_value_t *value)
+{
+    size_t n = 0;
+    size_t size;
+    size_t i;
+    avro_value_t child;
+    const void *buf;
+    const char *str;
+    int32_t i32;
+    int64_t i64;
+    float f;
+    double d;
+    int b;
+
+    switch (avro_value_get_type(value)) {
+    case AVRO_STRING:
+        avro_value_get_string(value, &str, &size);
+        return size;
+    case AVRO_BYTES:
+        avro_value_get_bytes(value, &buf, &size);
+        return size;
+    case AVRO_FIXED:
+        avro_value_get_fixed(value, &buf, &size);
+        return size;
+    case AVRO_INT32:
+        avro_value_get_int(value, &i32);
+        return (size_t)i32 & 1;
+    case AVRO_INT64:
+        avro_value_get_long(value, &i64);
+        return (size_t)i64 & 1;
+    case AVRO_FLOAT:
+        avro_value_get_float(value, &f);
+        return f > 0;
+    case AVRO_DOUBLE:
+        avro_value_get_double(value, &d);
+        return d > 0;
+    case AVRO_BOOLEAN:
+        avro_value_get_boolean(value, &b);
+        return b;
+    case AVRO_ENUM:
+        avro_value_get_enum(value, &b);
+        return b;
+    case AVRO_NULL:
+        return 0;
+    case AVRO_UNION:
+        avro_value_get_current_branch(value, &child);
+        return traverse(&child);
+    case AVRO_ARRAY:
+    case AVRO_MAP:
+    case AVRO_RECORD:
+        avro_value_get_size(value, &size);
+        for (i = 0; i < size; i++) {
+            avro_value_get_by_index(value, i, &child, NULL);
+            n += traverse(&child);
+        }
+        return n;
+    default:
+        return 0;
+    }
+}
+
+static volatile size_t sink;
+
+/* decode each record, then apply stage (which may be NULL) */
+static int
+decode_each(Dataset *ds, ConvertInfo *info, int mode)
+{
+    avro_reader_t reader = avro_reader_memory(ds->data, 0);
+    avro_value_t value;
+    size_t i;
+    size_t n = 0;
+    PyObject *pyobj;
+
+    avro_generic_value_new(ds->iface, &value);
+    for (i = 0; i < ds->count; i++) {
+        avro_reader_memory_set_source(reader, ds->data + ds->offsets[i],
+                                      ds->offsets[i + 1] - ds->offsets[i]);
+        if (avro_value_read(reader, &value)) {
+            return -1;
+        }
+        if (mode == 1) {
+            n += traverse(&value);
+        } else if (mode == 2) {
+            pyobj = avro_to_python(info, &value);
+            if (pyobj == NULL) {
+                return -1;
+            }
+            Py_DECREF(pyobj);
+        }
+    }
+    sink = n;
+    avro_value_decref(&value);
+    avro_reader_free(reader);
+    return 0;
+}
+
+static int
+stage_decode(Dataset *ds, ConvertInfo *info)
+{
+    return decode_each(ds, info, 0);
+}
+
+static int
+stage_traverse(Dataset *ds, ConvertInfo *info)
+{
+    return decode_each(ds, info, 1);
+}
+
+static int
+stage_to_python(Dataset *ds, ConvertInfo *info)
+{
+    return decode_each(ds, info, 2);
+}
+
+static int
+write_each(Dataset *ds, avro_value_t *value, avro_writer_t writer, size_t i)
+{
+    avro_writer_memory_set_dest(writer, ds->out + ds->offsets[i],
+                                ds->offsets[i + 1] - ds->offsets[i]);
+    return avro_value_write(writer, value);
+}
+
+static int
+stage_encode(Dataset *ds, ConvertInfo *info)
+{
+    avro_writer_t writer = avro_writer_memory(ds->out, 0);
+    size_t i;
+
+    for (i = 0; i < ds->count; i++) {
+        if (write_each(ds, &ds->values[i], writer, i)) {
+            return -1;
+        }
+    }
+    avro_writer_free(writer);
+    return 0;
+}
+
+static int
+stage_from_python(Dataset *ds, ConvertInfo *info)
+{
+    avro_writer_t writer = avro_writer_memory(ds->out, 0);
+    avro_value_t value;
+    size_t i;
+
+    avro_generic_value_new(ds->iface, &value);
+    for (i = 0; i < ds->count; i++) {
+        avro_value_reset(&value);
+        if (python_to_avro(NULL, PyList_GET_ITEM(ds->dicts, i), &value)
+            || write_each(ds, &value, writer, i)) {
+            return -1;
+        }
+    }
+    avro_value_decref(&value);
+    avro_writer_free(writer);
+    return 0;
+}
+
+static void
+prepare(Dataset *ds)
+{
+    avro_reader_t reader = avro_reader_memory(ds->data, 0);
+    ConvertInfo info = { NULL };
+    PyObject *pyobj;
+    size_t i;
+
+    ds->values = (avro_value_t *)malloc(ds->count * sizeof(avro_value_t));
+    ds->dicts = PyList_New(ds->count);
+    if (ds->values == NULL || ds->dicts == NULL) {
+        die("out of memory");
+    }
+    for (i = 0; i < ds->count; i++) {
+        avro_generic_value_new(ds->iface, &ds->values[i]);
+        avro_reader_memory_set_source(reader, ds->data + ds->offsets[i],
+                                      ds->offsets[i + 1] - ds->offsets[i]);
+        if (avro_value_read(reader, &ds->values[i])) {
+            die("decoding");
+        }
+        pyobj = avro_to_python(&info, &ds->values[i]);
+        if (pyobj == NULL) {
+            die("converting");
+        }
+        PyList_SET_ITEM(ds->dicts, i, pyobj);
+    }
+    avro_reader_free(reader);
+}
+
+/* time the best of repeat runs, compared to the base stage if given */
+static double
+run(const char *name, stage_fn fn, Dataset *ds, ConvertInfo *info,
+    int repeat, const char *base_name, double base)
+{
+    double best = 0.0;
+    double t;
+    int i;
+
+    if (fn(ds, info)) {  /* warmup */
+        die(name);
+    }
+    for (i = 0; i < repeat; i++) {
+        t = now();
+        if (fn(ds, info)) {
+            die(name);
+        }
+        t = now() - t;
+        if (i == 0 || t < best) {
+            best = t;
+        }
+    }
+
+    printf("%-24s %9.4f s %9.0f ns/rec %9.1f MB/s", name, best,
+           best * 1e9 / ds->count,
+           ds->offsets[ds->count] / best / (1024.0 * 1024.0));
+    if (base_name != NULL) {
+        printf("   +%5.1f%% over %s", 100.0 * (best - base) / base, base_name);
+    }
+    printf("\n");
+    return best;
+}
+
+int
+main(int argc, char **argv)
+{
+    Dataset ds;
+    ConvertInfo dict_info = { NULL };
+    ConvertInfo types_info = { NULL };
+    int repeat;
+    double decode;
+    double encode;
+
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s FILE.avro [REPEAT]\n", argv[0]);
+        return 2;
+    }
+    repeat = argc > 2 ? atoi(argv[2]) : 5;
+
+    Py_Initialize();
+
+    if (load(argv[1], &ds)) {
+        die(argv[1]);
+    }
+    if (ds.count == 0) {
+        fprintf(stderr, "%s: no records\n", argv[1]);
+        return 1;
+    }
+    prepare(&ds);
+
+    types_info.types = PyObject_CallFunctionObjArgs(get_avro_types_type(), NULL);
+    if (types_info.types == NULL || declare_types(&types_info, ds.schema) == NULL) {
+        die("declaring types");
+    }
+
+    printf("%s: %zu records, %zu bytes\n", argv[1], ds.count,
+           ds.offsets[ds.count]);
+
+    decode = run("decode", stage_decode, &ds, NULL, repeat, NULL, 0.0);
+    run("decode+traverse", stage_traverse, &ds, NULL, repeat,
+        "decode", decode);
+    run("decode+to_python", stage_to_python, &ds, &dict_info, repeat,
+        "decode", decode);
+    run("decode+to_python(types)", stage_to_python, &ds, &types_info, repeat,
+        "decode", decode);
+    encode = run("encode", stage_encode, &ds, NULL, repeat, NULL, 0.0);
+    run("from_python+encode", stage_from_python, &ds, NULL, repeat,
+        "encode", encode);
+
+    Py_DECREF(types_info.types);
+    Py_DECREF(ds.dicts);
+    Py_Finalize();
+    return 0;
+}
@@ -0,0 +1,73 @@
+#!/usr/bin/env python
+
+from __future__ import print_function
+
+import random
+import datetime
+
+import pyavroc
+
+nrecords = 100000
+
+schema = '''{"namespace": "example.avro",
+ "type": "record",
+ "name": "Message",
+ "fields": [
+     {"name": "key", "type": "string"},
+     {"name": "payload", "type": "bytes"}
+ ]
+}'''
+
+
+def make_records():
+    # mostly small messages, with the occasional one of several megabytes
+    random.seed(42)
+    sizes = [min(int(100 * random.paretovariate(1.1)), 8 * 1024 * 1024)
+             for i in range(nrecords)]
+    payload = b'x' * max(sizes)
+    return [{"key": "key %d" % i, "payload": payload[:size]}
+            for i, size in enumerate(sizes)]
+
+
+def test_serialize(records):
+    print('pyavroc: serializing...')
+
+    serializer = pyavroc.AvroSerializer(schema)
+
+    max_buffer_size = 0
+    t0 = datetime.datetime.now()
+    for record in records:
+        serializer.serialize(record)
+        max_buffer_size = max(max_buffer_size, serializer.buffer_size)
+    t1 = datetime.datetime.now()
+
+    print('  buffer size: largest %d, final %d' % (max_buffer_size,
+                                                   serializer.buffer_size))
+    return t1 - t0
+
+
+def test_serialize_many(records, batch_size):
+    print('pyavroc: serializing batches of %d...' % batch_size)
+
+    serializer = pyavroc.AvroSerializer(schema)
+
+    t0 = datetime.datetime.now()
+    for i in range(0, len(records), batch_size):
+        serializer.serialize_many(records[i:i + batch_size])
+    t1 = datetime.datetime.now()
+
+    return t1 - t0
+
+
+def main():
+    records = make_records()
+    sizes = sorted(len(r['payload']) for r in records)
+    print('payload sizes: median %d, 99.9%% %d, max %d' % (
+        sizes[len(sizes) // 2], sizes[len(sizes) * 999 // 1000], sizes[-1]))
+
+    print(test_serialize(records))
+    print(test_serialize_many(records, 1000))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,188 @@
+/*
+ * Copyright 2015 Byhiras (Europe) Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Decoding long arrays of Avro ints and longs with each varint kernel
+ * this CPU supports, against the plain loop.  The values are drawn from
+ * a few ranges, since the vector kernels only help with runs of one byte
+ * encodings:
+ *
+ *   small        -64 ... 63, one byte each
+ *   mostly_small one byte, with one value in sixteen up to 2^20
+ *   medium       up to 2^13 either way, one or two bytes
+ *   timestamps   milliseconds around 2020, six bytes
+ *   random       anything, up to ten bytes (five for ints)
+ *
+ * Every kernel's output is checked against the values encoded.
+ *
+ * Usage: varint_benchmark [COUNT] [REPEAT]
+ */
+
+#include "varint.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const char *kernels[] = {"scalar", "sse4.1", "avx2"};
+
+static double
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint64_t
+next_random(uint64_t *state)
+{
+    /* xorshift64 */
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+static int64_t
+make_value(const char *range, uint64_t *state)
+{
+    uint64_t r = next_random(state);
+
+    if (strcmp(range, "small") == 0) {
+        return (int64_t)(r % 128) - 64;
+    }
+    if (strcmp(range, "mostly_small") == 0) {
+        if (r % 16 == 0) {
+            return (int64_t)((r >> 8) % (1 << 20));
+        }
+        return (int64_t)((r >> 8) % 128) - 64;
+    }
+    if (strcmp(range, "medium") == 0) {
+        return (int64_t)(r % (1 << 14)) - (1 << 13);
+    }
+    if (strcmp(range, "timestamps") == 0) {
+        return 1577836800000LL + (int64_t)(r % 31536000000ULL);
+    }
+    return (int64_t)r;
+}
+
+static size_t
+encode(int64_t l, char *out)
+{
+    uint64_t n = ((uint64_t)l << 1) ^ (uint64_t)(l >> 63);
+    size_t len = 0;
+
+    while (n & ~(uint64_t)0x7f) {
+        out[len++] = (char)((n & 0x7f) | 0x80);
+        n >>= 7;
+    }
+    out[len++] = (char)n;
+    return len;
+}
+
+static void
+run(const char *range, int width, size_t count, int repeat)
+{
+    uint64_t state = 42;
+    int64_t *values = malloc(count * sizeof(int64_t));
+    char *data = malloc(count * 10);
+    char *out = malloc(count * 8);
+    size_t len = 0;
+    size_t i;
+    size_t k;
+    int r;
+
+    if (values == NULL || data == NULL || out == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+
+    for (i = 0; i < count; i++) {
+        values[i] = make_value(range, &state);
+        if (width == 4) {
+            values[i] = (int32_t)values[i];
+        }
+        len += encode(values[i], data + len);
+    }
+
+    for (k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+        double best = 0;
+
+        if (varint_use_kernel(kernels[k])) {
+            continue;
+        }
+        for (r = 0; r < repeat; r++) {
+            const char *pos = data;
+            double start = now();
+            double elapsed;
+            int rval;
+
+            if (width == 4) {
+                rval = varint_decode_ints(&pos, data + len, (int32_t *)out, count);
+            } else {
+                rval = varint_decode_longs(&pos, data + len, (int64_t *)out, count);
+            }
+            elapsed = now() - start;
+            if (rval || pos != data + len) {
+                fprintf(stderr, "%s: decoding failed\n", kernels[k]);
+                exit(1);
+            }
+            if (r == 0 || elapsed < best) {
+                best = elapsed;
+            }
+        }
+
+        for (i = 0; i < count; i++) {
+            int64_t got = width == 4 ? ((int32_t *)out)[i] : ((int64_t *)out)[i];
+            if (got != values[i]) {
+                fprintf(stderr, "%s: item %zu is %lld, not %lld\n", kernels[k],
+                        i, (long long)got, (long long)values[i]);
+                exit(1);
+            }
+        }
+
+        printf("%-5s %-13s %-7s %8.2f bytes/item %10.1f M items/s %8.1f MB/s\n",
+               width == 4 ? "int" : "long", range, kernels[k],
+               (double)len / count, count / best * 1e-6,
+               len / best / (1024.0 * 1024.0));
+    }
+
+    free(values);
+    free(data);
+    free(out);
+}
+
+int
+main(int argc, char **argv)
+{
+    static const char *ranges[] = {"small", "mostly_small", "medium",
+                                   "timestamps", "random"};
+    size_t count = argc > 1 ? (size_t)atol(argv[1]) : 1000000;
+    int repeat = argc > 2 ? atoi(argv[2]) : 20;
+    size_t i;
+
+    for (i = 0; i < sizeof(ranges) / sizeof(ranges[0]); i++) {
+        run(ranges[i], 4, count, repeat);
+        run(ranges[i], 8, count, repeat);
+    }
+
+    varint_use_kernel("auto");
+    printf("auto: %s\n", varint_kernel_name());
+    return 0;
+}
@@ -0,0 +1,86 @@
+#!/usr/bin/env python
+
+from __future__ import print_function
+
+import sys
+import os
+import shutil
+import tempfile
+import datetime
+import multiprocessing
+
+import pyavroc
+
+nrecords = 1000000
+
+schema = '''{"namespace": "example.avro",
+ "type": "record",
+ "name": "User",
+ "fields": [
+     {"name": "name", "type": "string"},
+     {"name": "favorite_number",  "type": ["int", "null"]},
+     {"name": "favorite_color", "type": ["string", "null"]}
+ ]
+}'''
+
+
+def make_records():
+    return [{"name": "Ermintrude %d" % i, "favorite_number": i,
+             "favorite_color": "red" if i % 3 else None}
+            for i in range(nrecords)]
+
+
+def test_pyavroc_write(records, codec, threads):
+    print('pyavroc(codec=%s, threads=%d): writing file...' % (codec, threads))
+
+    with open(filename, 'wb') as fp:
+        writer = pyavroc.AvroFileWriter(fp, schema, codec=codec,
+                                        threads=threads)
+
+        t0 = datetime.datetime.now()
+        for record in records:
+            writer.write(record)
+        writer.close()
+        t1 = datetime.datetime.now()
+
+    with open(filename, 'rb') as fp:
+        n = sum(1 for _ in pyavroc.AvroFileReader(fp))
+
+    return (t1 - t0, n)
+
+
+def _micros(timing):
+    return float(timing.seconds) * 1e6 + float(timing.microseconds)
+
+
+def run_test(test_fn, base_timing=None):
+    timing, n = test_fn()
+    assert n == nrecords
+    print(timing, '(%d bytes)' % os.path.getsize(filename))
+    if base_timing:
+        print('  (%s times faster than one thread)' % (_micros(base_timing) / _micros(timing)))
+
+    return timing
+
+
+def main():
+    global filename
+
+    dirname = tempfile.mkdtemp()
+    filename = os.path.join(dirname, 'test.avro')
+
+    records = make_records()
+
+    run_test(lambda: test_pyavroc_write(records, 'null', 1))
+    base_timing = run_test(lambda: test_pyavroc_write(records, 'deflate', 1))
+    threads = 2
+    while threads <= max(2, multiprocessing.cpu_count()):
+        run_test(lambda: test_pyavroc_write(records, 'deflate', threads),
+                 base_timing)
+        threads *= 2
+
+    shutil.rmtree(dirname)
+
+
+if __name__ == '__main__':
+    main()
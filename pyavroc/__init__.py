@@ -15,5 +15,6 @@
 from ._version import __version__
 from ._pyavroc import (
     AvroFileReader, AvroFileWriter, AvroSerializer, AvroDeserializer,
-    AvroTypes, create_types, validate
+    MultiSchemaDeserializer, Schema, AvroTypes, create_types, validate,
+    set_allocator, allocator_stats
 )
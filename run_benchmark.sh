@@ -18,3 +18,15 @@ esac
 export PYTHONPATH=$(readlink -e build/lib*):$(readlink -e $AVROPY/build/lib*):${PYTHONPATH:-}
 
 $PYTHON examples/benchmark.py
+$PYTHON examples/writer_benchmark.py
+$PYTHON examples/serializer_benchmark.py
+DATA=$(mktemp -d)
+$PYTHON examples/benchmark_suite.py --output benchmark_results.json --data-dir $DATA
+if [ -x build/native_benchmark ]
+then
+    for f in $DATA/*-null.avro
+    do
+        build/native_benchmark $f
+    done
+fi
+rm -rf $DATA
@@ -41,14 +41,28 @@ ext_modules = [Extension('pyavroc/_pyavroc',
                          ['src/pyavro.c',
                           'src/filereader.c',
                           'src/filewriter.c',
+                          'src/container.c',
+                          'src/skip.c',
+                          'src/readinto.c',
+                          'src/varint.c',
+                          'src/blockbuffer.c',
+                          'src/resolver.c',
+                          'src/fingerprint.c',
+                          'src/registry.c',
                           'src/serializer.c',
                           'src/deserializer.c',
+                          'src/multideserializer.c',
+                          'src/avroschema.c',
+                          'src/validator.c',
                           'src/convert.c',
+                          'src/strcache.c',
                           'src/record.c',
                           'src/avroenum.c',
+                          'src/allocator.c',
+                          'src/stats.c',
                           'src/util.c',
                           'src/error.c'],
-                         libraries=['avro'] + extra_libs)]
+                         libraries=['avro', 'z', 'pthread'] + extra_libs)]
 
 setup(name='pyavroc',
       version=version,
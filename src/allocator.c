@@ -0,0 +1,368 @@
+/*
+ * Copyright 2015 Byhiras (Europe) Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "allocator.h"
+#include "avro.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define ARENA_CHUNK_SIZE (64 * 1024)
+
+/* anything bigger goes to the C library, so chunks don't fill up at once */
+#define ARENA_MAX_ALLOC (ARENA_CHUNK_SIZE / 4)
+
+#define ALIGN(n) (((n) + 15) & ~(size_t)15)
+
+/*
+ * Each allocation is preceded by a header saying where it came from, so
+ * the mode can change while Avro-C still holds memory from the old one.
+ * owner is an arena chunk or one of the tags below.
+ */
+typedef union {
+    struct {
+        void *owner;
+        size_t size;
+    } h;
+    double align;
+} Header;
+
+typedef struct {
+    size_t used;
+    size_t live;  /* allocations not yet freed */
+} Chunk;
+
+#define CHUNK_HEADER ALIGN(sizeof(Chunk))
+
+static char system_tag;
+static char pymem_tag;
+
+static struct {
+    int installed;
+    int used;  /* Avro-C has allocated with its own allocator */
+    allocator_mode_t mode;
+    Chunk *current;
+    Chunk *spare;
+    size_t live_bytes;
+    size_t peak_bytes;
+    uint64_t allocations;
+    size_t chunks;
+} state;
+
+static char *
+chunk_data(Chunk *chunk)
+{
+    return (char *)chunk + CHUNK_HEADER;
+}
+
+static Chunk *
+chunk_new(void)
+{
+    Chunk *chunk = state.spare;
+
+    if (chunk != NULL) {
+        state.spare = NULL;
+    } else {
+        chunk = (Chunk *)malloc(CHUNK_HEADER + ARENA_CHUNK_SIZE);
+        if (chunk == NULL) {
+            return NULL;
+        }
+        state.chunks++;
+    }
+    chunk->used = 0;
+    chunk->live = 0;
+    return chunk;
+}
+
+/* keep one empty chunk back, so a reader doesn't malloc every block */
+static void
+chunk_release(Chunk *chunk)
+{
+    if (state.spare == NULL) {
+        state.spare = chunk;
+    } else {
+        free(chunk);
+        state.chunks--;
+    }
+}
+
+/* stop allocating from the current chunk; its last free releases it */
+static void
+retire_current(void)
+{
+    Chunk *chunk = state.current;
+
+    if (chunk == NULL) {
+        return;
+    }
+    if (chunk->live == 0) {
+        chunk->used = 0;
+        if (state.mode == ALLOCATOR_ARENA) {
+            return;
+        }
+        chunk_release(chunk);
+    }
+    state.current = NULL;
+}
+
+static Header *
+arena_alloc(size_t total)
+{
+    Chunk *chunk = state.current;
+    Header *hdr;
+
+    if (chunk != NULL && chunk->used + total > ARENA_CHUNK_SIZE) {
+        retire_current();
+        chunk = state.current;
+    }
+    if (chunk == NULL) {
+        chunk = chunk_new();
+        if (chunk == NULL) {
+            return NULL;
+        }
+        state.current = chunk;
+    }
+
+    hdr = (Header *)(chunk_data(chunk) + chunk->used);
+    hdr->h.owner = chunk;
+    chunk->used += total;
+    chunk->live++;
+    return hdr;
+}
+
+static int
+is_last(Chunk *chunk, Header *hdr)
+{
+    return (char *)hdr + ALIGN(sizeof(Header) + hdr->h.size)
+        == chunk_data(chunk) + chunk->used;
+}
+
+static void
+arena_free(Header *hdr)
+{
+    Chunk *chunk = (Chunk *)hdr->h.owner;
+
+    if (is_last(chunk, hdr)) {
+        chunk->used -= ALIGN(sizeof(Header) + hdr->h.size);
+    }
+    if (--chunk->live > 0) {
+        return;
+    }
+    if (chunk == state.current) {
+        /* everything from this chunk has gone, so start it again */
+        chunk->used = 0;
+    } else {
+        chunk_release(chunk);
+    }
+}
+
+/* grow or shrink the last allocation in the current chunk in place */
+static int
+arena_resize(Header *hdr, size_t total)
+{
+    Chunk *chunk = (Chunk *)hdr->h.owner;
+    size_t start;
+
+    if (chunk != state.current || !is_last(chunk, hdr)) {
+        return 0;
+    }
+    start = (char *)hdr - chunk_data(chunk);
+    if (start + total > ARENA_CHUNK_SIZE) {
+        return 0;
+    }
+    chunk->used = start + total;
+    return 1;
+}
+
+static Header *
+new_block(size_t total)
+{
+    Header *hdr;
+
+    if (state.mode == ALLOCATOR_ARENA && total <= ARENA_MAX_ALLOC) {
+        return arena_alloc(ALIGN(total));
+    }
+    if (state.mode == ALLOCATOR_PYMEM) {
+        hdr = (Header *)PyMem_Malloc(total);
+        if (hdr != NULL) {
+            hdr->h.owner = &pymem_tag;
+        }
+    } else {
+        hdr = (Header *)malloc(total);
+        if (hdr != NULL) {
+            hdr->h.owner = &system_tag;
+        }
+    }
+    return hdr;
+}
+
+static void
+free_block(Header *hdr)
+{
+    if (hdr->h.owner == &system_tag) {
+        free(hdr);
+    } else if (hdr->h.owner == &pymem_tag) {
+        PyMem_Free(hdr);
+    } else {
+        arena_free(hdr);
+    }
+}
+
+static Header *
+resize_block(Header *hdr, size_t nsize)
+{
+    size_t total = sizeof(Header) + nsize;
+    Header *new_hdr;
+
+    if (hdr->h.owner == &system_tag) {
+        return (Header *)realloc(hdr, total);
+    }
+    if (hdr->h.owner == &pymem_tag) {
+        return (Header *)PyMem_Realloc(hdr, total);
+    }
+    if (arena_resize(hdr, ALIGN(total))) {
+        return hdr;
+    }
+
+    new_hdr = new_block(total);
+    if (new_hdr == NULL) {
+        return NULL;
+    }
+    memcpy(new_hdr + 1, hdr + 1, hdr->h.size < nsize ? hdr->h.size : nsize);
+    arena_free(hdr);
+    return new_hdr;
+}
+
+/*
+ * The sizes Avro-C passes are the ones it asked for, but we go by the
+ * header, which can't be wrong.
+ */
+static void *
+pyavroc_allocator(void *user_data, void *ptr, size_t osize, size_t nsize)
+{
+    Header *hdr = ptr != NULL ? (Header *)ptr - 1 : NULL;
+    Header *new_hdr;
+    size_t old_size = hdr != NULL ? hdr->h.size : 0;
+
+    if (nsize == 0) {
+        if (hdr != NULL) {
+            free_block(hdr);
+            state.live_bytes -= old_size;
+        }
+        return NULL;
+    }
+
+    if (nsize > SIZE_MAX - 2 * sizeof(Header)) {
+        return NULL;
+    }
+
+    if (hdr != NULL) {
+        new_hdr = resize_block(hdr, nsize);
+    } else {
+        new_hdr = new_block(sizeof(Header) + nsize);
+        state.allocations += (new_hdr != NULL);
+    }
+    if (new_hdr == NULL) {
+        return NULL;
+    }
+
+    new_hdr->h.size = nsize;
+    state.live_bytes += nsize - old_size;
+    if (state.live_bytes > state.peak_bytes) {
+        state.peak_bytes = state.live_bytes;
+    }
+    return new_hdr + 1;
+}
+
+void
+allocator_note_use(void)
+{
+    if (!state.installed) {
+        state.used = 1;
+    }
+}
+
+int
+allocator_set_mode(allocator_mode_t mode)
+{
+    if (mode == state.mode) {
+        return 0;
+    }
+    if (!state.installed) {
+        if (state.used) {
+            return -1;
+        }
+        avro_set_allocator(pyavroc_allocator, NULL);
+        state.installed = 1;
+    }
+    state.mode = mode;
+    retire_current();
+    return 0;
+}
+
+allocator_mode_t
+allocator_get_mode(void)
+{
+    return state.mode;
+}
+
+static const char *mode_names[] = {"system", "pymem", "arena"};
+
+int
+allocator_mode_from_name(const char *name, allocator_mode_t *mode)
+{
+    int i;
+
+    for (i = 0; i < 3; i++) {
+        if (strcmp(name, mode_names[i]) == 0) {
+            *mode = (allocator_mode_t)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+const char *
+allocator_mode_name(allocator_mode_t mode)
+{
+    return mode_names[mode];
+}
+
+void
+allocator_block_done(void)
+{
+    if (state.mode == ALLOCATOR_ARENA) {
+        retire_current();
+    }
+}
+
+PyObject *
+allocator_stats_to_pydict(int reset_peak)
+{
+    PyObject *dict = Py_BuildValue("{s:s,s:n,s:n,s:K,s:n}",
+                                   "mode", mode_names[state.mode],
+                                   "live_bytes", (Py_ssize_t)state.live_bytes,
+                                   "peak_bytes", (Py_ssize_t)state.peak_bytes,
+                                   "allocations",
+                                   (unsigned long long)state.allocations,
+                                   "arena_chunks", (Py_ssize_t)state.chunks);
+
+    if (dict != NULL && reset_peak) {
+        state.peak_bytes = state.live_bytes;
+    }
+    return dict;
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright 2015 Byhiras (Europe) Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INC_ALLOCATOR_H
+#define INC_ALLOCATOR_H
+
+#include "Python.h"
+
+/*
+ * Once "pymem" or "arena" is chosen, all of Avro-C's allocations go
+ * through our allocator, which can hand them to the C library, to PyMem
+ * (so tracemalloc sees them), or to a bump arena for the short-lived
+ * values made while reading.  Live and peak bytes are counted from then
+ * on, in every mode.  Until then Avro-C keeps its own allocator.
+ *
+ * The allocator is Avro-C's, so it is shared by the whole process, and
+ * it puts a header before each allocation.  It can only be installed
+ * before Avro-C has allocated anything, or Avro-C would later free that
+ * memory through us.  We can only tell whether pyavroc has used Avro-C.
+ *
+ * pyavroc only calls into Avro-C with the GIL held, and the GIL is what
+ * protects the allocator state.
+ */
+
+typedef enum {
+    ALLOCATOR_SYSTEM,
+    ALLOCATOR_PYMEM,
+    ALLOCATOR_ARENA
+} allocator_mode_t;
+
+/* pyavroc is about to have Avro-C allocate, so it's too late to install */
+void allocator_note_use(void);
+
+/*
+ * Switch mode, installing the allocator for "pymem" or "arena" the first
+ * time.  Memory from the old mode is still freed correctly.  Returns -1
+ * if the allocator is needed but Avro-C has already allocated.
+ */
+int allocator_set_mode(allocator_mode_t mode);
+
+allocator_mode_t allocator_get_mode(void);
+
+/* returns 0 and sets mode for "system", "pymem" or "arena", else -1 */
+int allocator_mode_from_name(const char *name, allocator_mode_t *mode);
+
+const char *allocator_mode_name(allocator_mode_t mode);
+
+/*
+ * A file reader has finished with a block: in arena mode, start a new
+ * chunk, so the old one goes as soon as the block's values are freed.
+ */
+void allocator_block_done(void);
+
+/* mode, live_bytes, peak_bytes, allocations and arena_chunks */
+PyObject *allocator_stats_to_pydict(int reset_peak);
+
+#endif
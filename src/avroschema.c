@@ -0,0 +1,268 @@
+/*
+ * Copyright 2015 Byhiras (Europe) Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "avroschema.h"
+#include "fingerprint.h"
+#include "validator.h"
+#include "structmember.h"
+#include "util.h"
+#include "allocator.h"
+
+/* beyond this many distinct JSON texts, start the cache again */
+#define SCHEMA_CACHE_SIZE 1024
+
+static PyObject *schema_cache = NULL;
+
+static PyObject *
+new_schema_object(PyObject *json)
+{
+    int rval;
+    char *canonical_form;
+    PyObject *json_bytes;
+    AvroSchema *self;
+
+    json_bytes = pystring_to_pybytes(json);
+    if (json_bytes == NULL) {
+        return NULL;
+    }
+
+    self = (AvroSchema *)avroSchemaType.tp_alloc(&avroSchemaType, 0);
+    if (self == NULL) {
+        Py_DECREF(json_bytes);
+        return NULL;
+    }
+
+    allocator_note_use();
+    rval = avro_schema_from_json(pybytes_to_chars(json_bytes), 0,
+                                 &self->schema, NULL);
+    Py_DECREF(json_bytes);
+    if (rval != 0 || self->schema == NULL) {
+        self->schema = NULL;
+        Py_DECREF(self);
+        PyErr_Format(PyExc_IOError, "Error reading schema: %s",
+                     avro_strerror());
+        return NULL;
+    }
+
+    canonical_form = schema_canonical_form(self->schema);
+    if (canonical_form == NULL) {
+        Py_DECREF(self);
+        PyErr_Format(PyExc_ValueError, "Error getting canonical form: %s",
+                     avro_strerror());
+        return NULL;
+    }
+    self->fingerprint = rabin_fingerprint(canonical_form,
+                                          strlen(canonical_form));
+    self->canonical_form = chars_to_pystring(canonical_form);
+    free(canonical_form);
+    if (self->canonical_form == NULL) {
+        Py_DECREF(self);
+        return NULL;
+    }
+
+    Py_INCREF(json);
+    self->json = json;
+
+    return (PyObject *)self;
+}
+
+PyObject *
+get_schema_object(PyObject *obj)
+{
+    PyObject *result;
+
+    if (PyObject_TypeCheck(obj, &avroSchemaType)) {
+        Py_INCREF(obj);
+        return obj;
+    }
+
+    if (!is_pystring(obj)) {
+        PyErr_Format(PyExc_TypeError,
+                     "expected a Schema or JSON string, %.200s found",
+                     Py_TYPE(obj)->tp_name);
+        return NULL;
+    }
+
+    if (schema_cache == NULL) {
+        schema_cache = PyDict_New();
+        if (schema_cache == NULL) {
+            return NULL;
+        }
+    }
+
+    result = PyDict_GetItem(schema_cache, obj);
+    if (result != NULL) {
+        Py_INCREF(result);
+        return result;
+    }
+
+    result = new_schema_object(obj);
+    if (result == NULL) {
+        return NULL;
+    }
+
+    if (PyDict_Size(schema_cache) >= SCHEMA_CACHE_SIZE) {
+        PyDict_Clear(schema_cache);
+    }
+    if (PyDict_SetItem(schema_cache, obj, result) < 0) {
+        Py_DECREF(result);
+        return NULL;
+    }
+
+    return result;
+}
+
+avro_schema_t
+get_avro_schema(PyObject *obj, uint64_t *fingerprint)
+{
+    avro_schema_t schema;
+    PyObject *schema_object = get_schema_object(obj);
+
+    if (schema_object == NULL) {
+        return NULL;
+    }
+    schema = avro_schema_incref(((AvroSchema *)schema_object)->schema);
+    if (fingerprint != NULL) {
+        *fingerprint = ((AvroSchema *)schema_object)->fingerprint;
+    }
+    Py_DECREF(schema_object);
+
+    return schema;
+}
+
+static PyObject *
+AvroSchema_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+    PyObject *json;
+    static char *kwlist[] = {"json", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O", kwlist, &json)) {
+        return NULL;
+    }
+
+    return get_schema_object(json);
+}
+
+static void
+AvroSchema_dealloc(AvroSchema *self)
+{
+    if (self->schema != NULL) {
+        avro_schema_decref(self->schema);
+    }
+    Py_CLEAR(self->json);
+    Py_CLEAR(self->canonical_form);
+    Py_CLEAR(self->validator);
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static PyObject *
+AvroSchema_get_fingerprint(AvroSchema *self, void *closure)
+{
+    return PyLong_FromUnsignedLongLong(self->fingerprint);
+}
+
+static PyObject *
+AvroSchema_repr(AvroSchema *self)
+{
+#if PY_MAJOR_VERSION >= 3
+    return PyUnicode_FromFormat("Schema(%R)", self->canonical_form);
+#else
+    PyObject *repr = PyObject_Repr(self->canonical_form);
+    PyObject *result;
+
+    if (repr == NULL) {
+        return NULL;
+    }
+    result = PyString_FromFormat("Schema(%s)", PyString_AsString(repr));
+    Py_DECREF(repr);
+    return result;
+#endif
+}
+
+static PyObject *
+AvroSchema_validator(AvroSchema *self)
+{
+    if (self->validator == NULL) {
+        self->validator = validator_new(self->schema);
+        if (self->validator == NULL) {
+            return NULL;
+        }
+    }
+    Py_INCREF(self->validator);
+    return self->validator;
+}
+
+static PyMethodDef AvroSchema_methods[] = {
+    {"validator", (PyCFunction)AvroSchema_validator, METH_NOARGS,
+     "validator(): compiled validator for this schema"
+    },
+    {NULL}  /* Sentinel */
+};
+
+static PyMemberDef AvroSchema_members[] = {
+    {"json", T_OBJECT, offsetof(AvroSchema, json), READONLY,
+     "schema as given"},
+    {"canonical_form", T_OBJECT, offsetof(AvroSchema, canonical_form), READONLY,
+     "Parsing Canonical Form of the schema"},
+    {NULL}  /* Sentinel */
+};
+
+static PyGetSetDef AvroSchema_getset[] = {
+    {"fingerprint", (getter)AvroSchema_get_fingerprint, NULL,
+     "CRC-64-AVRO fingerprint of the canonical form", NULL},
+    {NULL}  /* Sentinel */
+};
+
+PyTypeObject avroSchemaType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "_pyavro.Schema",                    /* tp_name */
+    sizeof(AvroSchema),                  /* tp_basicsize */
+    0,                                   /* tp_itemsize */
+    (destructor)AvroSchema_dealloc,      /* tp_dealloc */
+    0,                                   /* tp_print */
+    0,                                   /* tp_getattr */
+    0,                                   /* tp_setattr */
+    0,                                   /* tp_compare */
+    (reprfunc)AvroSchema_repr,           /* tp_repr */
+    0,                                   /* tp_as_number */
+    0,                                   /* tp_as_sequence */
+    0,                                   /* tp_as_mapping */
+    0,                                   /* tp_hash */
+    0,                                   /* tp_call */
+    0,                                   /* tp_str */
+    0,                                   /* tp_getattro */
+    0,                                   /* tp_setattro */
+    0,                                   /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,                  /* tp_flags */
+    "Parsed Avro schema",                /* tp_doc */
+    0,                                   /* tp_traverse */
+    0,                                   /* tp_clear */
+    0,                                   /* tp_richcompare */
+    0,                                   /* tp_weaklistoffset */
+    0,                                   /* tp_iter */
+    0,                                   /* tp_iternext */
+    AvroSchema_methods,                  /* tp_methods */
+    AvroSchema_members,                  /* tp_members */
+    AvroSchema_getset,                   /* tp_getset */
+    0,                                   /* tp_base */
+    0,                                   /* tp_dict */
+    0,                                   /* tp_descr_get */
+    0,                                   /* tp_descr_set */
+    0,                                   /* tp_dictoffset */
+    0,                                   /* tp_init */
+    0,                                   /* tp_alloc */
+    AvroSchema_new,                      /* tp_new */
+};
@@ -0,0 +1,47 @@
+/*
+ * Copyright 2015 Byhiras (Europe) Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INC_AVROSCHEMA_H
+#define INC_AVROSCHEMA_H
+
+#include "Python.h"
+#include "avro.h"
+
+typedef struct {
+    PyObject_HEAD
+
+    avro_schema_t schema;
+    PyObject *json;
+    PyObject *canonical_form;
+    uint64_t fingerprint;
+    PyObject *validator;  /* compiled on first use */
+} AvroSchema;
+
+extern PyTypeObject avroSchemaType;
+
+/*
+ * Schema object for a JSON string or Schema, parsing each distinct JSON
+ * text only once.  Returns a new reference, or NULL with the error set.
+ */
+PyObject *get_schema_object(PyObject *obj);
+
+/*
+ * The same, but returning a new reference to the parsed schema, and its
+ * fingerprint if fingerprint isn't NULL.
+ */
+avro_schema_t get_avro_schema(PyObject *obj, uint64_t *fingerprint);
+
+#endif
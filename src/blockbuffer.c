@@ -0,0 +1,88 @@
+/*
+ * Copyright 2015 Byhiras (Europe) Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "blockbuffer.h"
+
+#include <stdlib.h>
+
+PyObject *
+block_buffer_new(char *data, size_t len)
+{
+    BlockBuffer *self = PyObject_New(BlockBuffer, &blockBufferType);
+
+    if (self == NULL) {
+        free(data);
+        return NULL;
+    }
+    self->data = data;
+    self->len = (Py_ssize_t)len;
+    return (PyObject *)self;
+}
+
+static void
+BlockBuffer_dealloc(BlockBuffer *self)
+{
+    free(self->data);
+    PyObject_Del(self);
+}
+
+static int
+BlockBuffer_getbuffer(BlockBuffer *self, Py_buffer *view, int flags)
+{
+    return PyBuffer_FillInfo(view, (PyObject *)self, self->data, self->len,
+                             1, flags);
+}
+
+static PyBufferProcs BlockBuffer_as_buffer = {
+#if PY_MAJOR_VERSION < 3
+    0,                                   /* bf_getreadbuffer */
+    0,                                   /* bf_getwritebuffer */
+    0,                                   /* bf_getsegcount */
+    0,                                   /* bf_getcharbuffer */
+#endif
+    (getbufferproc)BlockBuffer_getbuffer,  /* bf_getbuffer */
+    0,                                   /* bf_releasebuffer */
+};
+
+#if PY_MAJOR_VERSION >= 3
+#define BLOCKBUFFER_FLAGS Py_TPFLAGS_DEFAULT
+#else
+#define BLOCKBUFFER_FLAGS (Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_NEWBUFFER)
+#endif
+
+PyTypeObject blockBufferType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "_pyavro.BlockBuffer",               /* tp_name */
+    sizeof(BlockBuffer),                 /* tp_basicsize */
+    0,                                   /* tp_itemsize */
+    (destructor)BlockBuffer_dealloc,     /* tp_dealloc */
+    0,                                   /* tp_print */
+    0,                                   /* tp_getattr */
+    0,                                   /* tp_setattr */
+    0,                                   /* tp_compare */
+    0,                                   /* tp_repr */
+    0,                                   /* tp_as_number */
+    0,                                   /* tp_as_sequence */
+    0,                                   /* tp_as_mapping */
+    0,                                   /* tp_hash */
+    0,                                   /* tp_call */
+    0,                                   /* tp_str */
+    0,                                   /* tp_getattro */
+    0,                                   /* tp_setattro */
+    &BlockBuffer_as_buffer,              /* tp_as_buffer */
+    BLOCKBUFFER_FLAGS,                   /* tp_flags */
+    "Decoded block shared by memoryviews",  /* tp_doc */
+};
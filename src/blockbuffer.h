@@ -0,0 +1,37 @@
+/*
+ * Copyright 2015 Byhiras (Europe) Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INC_BLOCKBUFFER_H
+#define INC_BLOCKBUFFER_H
+
+#include "Python.h"
+
+/*
+ * A read-only buffer owning a decoded block, so that memoryviews of the
+ * bytes values in it keep it alive.
+ */
+typedef struct {
+    PyObject_HEAD
+    char *data;  /* from malloc */
+    Py_ssize_t len;
+} BlockBuffer;
+
+extern PyTypeObject blockBufferType;
+
+/* takes ownership of data, even on failure */
+PyObject *block_buffer_new(char *data, size_t len);
+
+#endif
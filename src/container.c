@@ -0,0 +1,1007 @@
+/*
+ * Copyright 2015 Byhiras (Europe) Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "container.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <zlib.h>
+
+/* same as Avro-C, so a threaded writer produces the same sized blocks */
+#define CONTAINER_DEFLATE_LEVEL Z_BEST_COMPRESSION
+
+#define JOB_FREE 0
+#define JOB_QUEUED 1
+#define JOB_RUNNING 2
+#define JOB_DONE 3
+
+/*
+ * Job buffers are touched by the worker threads without the GIL, so they
+ * come from plain malloc rather than PyMem or avro_malloc.
+ */
+typedef struct {
+    int state;
+    int rval;
+    int64_t count;
+    char *raw;
+    size_t raw_len;
+    size_t raw_size;
+    char *out;
+    size_t out_len;
+    size_t out_size;
+    /* kept here by compress_job and added to the stats when written */
+    uint64_t codec_ns;
+    size_t out_grown_from;
+    int out_grown;
+} BlockJob;
+
+struct BlockWriter {
+    FILE *file;
+    container_codec_t codec;
+    char sync[CONTAINER_SYNC_SIZE];
+    size_t block_size;
+    avro_writer_t datum_writer;
+    Stats *stats;
+
+    /* ring of jobs: pending jobs run from head up to (not including) fill */
+    BlockJob *jobs;
+    int njobs;
+    int fill;
+    int pending;
+    int next;  /* next queued job for a worker to pick up */
+
+    z_stream zstream;  /* used when compressing inline */
+    int zstream_ok;
+
+    pthread_t *workers;
+    int nworkers;
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond;
+    pthread_cond_t done_cond;
+    int stop;
+};
+
+struct BlockReader {
+    FILE *file;
+    container_codec_t codec;
+    char sync[CONTAINER_SYNC_SIZE];
+    char *raw;
+    size_t raw_size;
+    char *out;
+    size_t out_size;
+    z_stream zstream;
+    int zstream_ok;
+    Stats *stats;
+};
+
+int
+container_codec_from_name(const char *name, container_codec_t *codec)
+{
+    if (strcmp(name, "null") == 0) {
+        *codec = CONTAINER_CODEC_NULL;
+        return 0;
+    }
+    if (strcmp(name, "deflate") == 0) {
+        *codec = CONTAINER_CODEC_DEFLATE;
+        return 0;
+    }
+    avro_set_error("Unsupported codec %s", name);
+    return EINVAL;
+}
+
+static size_t
+encode_long(char *buf, int64_t l)
+{
+    uint64_t n = ((uint64_t)l << 1) ^ (uint64_t)(l >> 63);
+    size_t i = 0;
+
+    while (n & ~(uint64_t)0x7f) {
+        buf[i++] = (char)((n & 0x7f) | 0x80);
+        n >>= 7;
+    }
+    buf[i++] = (char)n;
+    return i;
+}
+
+static int
+write_chars(FILE *file, const char *buf, size_t len)
+{
+    if (len > 0 && fwrite(buf, 1, len, file) != len) {
+        avro_set_error("Cannot write to file: %s", strerror(errno));
+        return EIO;
+    }
+    return 0;
+}
+
+/* writes Avro "bytes" (and so also "string") */
+static int
+write_bytes(FILE *file, const char *buf, size_t len)
+{
+    char lenbuf[10];
+    int rval = write_chars(file, lenbuf, encode_long(lenbuf, len));
+    return rval ? rval : write_chars(file, buf, len);
+}
+
+/* returns malloc'ed JSON for schema, not zero terminated */
+static char *
+schema_to_json(avro_schema_t schema, size_t *len)
+{
+    int rval;
+    size_t size = 256;
+    char *json = NULL;
+    avro_writer_t json_writer;
+
+    do {
+        size *= 2;
+        free(json);
+        json = (char *)malloc(size);
+        if (json == NULL) {
+            avro_set_error("Cannot allocate schema buffer");
+            return NULL;
+        }
+        json_writer = avro_writer_memory(json, size);
+        rval = avro_schema_to_json(schema, json_writer);
+        *len = avro_writer_tell(json_writer);
+        avro_writer_free(json_writer);
+    } while (rval == ENOSPC);
+
+    if (rval) {
+        free(json);
+        return NULL;
+    }
+    return json;
+}
+
+static int
+read_long(FILE *file, int64_t *l)
+{
+    uint64_t n = 0;
+    int shift = 0;
+    int c;
+
+    do {
+        if (shift >= 64 || (c = getc(file)) == EOF) {
+            avro_set_error("Invalid or truncated varint");
+            return EILSEQ;
+        }
+        n |= (uint64_t)(c & 0x7f) << shift;
+        shift += 7;
+    } while (c & 0x80);
+
+    *l = (int64_t)(n >> 1) ^ -(int64_t)(n & 1);
+    return 0;
+}
+
+/* reads Avro "bytes" into a zero terminated malloc'ed buffer */
+static int
+read_bytes(FILE *file, char **buf, int64_t *len)
+{
+    int rval = read_long(file, len);
+
+    if (rval) {
+        return rval;
+    }
+    if (*len < 0) {
+        avro_set_error("Invalid length %lld", (long long)*len);
+        return EILSEQ;
+    }
+    *buf = (char *)malloc(*len + 1);
+    if (*buf == NULL) {
+        avro_set_error("Cannot allocate %lld bytes", (long long)*len);
+        return ENOMEM;
+    }
+    if (fread(*buf, 1, *len, file) != (size_t)*len) {
+        free(*buf);
+        avro_set_error("Truncated file header");
+        return EILSEQ;
+    }
+    (*buf)[*len] = '\0';
+    return 0;
+}
+
+int
+container_read_header(FILE *file, avro_schema_t *schema,
+                      char *codec_name, size_t codec_size, char *sync)
+{
+    int rval = 0;
+    char magic[4];
+    int64_t count;
+
+    *schema = NULL;
+    strncpy(codec_name, "null", codec_size);
+
+    if (fread(magic, 1, 4, file) != 4 || memcmp(magic, "Obj\x01", 4) != 0) {
+        avro_set_error("Not an Avro container file");
+        return EILSEQ;
+    }
+
+    /* metadata map */
+    while (!rval && !(rval = read_long(file, &count)) && count != 0) {
+        if (count < 0) {
+            int64_t block_size;
+            count = -count;
+            rval = read_long(file, &block_size);
+        }
+        for ( ; !rval && count > 0; count--) {
+            char *key;
+            char *value;
+            int64_t key_len;
+            int64_t value_len;
+
+            rval = read_bytes(file, &key, &key_len);
+            if (rval) {
+                break;
+            }
+            rval = read_bytes(file, &value, &value_len);
+            if (rval) {
+                free(key);
+                break;
+            }
+
+            if (strcmp(key, "avro.schema") == 0 && *schema == NULL) {
+                if (avro_schema_from_json(value, 0, schema, NULL) || *schema == NULL) {
+                    *schema = NULL;
+                    rval = EINVAL;
+                }
+            } else if (strcmp(key, "avro.codec") == 0) {
+                if ((size_t)value_len >= codec_size) {
+                    avro_set_error("Unsupported codec %s", value);
+                    rval = EINVAL;
+                } else {
+                    strcpy(codec_name, value);
+                }
+            }
+
+            free(key);
+            free(value);
+        }
+    }
+
+    if (!rval && *schema == NULL) {
+        avro_set_error("File header has no schema");
+        rval = EILSEQ;
+    }
+    if (!rval && fread(sync, 1, CONTAINER_SYNC_SIZE, file) != CONTAINER_SYNC_SIZE) {
+        avro_set_error("Truncated file header");
+        rval = EILSEQ;
+    }
+
+    if (rval && *schema != NULL) {
+        avro_schema_decref(*schema);
+        *schema = NULL;
+    }
+    return rval;
+}
+
+static void
+make_sync(char *sync)
+{
+    size_t nread = 0;
+    FILE *urandom = fopen("/dev/urandom", "rb");
+
+    if (urandom != NULL) {
+        nread = fread(sync, 1, CONTAINER_SYNC_SIZE, urandom);
+        fclose(urandom);
+    }
+    for ( ; nread < CONTAINER_SYNC_SIZE; nread++) {
+        sync[nread] = (char)(rand() & 0xff);
+    }
+}
+
+int
+container_write_header(FILE *file, avro_schema_t schema,
+                       const char *codec_name, char *sync)
+{
+    int rval;
+    size_t json_len;
+    char count[10];
+    char *json = schema_to_json(schema, &json_len);
+
+    if (json == NULL) {
+        return EINVAL;
+    }
+
+    make_sync(sync);
+
+    rval = write_chars(file, "Obj\x01", 4);
+    if (!rval) {
+        /* metadata map with two entries */
+        rval = write_chars(file, count, encode_long(count, 2));
+    }
+    if (!rval) {
+        rval = write_bytes(file, "avro.codec", 10);
+    }
+    if (!rval) {
+        rval = write_bytes(file, codec_name, strlen(codec_name));
+    }
+    if (!rval) {
+        rval = write_bytes(file, "avro.schema", 11);
+    }
+    if (!rval) {
+        rval = write_bytes(file, json, json_len);
+    }
+    if (!rval) {
+        rval = write_chars(file, count, encode_long(count, 0));
+    }
+    if (!rval) {
+        rval = write_chars(file, sync, CONTAINER_SYNC_SIZE);
+    }
+
+    free(json);
+    return rval;
+}
+
+static int
+deflate_init(z_stream *zs)
+{
+    memset(zs, 0, sizeof(z_stream));
+    /* negative window bits: raw deflate without the zlib wrapper */
+    return deflateInit2(zs, CONTAINER_DEFLATE_LEVEL, Z_DEFLATED, -15, 8,
+                        Z_DEFAULT_STRATEGY) == Z_OK ? 0 : ENOMEM;
+}
+
+/* may run in a worker thread: must not touch Python or set avro errors */
+static int
+compress_job(BlockJob *job, container_codec_t codec, z_stream *zs)
+{
+    size_t bound;
+    uint64_t start;
+
+    if (codec == CONTAINER_CODEC_NULL) {
+        return 0;
+    }
+    start = stats_now();
+
+    bound = deflateBound(zs, job->raw_len);
+    if (bound > job->out_size) {
+        char *out = (char *)realloc(job->out, bound);
+        if (out == NULL) {
+            return ENOMEM;
+        }
+        job->out_grown = 1;
+        job->out_grown_from = job->out_size;
+        job->out = out;
+        job->out_size = bound;
+    }
+
+    deflateReset(zs);
+    zs->next_in = (Bytef *)job->raw;
+    zs->avail_in = job->raw_len;
+    zs->next_out = (Bytef *)job->out;
+    zs->avail_out = job->out_size;
+
+    if (deflate(zs, Z_FINISH) != Z_STREAM_END) {
+        return EIO;
+    }
+    job->out_len = zs->total_out;
+    job->codec_ns = stats_now() - start;
+
+    return 0;
+}
+
+/* empty the job so its slot can take the next block */
+static void
+release_job(BlockJob *job)
+{
+    job->codec_ns = 0;
+    job->count = 0;
+    job->raw_len = 0;
+    job->rval = 0;
+    job->state = JOB_FREE;
+}
+
+static int
+write_job(BlockWriter *bw, BlockJob *job)
+{
+    int rval;
+    char lens[20];
+    size_t n;
+    const char *data = job->raw;
+    size_t len = job->raw_len;
+    Stats *stats = bw->stats;
+    uint64_t start;
+
+    if (job->out_grown) {
+        stats_count_alloc(stats, job->out_grown_from);
+        job->out_grown = 0;
+    }
+
+    if (job->rval) {
+        rval = job->rval;
+        avro_set_error("Cannot compress block: %s", strerror(rval));
+        release_job(job);
+        return rval;
+    }
+
+    if (bw->codec != CONTAINER_CODEC_NULL) {
+        data = job->out;
+        len = job->out_len;
+    }
+
+    n = encode_long(lens, job->count);
+    n += encode_long(lens + n, len);
+
+    start = stats_now();
+    rval = write_chars(bw->file, lens, n);
+    if (!rval) {
+        rval = write_chars(bw->file, data, len);
+    }
+    if (!rval) {
+        rval = write_chars(bw->file, bw->sync, CONTAINER_SYNC_SIZE);
+    }
+    stats->io_ns += stats_now() - start;
+
+    stats->blocks++;
+    stats->compressed_bytes += len;
+    stats->uncompressed_bytes += job->raw_len;
+    stats->codec_ns += job->codec_ns;
+
+    release_job(job);
+
+    return rval;
+}
+
+static void *
+worker_main(void *arg)
+{
+    BlockWriter *bw = (BlockWriter *)arg;
+    z_stream zs;
+    int zs_rval = deflate_init(&zs);
+
+    pthread_mutex_lock(&bw->lock);
+    for (;;) {
+        BlockJob *job = &bw->jobs[bw->next];
+        int rval;
+
+        if (job->state != JOB_QUEUED) {
+            if (bw->stop) {
+                break;
+            }
+            pthread_cond_wait(&bw->work_cond, &bw->lock);
+            continue;
+        }
+
+        job->state = JOB_RUNNING;
+        bw->next = (bw->next + 1) % bw->njobs;
+        pthread_mutex_unlock(&bw->lock);
+
+        rval = zs_rval ? zs_rval : compress_job(job, bw->codec, &zs);
+
+        pthread_mutex_lock(&bw->lock);
+        job->rval = rval;
+        job->state = JOB_DONE;
+        pthread_cond_broadcast(&bw->done_cond);
+    }
+    pthread_mutex_unlock(&bw->lock);
+
+    if (!zs_rval) {
+        deflateEnd(&zs);
+    }
+    return NULL;
+}
+
+/*
+ * Write out finished jobs in the order they were submitted.  Waits for
+ * all of them if wait_all, otherwise only as long as the ring is full.
+ */
+static int
+write_done_jobs(BlockWriter *bw, int wait_all)
+{
+    while (bw->pending > 0) {
+        int head = (bw->fill - bw->pending + bw->njobs) % bw->njobs;
+        BlockJob *job = &bw->jobs[head];
+        int state;
+        int rval;
+
+        pthread_mutex_lock(&bw->lock);
+        state = job->state;
+        pthread_mutex_unlock(&bw->lock);
+
+        if (state != JOB_DONE) {
+            if (!wait_all && bw->pending < bw->njobs) {
+                break;
+            }
+            Py_BEGIN_ALLOW_THREADS
+            pthread_mutex_lock(&bw->lock);
+            while (job->state != JOB_DONE) {
+                pthread_cond_wait(&bw->done_cond, &bw->lock);
+            }
+            pthread_mutex_unlock(&bw->lock);
+            Py_END_ALLOW_THREADS
+        }
+
+        bw->pending--;
+        rval = write_job(bw, job);
+        if (rval) {
+            return rval;
+        }
+    }
+
+    return 0;
+}
+
+static int
+submit_block(BlockWriter *bw)
+{
+    BlockJob *job = &bw->jobs[bw->fill];
+
+    if (job->count == 0) {
+        return 0;
+    }
+
+    if (bw->nworkers == 0) {
+        if (bw->codec != CONTAINER_CODEC_NULL) {
+            Py_BEGIN_ALLOW_THREADS
+            job->rval = compress_job(job, bw->codec, &bw->zstream);
+            Py_END_ALLOW_THREADS
+        }
+        return write_job(bw, job);
+    }
+
+    pthread_mutex_lock(&bw->lock);
+    job->rval = 0;
+    job->state = JOB_QUEUED;
+    pthread_cond_signal(&bw->work_cond);
+    pthread_mutex_unlock(&bw->lock);
+
+    bw->fill = (bw->fill + 1) % bw->njobs;
+    bw->pending++;
+
+    return write_done_jobs(bw, 0);
+}
+
+static int
+grow_job(BlockJob *job, size_t size, Stats *stats)
+{
+    char *raw;
+
+    if (size <= job->raw_size) {
+        return 0;
+    }
+    raw = (char *)realloc(job->raw, size);
+    if (raw == NULL) {
+        avro_set_error("Cannot allocate block buffer");
+        return ENOMEM;
+    }
+    stats_count_alloc(stats, job->raw_size);
+    job->raw = raw;
+    job->raw_size = size;
+    return 0;
+}
+
+static void
+free_jobs(BlockWriter *bw)
+{
+    int i;
+
+    for (i = 0; i < bw->njobs; i++) {
+        free(bw->jobs[i].raw);
+        free(bw->jobs[i].out);
+    }
+    free(bw->jobs);
+}
+
+BlockWriter *
+block_writer_new(FILE *file, container_codec_t codec, const char *sync,
+                 size_t block_size, int threads, Stats *stats)
+{
+    int i;
+    BlockWriter *bw = (BlockWriter *)calloc(1, sizeof(BlockWriter));
+
+    if (bw == NULL) {
+        avro_set_error("Cannot allocate block writer");
+        return NULL;
+    }
+
+    bw->file = file;
+    bw->codec = codec;
+    memcpy(bw->sync, sync, CONTAINER_SYNC_SIZE);
+    bw->block_size = block_size;
+    bw->stats = stats;
+
+    /* nothing to hand to a worker if there is no compression */
+    if (threads < 1 || codec == CONTAINER_CODEC_NULL) {
+        threads = 1;
+    }
+    bw->njobs = threads > 1 ? 2 * threads : 1;
+    bw->jobs = (BlockJob *)calloc(bw->njobs, sizeof(BlockJob));
+    if (bw->jobs == NULL) {
+        goto error;
+    }
+    for (i = 0; i < bw->njobs; i++) {
+        if (grow_job(&bw->jobs[i], block_size, stats)) {
+            goto error;
+        }
+    }
+
+    bw->datum_writer = avro_writer_memory(NULL, 0);
+    if (bw->datum_writer == NULL) {
+        goto error;
+    }
+
+    if (threads == 1) {
+        if (codec != CONTAINER_CODEC_NULL) {
+            if (deflate_init(&bw->zstream)) {
+                goto error;
+            }
+            bw->zstream_ok = 1;
+        }
+        return bw;
+    }
+
+    pthread_mutex_init(&bw->lock, NULL);
+    pthread_cond_init(&bw->work_cond, NULL);
+    pthread_cond_init(&bw->done_cond, NULL);
+
+    bw->workers = (pthread_t *)calloc(threads, sizeof(pthread_t));
+    if (bw->workers == NULL) {
+        goto error;
+    }
+    for (i = 0; i < threads; i++) {
+        if (pthread_create(&bw->workers[i], NULL, worker_main, bw) != 0) {
+            break;
+        }
+        bw->nworkers++;
+    }
+    if (bw->nworkers == 0) {
+        goto error;
+    }
+
+    return bw;
+
+error:
+    avro_set_error("Cannot create block writer");
+    if (bw->datum_writer != NULL) {
+        avro_writer_free(bw->datum_writer);
+    }
+    if (bw->jobs != NULL) {
+        free_jobs(bw);
+    }
+    free(bw->workers);
+    free(bw);
+    return NULL;
+}
+
+static int
+encode_value(BlockWriter *bw, avro_value_t *value)
+{
+    uint64_t start = stats_now();
+    int rval = avro_value_write(bw->datum_writer, value);
+
+    bw->stats->avro_ns += stats_now() - start;
+    return rval;
+}
+
+int
+block_writer_append_value(BlockWriter *bw, avro_value_t *value)
+{
+    int rval;
+    size_t size;
+    BlockJob *job = &bw->jobs[bw->fill];
+
+    /* buffers may have grown for a big record, but blocks stay the same */
+    avro_writer_memory_set_dest(bw->datum_writer, job->raw + job->raw_len,
+                                bw->block_size - job->raw_len);
+    rval = encode_value(bw, value);
+
+    if (rval == ENOSPC && job->count > 0) {
+        /* block is full: send it off and start a new one */
+        rval = submit_block(bw);
+        if (rval) {
+            return rval;
+        }
+        job = &bw->jobs[bw->fill];
+        avro_writer_memory_set_dest(bw->datum_writer, job->raw,
+                                    bw->block_size);
+        rval = encode_value(bw, value);
+    }
+
+    if (rval == ENOSPC) {
+        /* record on its own is bigger than a block */
+        rval = avro_value_sizeof(value, &size);
+        if (!rval) {
+            rval = grow_job(job, size, bw->stats);
+        }
+        if (!rval) {
+            avro_writer_memory_set_dest(bw->datum_writer, job->raw,
+                                        job->raw_size);
+            rval = encode_value(bw, value);
+        }
+    }
+
+    if (rval) {
+        return rval;
+    }
+
+    job->raw_len += avro_writer_tell(bw->datum_writer);
+    job->count++;
+
+    if (job->raw_len >= bw->block_size) {
+        return submit_block(bw);
+    }
+    return 0;
+}
+
+int
+block_writer_append_encoded(BlockWriter *bw, const char *buf, size_t len)
+{
+    int rval;
+    BlockJob *job = &bw->jobs[bw->fill];
+
+    if (job->count > 0 && job->raw_len + len > bw->block_size) {
+        rval = submit_block(bw);
+        if (rval) {
+            return rval;
+        }
+        job = &bw->jobs[bw->fill];
+    }
+
+    rval = grow_job(job, job->raw_len + len, bw->stats);
+    if (rval) {
+        return rval;
+    }
+
+    memcpy(job->raw + job->raw_len, buf, len);
+    job->raw_len += len;
+    job->count++;
+
+    if (job->raw_len >= bw->block_size) {
+        return submit_block(bw);
+    }
+    return 0;
+}
+
+int
+block_writer_flush(BlockWriter *bw)
+{
+    int rval = submit_block(bw);
+    uint64_t start;
+
+    if (!rval) {
+        rval = write_done_jobs(bw, 1);
+    }
+    if (!rval) {
+        start = stats_now();
+        if (fflush(bw->file) != 0) {
+            avro_set_error("Cannot flush file: %s", strerror(errno));
+            rval = EIO;
+        }
+        bw->stats->io_ns += stats_now() - start;
+    }
+    return rval;
+}
+
+int
+block_writer_close(BlockWriter *bw, int flush)
+{
+    int i;
+    int rval = flush ? block_writer_flush(bw) : 0;
+
+    if (bw->nworkers > 0) {
+        pthread_mutex_lock(&bw->lock);
+        bw->stop = 1;
+        pthread_cond_broadcast(&bw->work_cond);
+        pthread_mutex_unlock(&bw->lock);
+
+        Py_BEGIN_ALLOW_THREADS
+        for (i = 0; i < bw->nworkers; i++) {
+            pthread_join(bw->workers[i], NULL);
+        }
+        Py_END_ALLOW_THREADS
+
+        pthread_mutex_destroy(&bw->lock);
+        pthread_cond_destroy(&bw->work_cond);
+        pthread_cond_destroy(&bw->done_cond);
+    }
+
+    if (bw->zstream_ok) {
+        deflateEnd(&bw->zstream);
+    }
+    avro_writer_free(bw->datum_writer);
+    free_jobs(bw);
+    free(bw->workers);
+    free(bw);
+
+    return rval;
+}
+
+static int
+ensure_size(char **buf, size_t *size, size_t needed, Stats *stats)
+{
+    char *newbuf;
+
+    if (needed <= *size) {
+        return 0;
+    }
+    newbuf = (char *)realloc(*buf, needed);
+    if (newbuf == NULL) {
+        avro_set_error("Cannot allocate block buffer");
+        return ENOMEM;
+    }
+    stats_count_alloc(stats, *size);
+    *buf = newbuf;
+    *size = needed;
+    return 0;
+}
+
+BlockReader *
+block_reader_new(FILE *file, container_codec_t codec, const char *sync,
+                 Stats *stats)
+{
+    BlockReader *br = (BlockReader *)calloc(1, sizeof(BlockReader));
+
+    if (br == NULL) {
+        avro_set_error("Cannot allocate block reader");
+        return NULL;
+    }
+
+    br->file = file;
+    br->codec = codec;
+    memcpy(br->sync, sync, CONTAINER_SYNC_SIZE);
+    br->stats = stats;
+
+    if (codec == CONTAINER_CODEC_DEFLATE) {
+        if (inflateInit2(&br->zstream, -15) != Z_OK) {
+            avro_set_error("Cannot initialize zlib");
+            free(br);
+            return NULL;
+        }
+        br->zstream_ok = 1;
+    }
+
+    return br;
+}
+
+static int
+inflate_block(BlockReader *br, size_t len, size_t *out_len)
+{
+    z_stream *zs = &br->zstream;
+    int rc;
+
+    inflateReset(zs);
+    zs->next_in = (Bytef *)br->raw;
+    zs->avail_in = len;
+
+    for (;;) {
+        /* usually compresses less than 4:1, so start there */
+        if (zs->total_out == br->out_size
+            && ensure_size(&br->out, &br->out_size,
+                           br->out_size ? 2 * br->out_size : 4 * len + 64,
+                           br->stats)) {
+            return ENOMEM;
+        }
+        zs->next_out = (Bytef *)br->out + zs->total_out;
+        zs->avail_out = br->out_size - zs->total_out;
+
+        rc = inflate(zs, Z_NO_FLUSH);
+        if (rc == Z_STREAM_END) {
+            *out_len = zs->total_out;
+            return 0;
+        }
+        if (rc != Z_OK && !(rc == Z_BUF_ERROR && zs->avail_out == 0)) {
+            avro_set_error("Cannot decompress block: %s",
+                           zs->msg ? zs->msg : "truncated data");
+            return EILSEQ;
+        }
+    }
+}
+
+static int
+read_block(BlockReader *br, const char **data, size_t *len, int64_t *count)
+{
+    int rval;
+    int c;
+    int64_t size;
+    char sync[CONTAINER_SYNC_SIZE];
+    Stats *stats = br->stats;
+    uint64_t start = stats_now();
+
+    c = getc(br->file);
+    if (c == EOF) {
+        stats->io_ns += stats_now() - start;
+        return EOF;
+    }
+    ungetc(c, br->file);
+
+    rval = read_long(br->file, count);
+    if (!rval) {
+        rval = read_long(br->file, &size);
+    }
+    if (!rval && (*count < 0 || size < 0)) {
+        avro_set_error("Invalid block header");
+        rval = EILSEQ;
+    }
+    if (!rval) {
+        rval = ensure_size(&br->raw, &br->raw_size, size, stats);
+    }
+    if (rval) {
+        return rval;
+    }
+
+    if (fread(br->raw, 1, size, br->file) != (size_t)size
+        || fread(sync, 1, CONTAINER_SYNC_SIZE, br->file) != CONTAINER_SYNC_SIZE) {
+        avro_set_error("Truncated block");
+        return EILSEQ;
+    }
+    stats->io_ns += stats_now() - start;
+    stats->blocks++;
+    stats->compressed_bytes += size;
+    if (memcmp(sync, br->sync, CONTAINER_SYNC_SIZE) != 0) {
+        avro_set_error("Incorrect sync bytes");
+        return EILSEQ;
+    }
+
+    if (br->codec == CONTAINER_CODEC_NULL) {
+        *data = br->raw;
+        *len = size;
+        stats->uncompressed_bytes += size;
+        return 0;
+    }
+
+    start = stats_now();
+    rval = inflate_block(br, size, len);
+    stats->codec_ns += stats_now() - start;
+    *data = br->out;
+    if (!rval) {
+        stats->uncompressed_bytes += *len;
+    }
+    return rval;
+}
+
+int
+block_reader_next(BlockReader *br, const char **data, size_t *len,
+                  int64_t *count)
+{
+    int rval;
+
+    Py_BEGIN_ALLOW_THREADS
+    rval = read_block(br, data, len, count);
+    Py_END_ALLOW_THREADS
+
+    return rval;
+}
+
+char *
+block_reader_detach(BlockReader *br, size_t len)
+{
+    char **buf = br->codec == CONTAINER_CODEC_NULL ? &br->raw : &br->out;
+    size_t *size = br->codec == CONTAINER_CODEC_NULL ? &br->raw_size : &br->out_size;
+    char *data = *buf;
+    char *shrunk;
+
+    /* inflating may have left it a lot bigger than the block */
+    if (data != NULL && len > 0 && len < *size / 2) {
+        shrunk = (char *)realloc(data, len);
+        if (shrunk != NULL) {
+            data = shrunk;
+        }
+    }
+    *buf = NULL;
+    *size = 0;
+    return data;
+}
+
+void
+block_reader_free(BlockReader *br)
+{
+    if (br->zstream_ok) {
+        inflateEnd(&br->zstream);
+    }
+    free(br->raw);
+    free(br->out);
+    free(br);
+}
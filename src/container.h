@@ -0,0 +1,95 @@
+/*
+ * Copyright 2015 Byhiras (Europe) Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INC_CONTAINER_H
+#define INC_CONTAINER_H
+
+#include "Python.h"
+#include "avro.h"
+#include "stats.h"
+
+/*
+ * Avro object container framing: header, blocks and sync markers.
+ *
+ * Avro-C keeps its datafile internals private, so the features that need
+ * control over individual blocks go through here instead.  Only the codecs
+ * that need nothing beyond zlib are handled.
+ */
+
+#define CONTAINER_SYNC_SIZE 16
+
+typedef enum {
+    CONTAINER_CODEC_NULL,
+    CONTAINER_CODEC_DEFLATE
+} container_codec_t;
+
+typedef struct BlockWriter BlockWriter;
+typedef struct BlockReader BlockReader;
+
+/* returns 0 and sets codec if we can handle the named codec, else EINVAL */
+int container_codec_from_name(const char *name, container_codec_t *codec);
+
+/*
+ * Reads a file header, returning the schema (new reference), the codec
+ * name and the sync marker.
+ */
+int container_read_header(FILE *file, avro_schema_t *schema,
+                          char *codec_name, size_t codec_size, char *sync);
+
+/* writes a new file header, filling in a fresh sync marker */
+int container_write_header(FILE *file, avro_schema_t schema,
+                           const char *codec_name, char *sync);
+
+/*
+ * Create a writer for blocks of at least block_size bytes.  With
+ * threads > 1, full blocks are compressed by a pool of worker threads
+ * and written out in order by the calling thread.  Block counts, sizes
+ * and times are added to stats.
+ */
+BlockWriter *block_writer_new(FILE *file, container_codec_t codec,
+                              const char *sync, size_t block_size,
+                              int threads, Stats *stats);
+
+int block_writer_append_value(BlockWriter *bw, avro_value_t *value);
+
+/* append an already encoded datum */
+int block_writer_append_encoded(BlockWriter *bw, const char *buf, size_t len);
+
+/* write out all buffered records */
+int block_writer_flush(BlockWriter *bw);
+
+/* optionally flush, then stop the worker threads and free the writer */
+int block_writer_close(BlockWriter *bw, int flush);
+
+BlockReader *block_reader_new(FILE *file, container_codec_t codec,
+                              const char *sync, Stats *stats);
+
+/*
+ * Read and decompress the next block.  data stays valid until the next
+ * call.  Returns 0, EOF at the end of the file, or an error code.
+ */
+int block_reader_next(BlockReader *br, const char **data, size_t *len,
+                      int64_t *count);
+
+/*
+ * Take the buffer holding the current block, len bytes of data, so it
+ * outlives the next call.  Free it with free().
+ */
+char *block_reader_detach(BlockReader *br, size_t len);
+
+void block_reader_free(BlockReader *br);
+
+#endif
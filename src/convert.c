@@ -19,6 +19,8 @@
 #include "record.h"
 #include "avroenum.h"
 #include "error.h"
+#include "validator.h"
+#include "varint.h"
 #include <avro/schema.h>
 
 static PyObject *avro_types_type = NULL;
@@ -38,6 +40,30 @@ get_avro_types_type()
     return avro_types_type;
 }
 
+int
+set_avro_types(ConvertInfo *info, PyObject *types, avro_schema_t schema)
+{
+    if (types == NULL || !PyObject_IsTrue(types)) {
+        info->types = NULL;
+        return 0;
+    }
+
+    if ((PyObject *)Py_TYPE(types) == get_avro_types_type()) {
+        Py_INCREF(types);
+        info->types = types;
+        return 0;
+    }
+
+    info->types = PyObject_CallFunctionObjArgs(get_avro_types_type(), NULL);
+    if (info->types == NULL) {
+        return -1;
+    }
+    if (schema != NULL) {
+        declare_types(info, schema);
+    }
+    return 0;
+}
+
 PyObject *
 declare_types(ConvertInfo *info, avro_schema_t schema)
 {
@@ -122,6 +148,167 @@ declare_types(ConvertInfo *info, avro_schema_t schema)
     return NULL;
 }
 
+static PyObject *array_type = NULL;
+
+/*
+ * An encoded array of floats or doubles, which are little endian whatever
+ * the host, copied a block at a time.
+ */
+static int
+copy_fixed_array(const char *buf, size_t len, int width, char *out, size_t n)
+{
+    const char *pos = buf;
+    const char *end = buf + len;
+    const uint16_t one = 1;
+    int64_t count;
+    int64_t block_size;
+    size_t done = 0;
+    size_t i;
+    int j;
+
+    for (;;) {
+        if (varint_decode_longs(&pos, end, &count, 1)) {
+            return EILSEQ;
+        }
+        if (count == 0) {
+            break;
+        }
+        if (count < 0) {
+            if (count == INT64_MIN
+                || varint_decode_longs(&pos, end, &block_size, 1)) {
+                return EILSEQ;
+            }
+            count = -count;
+        }
+        if ((uint64_t)count > n - done
+            || (uint64_t)count * width > (uint64_t)(end - pos)) {
+            return EILSEQ;
+        }
+        memcpy(out + done * width, pos, (size_t)count * width);
+        pos += (size_t)count * width;
+        done += (size_t)count;
+    }
+    if (done != n) {
+        return EILSEQ;
+    }
+
+    if (*(const char *)&one == 0) {
+        for (i = 0; i < n; i++) {
+            char *item = out + i * width;
+            for (j = 0; j < width / 2; j++) {
+                char c = item[j];
+                item[j] = item[width - 1 - j];
+                item[width - 1 - j] = c;
+            }
+        }
+    }
+    return 0;
+}
+
+/*
+ * The next array of ints, longs, floats or doubles as an array.array,
+ * decoded straight from the block, or NULL to convert it item by item.  If the counts
+ * don't match we have lost our place, so convert the rest.
+ */
+static PyObject *
+typed_array(BlockViews *views, avro_value_t *value, size_t count)
+{
+    avro_schema_t items = avro_schema_array_items(avro_value_get_schema(value));
+    const char *typecode;
+    int width;
+    int fixed = 0;
+    int rval;
+    size_t offset;
+    Py_buffer view;
+    PyObject *zero;
+    PyObject *result;
+
+    switch (avro_typeof(items)) {
+    case AVRO_INT32:
+        typecode = "i";
+        width = 4;
+        break;
+    case AVRO_INT64:
+        typecode = sizeof(long) == 8 ? "l" : "q";
+        width = 8;
+        break;
+    case AVRO_FLOAT:
+        typecode = "f";
+        width = 4;
+        fixed = 1;
+        break;
+    case AVRO_DOUBLE:
+        typecode = "d";
+        width = 8;
+        fixed = 1;
+        break;
+    default:
+        return NULL;
+    }
+
+    if (views->in_map || views->arrays_next >= views->arrays_count) {
+        return NULL;
+    }
+    if (views->arrays[2 * views->arrays_next + 1] != count) {
+        views->arrays_next = views->arrays_count;
+        return NULL;
+    }
+    offset = views->arrays[2 * views->arrays_next];
+    views->arrays_next++;
+
+    if (array_type == NULL) {
+        PyObject *module = PyImport_ImportModule("array");
+        if (module == NULL) {
+            return NULL;
+        }
+        array_type = PyObject_GetAttrString(module, "array");
+        Py_DECREF(module);
+        if (array_type == NULL) {
+            return NULL;
+        }
+    }
+
+    /* one zero repeated count times sizes the array in one go, then
+     * the items are decoded straight into its buffer */
+    zero = PyObject_CallFunction(array_type, "s[i]", typecode, 0);
+    if (zero == NULL) {
+        return NULL;
+    }
+    result = PySequence_InPlaceRepeat(zero, (Py_ssize_t)count);
+    Py_DECREF(zero);
+    if (result == NULL) {
+        return NULL;
+    }
+    if (PyObject_GetBuffer(result, &view, PyBUF_WRITABLE) < 0) {
+        Py_DECREF(result);
+        return NULL;
+    }
+    if ((size_t)view.len != count * width) {
+        PyBuffer_Release(&view);
+        Py_DECREF(result);
+        PyErr_SetString(PyExc_ValueError, "Unexpected array item size");
+        return NULL;
+    }
+
+    if (fixed) {
+        rval = copy_fixed_array(views->data + views->base + offset,
+                                views->len - offset, width,
+                                view.buf, count);
+    } else {
+        rval = varint_decode_array(views->data + views->base + offset,
+                                   views->len - offset, width,
+                                   view.buf, count);
+    }
+    PyBuffer_Release(&view);
+    if (rval) {
+        Py_DECREF(result);
+        PyErr_SetString(PyExc_ValueError, "Invalid array encoding");
+        return NULL;
+    }
+
+    return result;
+}
+
 static PyObject *
 array_to_python(ConvertInfo *info, avro_value_t *value)
 {
@@ -131,6 +318,13 @@ array_to_python(ConvertInfo *info, avro_value_t *value)
 
     avro_value_get_size(value, &element_count);
 
+    if (info->views != NULL && info->views->arrays_count > 0) {
+        result = typed_array(info->views, value, element_count);
+        if (result != NULL || PyErr_Occurred()) {
+            return result;
+        }
+    }
+
     result = PyList_New(element_count);
 
     for (i = 0; i < element_count; i++) {
@@ -187,6 +381,33 @@ enum_to_python_object(ConvertInfo *info, avro_value_t *value)
     return (PyObject *)obj;
 }
 
+static PyObject *
+string_to_python(ConvertInfo *info, const char *buf, size_t size)
+{
+    if (info->strings != NULL && info->dedup) {
+        return string_cache_get(info->strings, buf, size);
+    }
+    return utf8_to_pystring(buf, size);
+}
+
+/* convert field i of a record, deduplicating its strings if asked to */
+static PyObject *
+field_to_python(ConvertInfo *info, avro_value_t *value, size_t i,
+                avro_value_t *field_value)
+{
+    PyObject *result;
+    int dedup = info->dedup;
+
+    if (info->strings != NULL && !string_cache_all(info->strings)) {
+        info->dedup = string_cache_field_wanted(
+            info->strings, avro_value_get_schema(value), i);
+    }
+    result = avro_to_python(info, field_value);
+    info->dedup = dedup;
+
+    return result;
+}
+
 static PyObject *
 record_to_python(ConvertInfo *info, avro_value_t *value)
 {
@@ -205,7 +426,7 @@ record_to_python(ConvertInfo *info, avro_value_t *value)
         avro_value_get_by_index(value, i, &field_value, &field_name);
 
         pykey = (PyObject *)chars_to_pystring(field_name);
-        pyelement_value = avro_to_python(info, &field_value);
+        pyelement_value = field_to_python(info, value, i, &field_value);
 
         /* increfs key and value */
         PyDict_SetItem(result, pykey, pyelement_value);
@@ -238,7 +459,7 @@ record_to_python_object(ConvertInfo *info, avro_value_t *value)
 
         avro_value_get_by_index(value, i, &field_value, NULL);
 
-        pyelement_value = avro_to_python(info, &field_value);
+        pyelement_value = field_to_python(info, value, i, &field_value);
 
         obj->fields[i] = pyelement_value;
     }
@@ -263,8 +484,18 @@ map_to_python(ConvertInfo *info, avro_value_t *value)
 
         avro_value_get_by_index(value, i, &element_value, &key);
 
-        pykey = (PyObject *)chars_to_pystring(key);
-        pyelement_value = avro_to_python(info, &element_value);
+        if (info->strings != NULL && info->dedup) {
+            pykey = string_cache_get(info->strings, key, strlen(key));
+        } else {
+            pykey = (PyObject *)chars_to_pystring(key);
+        }
+        if (info->views != NULL) {
+            info->views->in_map++;
+            pyelement_value = avro_to_python(info, &element_value);
+            info->views->in_map--;
+        } else {
+            pyelement_value = avro_to_python(info, &element_value);
+        }
 
         /* increfs key and value */
         PyDict_SetItem(result, pykey, pyelement_value);
@@ -285,6 +516,28 @@ union_to_python(ConvertInfo *info, avro_value_t *value)
     return avro_to_python(info, &branch_value);
 }
 
+/*
+ * The next bytes value as a slice of the block, or NULL to copy it.  If
+ * the sizes don't match we have lost our place, so copy the rest.
+ */
+static PyObject *
+bytes_view(BlockViews *views, size_t size)
+{
+    size_t start;
+
+    if (views->block == NULL || views->in_map
+        || views->bytes_next >= views->bytes_count) {
+        return NULL;
+    }
+    if (views->bytes[2 * views->bytes_next + 1] != size) {
+        views->bytes_next = views->bytes_count;
+        return NULL;
+    }
+    start = views->base + views->bytes[2 * views->bytes_next];
+    views->bytes_next++;
+    return PySequence_GetSlice(views->block, start, start + size);
+}
+
 /* returns new reference */
 PyObject *
 avro_to_python(ConvertInfo *info, avro_value_t *value)
@@ -303,6 +556,12 @@ avro_to_python(ConvertInfo *info, avro_value_t *value)
             const void  *buf;
             size_t  size;
             avro_value_get_bytes(value, &buf, &size);
+            if (info->views != NULL) {
+                PyObject *view = bytes_view(info->views, size);
+                if (view != NULL || PyErr_Occurred()) {
+                    return view;
+                }
+            }
             /* got pointer into underlying value. no need to free */
             return chars_size_to_pybytes(buf, size);
         }
@@ -350,7 +609,7 @@ avro_to_python(ConvertInfo *info, avro_value_t *value)
             size_t  size;
             avro_value_get_string(value, &buf, &size);
             /* For strings, size includes the NUL terminator. */
-            return chars_size_to_pystring(buf, size - 1);
+            return string_to_python(info, buf, size - 1);
         }
 
     case AVRO_ARRAY:
@@ -370,7 +629,7 @@ avro_to_python(ConvertInfo *info, avro_value_t *value)
             const void  *buf;
             size_t  size;
             avro_value_get_fixed(value, &buf, &size);
-            return chars_size_to_pystring((const char *)buf, size);
+            return utf8_to_pystring((const char *)buf, size);
         }
 
     case AVRO_MAP:
@@ -393,9 +652,44 @@ avro_to_python(ConvertInfo *info, avro_value_t *value)
     }
 }
 
+/*
+ * Where in the datum a write failed, built up innermost first as the error
+ * unwinds, e.g. "User.addresses[2].street".
+ */
+#define ERROR_PATH_SIZE 256
+
+typedef struct {
+    char buf[ERROR_PATH_SIZE];
+    size_t len;
+} ErrorPath;
+
+static void
+path_prepend(ErrorPath *path, const char *format, ...)
+{
+    char segment[ERROR_PATH_SIZE];
+    size_t n;
+    va_list argp;
+
+    va_start(argp, format);
+    PyOS_vsnprintf(segment, sizeof(segment), format, argp);
+    va_end(argp);
+
+    n = strlen(segment);
+    if (path->len + n >= sizeof(path->buf)) {
+        return;  /* keep the innermost part */
+    }
+    memmove(path->buf + n, path->buf, path->len + 1);
+    memcpy(path->buf, segment, n);
+    path->len += n;
+}
+
+static int python_to_value(ConvertInfo *info, PyObject *pyobj,
+                           avro_value_t *dest, ErrorPath *path);
+
 /* assumes dest is already correct type. */
 static int
-python_to_array(ConvertInfo *info, PyObject *pyobj, avro_value_t *dest)
+python_to_array(ConvertInfo *info, PyObject *pyobj, avro_value_t *dest,
+                ErrorPath *path)
 {
     int rval;
     Py_ssize_t i;
@@ -418,9 +712,10 @@ python_to_array(ConvertInfo *info, PyObject *pyobj, avro_value_t *dest)
         avro_value_t child;
 
         avro_value_append(dest, &child, NULL);
-        rval = python_to_avro(info, pyval, &child);
+        rval = python_to_value(info, pyval, &child, path);
         Py_DECREF(pyval);
         if (rval) {
+            path_prepend(path, "[%zd]", i);
             return rval;
         }
     }
@@ -429,7 +724,8 @@ python_to_array(ConvertInfo *info, PyObject *pyobj, avro_value_t *dest)
 }
 
 static int
-python_to_map(ConvertInfo *info, PyObject *pyobj, avro_value_t *dest)
+python_to_map(ConvertInfo *info, PyObject *pyobj, avro_value_t *dest,
+              ErrorPath *path)
 {
     int rval = 0;
     size_t i;
@@ -450,14 +746,22 @@ python_to_map(ConvertInfo *info, PyObject *pyobj, avro_value_t *dest)
     for (i = 0; !rval && i < element_count; i++) {
         PyObject *pykey = PySequence_GetItem(keys, i);
         PyObject *val = PySequence_GetItem(vals, i);
+        PyObject *tmp;
+        Py_ssize_t key_len;
+        const char *key = pystring_to_utf8(pykey, &key_len, &tmp);
         avro_value_t child;
 
-        PyObject *key_bytes = pystring_to_pybytes(pykey);
-        rval = avro_value_add(dest, pybytes_to_chars(key_bytes), &child, NULL, NULL);
-        Py_DECREF(key_bytes);
-
-        if (!rval) {
-            rval = python_to_avro(info, val, &child);
+        if (key == NULL) {
+            rval = set_type_error(EINVAL, pykey);
+        } else {
+            rval = set_avro_error(avro_value_add(dest, key, &child, NULL, NULL));
+            if (!rval) {
+                rval = python_to_value(info, val, &child, path);
+            }
+            if (rval) {
+                path_prepend(path, "[%.40s]", key);
+            }
+            Py_XDECREF(tmp);
         }
 
         Py_DECREF(pykey);
@@ -477,9 +781,6 @@ get_branch_index(ConvertInfo *info, PyObject *pyobj, avro_schema_t schema)
     avro_schema_t branch_schema;
     int branch_index;
 
-    if (PyDict_Check(pyobj))
-        return validate(pyobj, schema);
-
     if (pyobj == Py_None) {
         typename = "null";
     } else {
@@ -496,6 +797,18 @@ get_branch_index(ConvertInfo *info, PyObject *pyobj, avro_schema_t schema)
     branch_schema = avro_schema_union_branch_by_name(schema,
                                                      &branch_index,
                                                      typename);
+    if (branch_schema != NULL && avro_typeof(branch_schema) == AVRO_INT32
+        && validate_int32(pyobj) != 0) {
+        /* too big for an int, so a long if there is one, as validate() says */
+        int long_index;
+        avro_schema_t long_schema =
+            avro_schema_union_branch_by_name(schema, &long_index, "long");
+        if (long_schema != NULL) {
+            branch_schema = long_schema;
+            branch_index = long_index;
+        }
+    }
+
     if (branch_schema == NULL) {
         /* maybe Python "float" vs avro "double" */
         if (PyFloat_CheckExact(pyobj)) {
@@ -537,22 +850,28 @@ validate(PyObject *pyobj, avro_schema_t schema) {
     case AVRO_STRING:
         return is_pystring(pyobj) ? 0 : -1;
     case AVRO_INT32:
+        return validate_int32(pyobj);
     case AVRO_INT64:
-        /* FIXME: discriminate by comparing value to 32/64 bit limits */
-        return (is_pyint(pyobj) || PyLong_Check(pyobj)) ? 0 : -1;
+        return validate_int64(pyobj);
     case AVRO_FLOAT:
     case AVRO_DOUBLE:
         return (is_pyint(pyobj) || PyLong_Check(pyobj) ||
                 PyFloat_Check(pyobj)) ? 0 : -1;
     case AVRO_FIXED:
-        /* FIXME: check that string size == expected size */
-        return is_pystring(pyobj) ? 0 : -1;
+        return validate_fixed(pyobj, avro_schema_fixed_size(schema));
     case AVRO_ENUM:
         {
             if (is_pystring(pyobj)) {
-                PyObject *pybytes = pystring_to_pybytes(pyobj);
-                int res = avro_schema_enum_get_by_name(schema, pybytes_to_chars(pybytes));
-                Py_DECREF(pybytes);
+                PyObject *tmp;
+                Py_ssize_t len;
+                const char *name = pystring_to_utf8(pyobj, &len, &tmp);
+                int res;
+                if (name == NULL) {
+                    PyErr_Clear();
+                    return -1;
+                }
+                res = avro_schema_enum_get_by_name(schema, name);
+                Py_XDECREF(tmp);
                 return res;
             } else if (is_pyint(pyobj)) {
                 int index = pyint_to_long(pyobj);
@@ -620,23 +939,106 @@ validate(PyObject *pyobj, avro_schema_t schema) {
     }
 }
 
+/*
+ * A dict could be a record or a map.  With one such branch it's written
+ * straight there; otherwise each is tried in turn, and setting the next
+ * branch throws away whatever a failed attempt wrote.
+ */
 static int
-python_to_union(ConvertInfo *info, PyObject *pyobj, avro_value_t *dest)
+python_dict_to_union(ConvertInfo *info, PyObject *pyobj, avro_value_t *dest,
+                     ErrorPath *path)
 {
-    int branch_index = get_branch_index(info, pyobj, avro_value_get_schema(dest));
+    int rval = EINVAL;
+    avro_schema_t schema = avro_value_get_schema(dest);
+    size_t union_size = avro_schema_union_size(schema);
+    size_t i;
     avro_value_t branch;
+    int tried = 0;
+
+    for (i = 0; i < union_size; i++) {
+        avro_schema_t branch_schema = avro_schema_union_branch(schema, i);
+
+        while (avro_typeof(branch_schema) == AVRO_LINK) {
+            branch_schema = avro_schema_link_target(branch_schema);
+        }
+        if (avro_typeof(branch_schema) != AVRO_RECORD
+            && avro_typeof(branch_schema) != AVRO_MAP) {
+            continue;
+        }
 
+        if (tried) {
+            /* roll back the failed attempt, if the dict just didn't fit */
+            if (PyErr_Occurred()
+                && !PyErr_ExceptionMatches(PyExc_ValueError)
+                && !PyErr_ExceptionMatches(PyExc_TypeError)) {
+                return rval;
+            }
+            PyErr_Clear();
+            path->buf[0] = '\0';
+            path->len = 0;
+        }
+        tried = 1;
+
+        rval = set_avro_error(avro_value_set_branch(dest, i, &branch));
+        if (!rval) {
+            rval = python_to_value(info, pyobj, &branch, path);
+        }
+        if (!rval) {
+            return 0;
+        }
+    }
+
+    if (!tried) {
+        PyErr_Format(PyExc_TypeError, "no record or map in union for dict");
+    }
+    return rval;
+}
+
+static int
+python_to_union(ConvertInfo *info, PyObject *pyobj, avro_value_t *dest,
+                ErrorPath *path)
+{
+    int branch_index;
+    avro_value_t branch;
+
+    if (PyDict_Check(pyobj)) {
+        return python_dict_to_union(info, pyobj, dest, path);
+    }
+
+    branch_index = get_branch_index(info, pyobj, avro_value_get_schema(dest));
     if (branch_index < 0) {
         return -1;
     }
 
     avro_value_set_branch(dest, branch_index, &branch);
 
-    return python_to_avro(info, pyobj, &branch);
+    return python_to_value(info, pyobj, &branch, path);
+}
+
+/* whether a missing field can be written as null */
+static int
+is_nullable(avro_schema_t schema)
+{
+    size_t i;
+
+    switch (avro_typeof(schema)) {
+    case AVRO_NULL:
+        return 1;
+    case AVRO_UNION:
+        for (i = 0; i < avro_schema_union_size(schema); i++) {
+            if (avro_typeof(avro_schema_union_branch(schema, i)) == AVRO_NULL) {
+                return 1;
+            }
+        }
+        return 0;
+    default:
+        return 0;
+    }
 }
 
 static int
-python_to_record(ConvertInfo *info, PyObject *pyobj, avro_value_t *dest)
+python_to_record(ConvertInfo *info, PyObject *pyobj, avro_value_t *dest,
+                 ErrorPath *path)
 {
     int rval;
     size_t i;
@@ -653,28 +1055,33 @@ python_to_record(ConvertInfo *info, PyObject *pyobj, avro_value_t *dest)
 
         if (PyDict_Check(pyobj)) {
             pyval = PyDict_GetItemString(pyobj, field_name);  /* borrowed */
-            if (pyval == NULL) {
-                PyErr_Clear();
-                /* FIXME: check that this not a required field? */
-                pyval = Py_None;
-            }
         } else {
             pyval = PyObject_GetAttrString(pyobj, field_name);  /* new */
-            if (pyval == NULL) {
+            must_decref = (pyval != NULL);
+        }
+
+        if (pyval == NULL) {
+            if (PyErr_Occurred()) {
+                if (!PyErr_ExceptionMatches(PyExc_AttributeError)) {
+                    path_prepend(path, ".%s", field_name);
+                    return EINVAL;
+                }
                 PyErr_Clear();
-                continue;
-            } else {
-                must_decref = 1;
             }
+            if (!is_nullable(avro_value_get_schema(&field_value))) {
+                PyErr_SetString(PyExc_ValueError, "missing required field");
+                path_prepend(path, ".%s", field_name);
+                return EINVAL;
+            }
+            pyval = Py_None;
         }
 
-        rval = python_to_avro(info, pyval, &field_value);
+        rval = python_to_value(info, pyval, &field_value, path);
         if (must_decref) {
             Py_DECREF(pyval);
         }
         if (rval) {
-            const char *record_name = avro_schema_name(avro_value_get_schema(dest));
-            set_error_prefix("when writing to %s.%s, ", record_name, field_name);
+            path_prepend(path, ".%s", field_name);
             return rval;
         }
     }
@@ -682,8 +1089,9 @@ python_to_record(ConvertInfo *info, PyObject *pyobj, avro_value_t *dest)
     return 0;
 }
 
-int
-python_to_avro(ConvertInfo *info, PyObject *pyobj, avro_value_t *dest)
+static int
+python_to_value(ConvertInfo *info, PyObject *pyobj, avro_value_t *dest,
+                ErrorPath *path)
 {
     if (pyobj == NULL) {
         PyErr_Format(PyExc_TypeError, "Missing object.  Expected a %d\n", avro_value_get_type(dest));
@@ -731,6 +1139,10 @@ python_to_avro(ConvertInfo *info, PyObject *pyobj, avro_value_t *dest)
             if (retval == -1L && PyErr_Occurred()) {
                 return set_type_error(EINVAL, pyobj);
             }
+            if (retval < INT32_MIN || retval > INT32_MAX) {
+                PyErr_SetString(PyExc_ValueError, "out of range for int");
+                return set_type_error(EINVAL, pyobj);
+            }
             return set_avro_error(avro_value_set_int(dest, retval));
         }
     case AVRO_INT64:
@@ -745,20 +1157,21 @@ python_to_avro(ConvertInfo *info, PyObject *pyobj, avro_value_t *dest)
         return set_avro_error(avro_value_set_null(dest));
     case AVRO_STRING:
         {
-            char *buf;
+            const char *buf;
             Py_ssize_t len;
             int rval;
-            PyObject *pybytes = pystring_to_pybytes(pyobj);
-            if (pybytes == NULL || pybytes_to_chars_size(pybytes, &buf, &len) < 0) {
-                Py_XDECREF(pybytes);
+            PyObject *tmp;
+            buf = pystring_to_utf8(pyobj, &len, &tmp);
+            if (buf == NULL) {
                 return set_type_error(EINVAL, pyobj);
             }
+            /* the UTF-8 is NUL terminated */
             rval = avro_value_set_string_len(dest, buf, len + 1);
-            Py_DECREF(pybytes);
+            Py_XDECREF(tmp);
             return set_avro_error(rval);
         }
     case AVRO_ARRAY:
-        return python_to_array(info, pyobj, dest);
+        return python_to_array(info, pyobj, dest, path);
     case AVRO_ENUM:
         {
             int index = validate(pyobj, avro_value_get_schema(dest));
@@ -771,23 +1184,50 @@ python_to_avro(ConvertInfo *info, PyObject *pyobj, avro_value_t *dest)
         {
             char *buf;
             Py_ssize_t len;
+            int rval;
             PyObject *pybytes = pystring_to_pybytes(pyobj);
             if (pybytes == NULL || pybytes_to_chars_size(pybytes, &buf, &len) < 0) {
                 Py_XDECREF(pybytes);
                 return set_type_error(EINVAL, pyobj);
             }
+            rval = avro_value_set_fixed(dest, buf, len);
             Py_DECREF(pybytes);
-            return avro_value_set_fixed(dest, buf, len);
+            return set_avro_error(rval);
         }
     case AVRO_MAP:
-        return python_to_map(info, pyobj, dest);
+        return python_to_map(info, pyobj, dest, path);
     case AVRO_RECORD:
-        return python_to_record(info, pyobj, dest);
+        return python_to_record(info, pyobj, dest, path);
     case AVRO_UNION:
-        return python_to_union(info, pyobj, dest);
+        return python_to_union(info, pyobj, dest, path);
     default:
         return -1;
     }
 
     return 0;
 }
+
+int
+python_to_avro(ConvertInfo *info, PyObject *pyobj, avro_value_t *dest)
+{
+    int rval;
+    ErrorPath path;
+
+    path.buf[0] = '\0';
+    path.len = 0;
+
+    rval = python_to_value(info, pyobj, dest, &path);
+    if (rval && path.len > 0) {
+        /* start the path from the outermost record */
+        avro_value_t current = *dest;
+        while (avro_value_get_type(&current) == AVRO_UNION
+               && !avro_value_get_current_branch(&current, &current)) {
+        }
+        if (avro_value_get_type(&current) == AVRO_RECORD) {
+            path_prepend(&path, "%s",
+                         avro_schema_name(avro_value_get_schema(&current)));
+        }
+        set_error_prefix("when writing to %s, ", path.buf);
+    }
+    return rval;
+}
@@ -19,9 +19,35 @@
 
 #include "Python.h"
 #include "avro.h"
+#include "strcache.h"
+
+/*
+ * Where the values of the record being converted are in its block, so
+ * that bytes values can be returned as slices of block (a memoryview)
+ * instead of copies, and arrays of ints, longs, floats and doubles
+ * decoded straight into an array.array.  Pairs are offset from base, and
+ * length or item count, in the order the values are decoded; values
+ * inside maps are converted the usual way.
+ */
+typedef struct {
+    PyObject *block;       /* NULL to copy bytes values */
+    const char *data;
+    size_t base;
+    size_t len;            /* of the record */
+    const size_t *bytes;
+    size_t bytes_count;
+    size_t bytes_next;
+    const size_t *arrays;
+    size_t arrays_count;
+    size_t arrays_next;
+    int in_map;
+} BlockViews;
 
 typedef struct {
     PyObject *types;
+    BlockViews *views;  /* NULL to convert everything the usual way */
+    StringCache *strings;  /* NULL to make every string afresh */
+    int dedup;          /* whether the value being converted uses strings */
 } ConvertInfo;
 
 /*
@@ -38,6 +64,14 @@ int python_to_avro(ConvertInfo *info, PyObject *pyobj, avro_value_t *);
 
 PyObject *get_avro_types_type(void);
 
+/*
+ * Set info->types from a types= argument.  An AvroTypes object is
+ * shared, and any other true value makes a new one with the types of
+ * schema declared, unless schema is NULL.  Returns -1 with a Python
+ * error set on failure.
+ */
+int set_avro_types(ConvertInfo *info, PyObject *types, avro_schema_t schema);
+
 PyObject *declare_types(ConvertInfo *info, avro_schema_t schema);
 
 #endif
@@ -14,35 +14,60 @@
  * limitations under the License.
  */
 
-/* PyArg_ParseTuple "s#" needs this */
 #define PY_SSIZE_T_CLEAN
 
 #include "deserializer.h"
 #include "convert.h"
 #include "structmember.h"
 #include "error.h"
+#include "skip.h"
+#include "fingerprint.h"
+#include "avroschema.h"
 
 
+/* the schema we decode into, for data written with writer_schema */
+static avro_schema_t
+output_schema(AvroDeserializer *self, avro_schema_t writer_schema)
+{
+    if (self->resolver != NULL) {
+        return self->resolver->reader_schema;
+    }
+    if (self->single_object && self->registry.reader_schema != NULL) {
+        return self->registry.reader_schema;
+    }
+    return writer_schema;
+}
+
 static int
 AvroDeserializer_init(AvroDeserializer *self, PyObject *args, PyObject *kwds)
 {
-    int rval;
     PyObject *types = NULL;
-    const char *schema_json;
-    static char *kwlist[] = {"schema", "types", NULL};
+    PyObject *pyschema;
+    PyObject *pyreader_schema = Py_None;
+    avro_schema_t reader_schema = NULL;
+    int single_object = 0;
+    PyObject *dedup_strings = Py_None;
+    Py_ssize_t dedup_size = STRING_CACHE_DEFAULT_SIZE;
+    uint64_t fingerprint;
+    static char *kwlist[] = {"schema", "types", "reader_schema",
+                             "single_object", "dedup_strings", "dedup_size",
+                             NULL};
 
     self->flags = 0;
     self->iface = NULL;
+    self->resolver = NULL;
+    self->single_object = 0;
+    self->info.strings = NULL;
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|O", kwlist,
-                                     &schema_json, &types)) {
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|OOiOn", kwlist,
+                                     &pyschema, &types,
+                                     &pyreader_schema, &single_object,
+                                     &dedup_strings, &dedup_size)) {
         return -1;
     }
 
-    rval = avro_schema_from_json(schema_json, 0, &self->schema, NULL);
-    if (rval != 0 || self->schema == NULL) {
-        PyErr_Format(PyExc_IOError, "Error reading schema: %s",
-                     avro_strerror());
+    self->schema = get_avro_schema(pyschema, &fingerprint);
+    if (self->schema == NULL) {
         return -1;
     }
     self->flags |= DESERIALIZER_SCHEMA_OK;
@@ -54,6 +79,32 @@ AvroDeserializer_init(AvroDeserializer *self, PyObject *args, PyObject *kwds)
         return -1;
     }
 
+    if (pyreader_schema != Py_None) {
+        reader_schema = get_avro_schema(pyreader_schema, NULL);
+        if (reader_schema == NULL) {
+            return -1;
+        }
+    }
+
+    if (single_object) {
+        /* the registry keeps our reference to reader_schema */
+        registry_init(&self->registry, reader_schema);
+        self->single_object = 1;
+        if (registry_add(&self->registry, fingerprint, self->schema) == NULL) {
+            PyErr_Format(PyExc_ValueError, "Cannot resolve schemas: %s",
+                         avro_strerror());
+            return -1;
+        }
+    } else if (reader_schema != NULL) {
+        self->resolver = resolver_new(self->schema, reader_schema);
+        avro_schema_decref(reader_schema);
+        if (self->resolver == NULL) {
+            PyErr_Format(PyExc_ValueError, "Cannot resolve schemas: %s",
+                         avro_strerror());
+            return -1;
+        }
+    }
+
     self->datum_reader = avro_reader_memory(NULL, 0);
     if (!self->datum_reader) {
         PyErr_NoMemory();
@@ -61,22 +112,18 @@ AvroDeserializer_init(AvroDeserializer *self, PyObject *args, PyObject *kwds)
     }
     self->flags |= DESERIALIZER_READER_OK;
 
-    /* copied verbatim from filereader */
-    if (types != NULL && PyObject_IsTrue(types)) {
-        /* we still haven't incref'ed types here */
-        if (Py_TYPE(types) == get_avro_types_type()) {
-            Py_INCREF(types);
-            self->info.types = types;
-        } else {
-            self->info.types = PyObject_CallFunctionObjArgs(
-                  (PyObject *) get_avro_types_type(), NULL);
-            if (self->info.types == NULL) {
-                return -1;
-            }
-            declare_types(&self->info, self->schema);
-        }
-    } else {
-        self->info.types = NULL;
+    self->info.views = NULL;
+
+    self->info.strings = string_cache_new(dedup_strings, dedup_size,
+                                          &self->stats);
+    if (self->info.strings == NULL && PyErr_Occurred()) {
+        return -1;
+    }
+    self->info.dedup = self->info.strings != NULL
+        && string_cache_all(self->info.strings);
+
+    if (set_avro_types(&self->info, types, output_schema(self, self->schema))) {
+        return -1;
     }
 
     return 0;
@@ -84,6 +131,14 @@ AvroDeserializer_init(AvroDeserializer *self, PyObject *args, PyObject *kwds)
 
 static int
 do_close(AvroDeserializer* self) {
+    if (self->resolver != NULL) {
+        resolver_free(self->resolver);
+        self->resolver = NULL;
+    }
+    if (self->single_object) {
+        registry_clear(&self->registry);
+        self->single_object = 0;
+    }
     if (self->flags & DESERIALIZER_READER_OK) {
         avro_reader_free(self->datum_reader);
         self->flags &= ~DESERIALIZER_READER_OK;
@@ -96,6 +151,8 @@ do_close(AvroDeserializer* self) {
         avro_value_iface_decref(self->iface);
         self->iface = NULL;
     }
+    string_cache_free(self->info.strings);
+    self->info.strings = NULL;
     return 0;
 }
 
@@ -106,33 +163,265 @@ AvroDeserializer_dealloc(AvroDeserializer *self)
     Py_TYPE(self)->tp_free((PyObject*)self);
 }
 
+/*
+ * Decode one datum into value, which avro_value_read resets first, or
+ * into the resolver's or registry's value.  With consumed NULL the datum
+ * fills the buffer, otherwise it is at the start of the buffer and
+ * *consumed is set to its size, which we find by stepping over it first:
+ * Avro-C can't tell us how much it read.
+ */
 static PyObject *
-AvroDeserializer_deserialize(AvroDeserializer *self, PyObject *args)
+read_datum(AvroDeserializer *self, avro_value_t *value,
+           const char *buffer, size_t buffer_size, size_t *consumed)
 {
     int rval;
+    size_t header = 0;
+    size_t size;
+    uint64_t fingerprint;
+    uint64_t start = stats_now();
+    uint64_t decoded;
+    PyObject *result;
+    avro_schema_t schema = self->schema;
+    RegistryEntry *entry = NULL;
+
+    if (self->single_object) {
+        rval = parse_single_object_header(buffer, buffer_size, &fingerprint);
+        if (rval) {
+            set_avro_error(rval);
+            set_error_prefix("Read error: ");
+            return NULL;
+        }
+        entry = registry_find(&self->registry, fingerprint);
+        if (entry == NULL) {
+            PyErr_Format(PyExc_ValueError,
+                         "Read error: unknown schema fingerprint %016llx",
+                         (unsigned long long)fingerprint);
+            return NULL;
+        }
+        schema = entry->schema;
+        header = SINGLE_OBJECT_HEADER_SIZE;
+    }
+
+    size = buffer_size - header;
+    if (consumed != NULL) {
+        rval = skip_datum(buffer + header, size, schema, &size);
+        if (rval) {
+            set_avro_error(rval);
+            set_error_prefix("Read error: ");
+            return NULL;
+        }
+    }
+    avro_reader_memory_set_source(self->datum_reader, buffer + header, size);
+    if (entry != NULL) {
+        rval = registry_read(entry, self->datum_reader, &value);
+    } else if (self->resolver != NULL) {
+        value = &self->resolver->reader_value;
+        rval = resolver_read(self->resolver, self->datum_reader);
+    } else {
+        rval = avro_value_read(self->datum_reader, value);
+    }
+    decoded = stats_now();
+    self->stats.avro_ns += decoded - start;
+
+    if (rval) {
+        set_error_prefix("Read error: ");
+        return NULL;
+    }
+
+    if (consumed != NULL) {
+        *consumed = header + size;
+    }
+    self->stats.records++;
+    self->stats.uncompressed_bytes += header + size;
+
+    result = avro_to_python(&self->info, value);
+    self->stats.convert_ns += stats_now() - decoded;
+    return result;
+}
+
+/* takes any contiguous buffer, which we only hold while decoding */
+static PyObject *
+AvroDeserializer_deserialize(AvroDeserializer *self, PyObject *args)
+{
     avro_value_t value;
-    char *buffer = NULL;
-    Py_ssize_t buffer_size;
+    Py_buffer view;
     PyObject *result;
 
-    if (!PyArg_ParseTuple(args, "s#", &buffer, &buffer_size)) {
+    if (!PyArg_ParseTuple(args, "s*", &view)) {
         return NULL;
     }
-    avro_reader_memory_set_source(self->datum_reader, buffer, buffer_size);
     avro_generic_value_new(self->iface, &value);
-    rval = avro_value_read(self->datum_reader, &value);
+    result = read_datum(self, &value, (const char *)view.buf, view.len, NULL);
+    avro_value_decref(&value);
+    PyBuffer_Release(&view);
+    return result;
+}
 
-    if (rval) {
-        avro_value_decref(&value);
-        set_error_prefix("Read error: ");
+static PyObject *
+AvroDeserializer_deserialize_many(AvroDeserializer *self, PyObject *args)
+{
+    Py_ssize_t i;
+    Py_ssize_t n;
+    avro_value_t value;
+    Py_buffer view;
+    PyObject *pybuffers;
+    PyObject *seq;
+    PyObject *pyvalue;
+    PyObject *result;
+
+    if (!PyArg_ParseTuple(args, "O", &pybuffers)) {
+        return NULL;
+    }
+
+    seq = PySequence_Fast(pybuffers, "expected a sequence of buffers");
+    if (seq == NULL) {
+        return NULL;
+    }
+    n = PySequence_Fast_GET_SIZE(seq);
+
+    result = PyList_New(n);
+    if (result == NULL) {
+        Py_DECREF(seq);
         return NULL;
     }
 
-    result = avro_to_python(&self->info, &value);
+    avro_generic_value_new(self->iface, &value);
+    for (i = 0; i < n; i++) {
+        if (PyObject_GetBuffer(PySequence_Fast_GET_ITEM(seq, i), &view,
+                               PyBUF_SIMPLE) < 0) {
+            Py_CLEAR(result);
+            break;
+        }
+        pyvalue = read_datum(self, &value, (const char *)view.buf, view.len,
+                             NULL);
+        PyBuffer_Release(&view);
+        if (pyvalue == NULL) {
+            Py_CLEAR(result);
+            break;
+        }
+        PyList_SET_ITEM(result, i, pyvalue);
+    }
+    avro_value_decref(&value);
+    Py_DECREF(seq);
+
+    return result;
+}
+
+/*
+ * Decode consecutive datums from one buffer, until it is used up or
+ * count have been read.  Returns (list, bytes consumed).
+ */
+static PyObject *
+AvroDeserializer_deserialize_stream(AvroDeserializer *self, PyObject *args,
+                                    PyObject *kwds)
+{
+    int rval;
+    Py_buffer view;
+    const char *buffer;
+    Py_ssize_t buffer_size;
+    Py_ssize_t pos = 0;
+    Py_ssize_t count = -1;
+    size_t size;
+    avro_value_t value;
+    PyObject *pycount = Py_None;
+    PyObject *pyvalue;
+    PyObject *list;
+    PyObject *result = NULL;
+    static char *kwlist[] = {"buf", "count", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s*|O", kwlist,
+                                     &view, &pycount)) {
+        return NULL;
+    }
+    if (pycount != Py_None) {
+        count = PyNumber_AsSsize_t(pycount, PyExc_OverflowError);
+        if (count == -1 && PyErr_Occurred()) {
+            PyBuffer_Release(&view);
+            return NULL;
+        }
+    }
+
+    list = PyList_New(0);
+    if (list == NULL) {
+        PyBuffer_Release(&view);
+        return NULL;
+    }
+
+    buffer = (const char *)view.buf;
+    buffer_size = view.len;
+
+    avro_generic_value_new(self->iface, &value);
+    while (count < 0 ? pos < buffer_size : PyList_GET_SIZE(list) < count) {
+        pyvalue = read_datum(self, &value, buffer + pos, buffer_size - pos,
+                             &size);
+        if (pyvalue == NULL) {
+            set_error_prefix("At offset %zd: ", pos);
+            goto done;
+        }
+        if (size == 0 && count < 0) {
+            /* we would never get to the end of the buffer */
+            Py_DECREF(pyvalue);
+            PyErr_SetString(PyExc_ValueError,
+                            "Datums of this schema take no bytes; "
+                            "pass count to read them");
+            goto done;
+        }
+        rval = PyList_Append(list, pyvalue);
+        Py_DECREF(pyvalue);
+        if (rval < 0) {
+            goto done;
+        }
+        pos += size;
+    }
+
+    result = Py_BuildValue("On", list, pos);
+
+done:
     avro_value_decref(&value);
+    Py_DECREF(list);
+    PyBuffer_Release(&view);
     return result;
 }
 
+/* another writer schema to accept, for single-object encoded data */
+static PyObject *
+AvroDeserializer_add_schema(AvroDeserializer *self, PyObject *args)
+{
+    PyObject *pyschema;
+    avro_schema_t schema;
+    uint64_t fingerprint;
+
+    if (!PyArg_ParseTuple(args, "O", &pyschema)) {
+        return NULL;
+    }
+
+    if (!self->single_object) {
+        PyErr_SetString(PyExc_ValueError,
+                        "add_schema needs single_object=True");
+        return NULL;
+    }
+
+    schema = get_avro_schema(pyschema, &fingerprint);
+    if (schema == NULL) {
+        return NULL;
+    }
+
+    if (registry_add(&self->registry, fingerprint, schema) == NULL) {
+        PyErr_Format(PyExc_ValueError, "Cannot resolve schemas: %s",
+                     avro_strerror());
+        avro_schema_decref(schema);
+        return NULL;
+    }
+
+    if (self->info.types != NULL) {
+        declare_types(&self->info, output_schema(self, schema));
+    }
+    avro_schema_decref(schema);
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
 static PyObject *
 AvroDeserializer_close(AvroDeserializer *self, PyObject *args)
 {
@@ -150,6 +439,28 @@ static PyMethodDef AvroDeserializer_methods[] = {
     {"deserialize", (PyCFunction)AvroDeserializer_deserialize, METH_VARARGS,
      "Deserialize a record."
     },
+    {"add_schema", (PyCFunction)AvroDeserializer_add_schema, METH_VARARGS,
+     "Accept single-object encoded records written with another schema."
+    },
+    {"deserialize_many", (PyCFunction)AvroDeserializer_deserialize_many, METH_VARARGS,
+     "Deserialize a sequence of records, returning a list."
+    },
+    {"deserialize_stream", (PyCFunction)AvroDeserializer_deserialize_stream, METH_VARARGS | METH_KEYWORDS,
+     "Deserialize consecutive records from one buffer, all of them or count.\n"
+     "Returns (list, bytes consumed)."
+    },
+    {NULL}  /* Sentinel */
+};
+
+static PyObject *
+AvroDeserializer_get_stats(AvroDeserializer *self, void *closure)
+{
+    return stats_to_pydict(&self->stats, 0);
+}
+
+static PyGetSetDef AvroDeserializer_getset[] = {
+    {"stats", (getter)AvroDeserializer_get_stats, NULL,
+     "counters and times (ns) for the records deserialized so far", NULL},
     {NULL}  /* Sentinel */
 };
 
@@ -193,7 +504,7 @@ PyTypeObject avroDeserializerType = {
     0,                                     /* tp_iternext */
     AvroDeserializer_methods,              /* tp_methods */
     AvroDeserializer_members,              /* tp_members */
-    0,                                     /* tp_getset */
+    AvroDeserializer_getset,               /* tp_getset */
     0,                                     /* tp_base */
     0,                                     /* tp_dict */
     0,                                     /* tp_descr_get */
@@ -20,6 +20,9 @@
 #include "Python.h"
 #include "convert.h"
 #include "avro.h"
+#include "resolver.h"
+#include "registry.h"
+#include "stats.h"
 
 #define DESERIALIZER_READER_OK 0x1
 #define DESERIALIZER_SCHEMA_OK 0x2
@@ -33,6 +36,12 @@ typedef struct {
     avro_schema_t schema;
     avro_value_iface_t *iface;
     avro_reader_t datum_reader;
+    Resolver *resolver;  /* when decoding into a different reader schema */
+
+    int single_object;
+    Registry registry;   /* writer schemas by fingerprint, if single_object */
+
+    Stats stats;
 } AvroDeserializer;
 
 extern PyTypeObject avroDeserializerType;
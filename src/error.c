@@ -69,7 +69,11 @@ set_error_prefix(const char *format, ...)
         newmessage = value;
     }
 
-    if (newtype != PyExc_ValueError && newtype != PyExc_TypeError) {
+    /* errors about the data become ValueError, but not running out of
+       memory or being interrupted */
+    if (newtype != PyExc_ValueError && newtype != PyExc_TypeError
+        && PyErr_GivenExceptionMatches(newtype, PyExc_Exception)
+        && !PyErr_GivenExceptionMatches(newtype, PyExc_MemoryError)) {
         newtype = PyExc_ValueError;
         Py_INCREF(newtype);
         Py_DECREF(type);
@@ -16,9 +16,101 @@
 
 #include "util.h"
 #include "filereader.h"
+#include "allocator.h"
 #include "convert.h"
 #include "structmember.h"
 #include "error.h"
+#include "skip.h"
+#include "avroschema.h"
+#include "blockbuffer.h"
+#include "readinto.h"
+
+static int next_record(AvroFileReader *self);
+
+/*
+ * Read the blocks ourselves from now on, instead of through Avro-C, for
+ * the features that need them, stepping over the records Avro-C has
+ * already returned.  Returns 1 if we can't, because the file isn't
+ * seekable or the codec is one we leave to Avro-C, and -1 with a Python
+ * error set if we can't put the file back for Avro-C.
+ */
+static int
+use_blocks(AvroFileReader *self)
+{
+    int rval = 0;
+    long pos;
+    int64_t skip;
+    char codec_name[32];
+    char sync[CONTAINER_SYNC_SIZE];
+    container_codec_t codec;
+    avro_schema_t schema;
+
+    if (self->blocks != NULL) {
+        return 0;
+    }
+    if (self->start < 0) {
+        return 1;
+    }
+
+    /* Avro-C has read ahead into its own buffer, so this is what it has taken */
+    pos = ftell(self->file);
+    if (pos < 0 || fseek(self->file, self->start, SEEK_SET) != 0) {
+        return 1;
+    }
+
+    /* the schema is the one Avro-C read, so keep that */
+    if (container_read_header(self->file, &schema, codec_name,
+                              sizeof(codec_name), sync) == 0) {
+        avro_schema_decref(schema);
+        if (container_codec_from_name(codec_name, &codec) == 0) {
+            self->blocks = block_reader_new(self->file, codec, sync,
+                                            &self->stats);
+            self->datum_reader = avro_reader_memory(NULL, 0);
+        }
+    }
+
+    skip = self->avro_records;
+    while (self->blocks != NULL && self->datum_reader != NULL && skip > 0) {
+        int64_t n;
+
+        rval = next_record(self);
+        if (rval) {
+            break;
+        }
+        n = self->block_count - self->block_index;
+        if (n > skip) {
+            n = skip;
+        }
+        self->block_index += n;
+        self->block_pos_ok = 0;
+        self->source_ok = 0;
+        skip -= n;
+    }
+
+    if (self->blocks != NULL && self->datum_reader != NULL
+        && (rval == 0 || rval == EOF)) {
+        avro_file_reader_close(self->reader);
+        return 0;
+    }
+
+    if (self->blocks != NULL) {
+        block_reader_free(self->blocks);
+        self->blocks = NULL;
+    }
+    if (self->datum_reader != NULL) {
+        avro_reader_free(self->datum_reader);
+        self->datum_reader = NULL;
+    }
+    self->block_count = 0;
+    self->block_index = 0;
+
+    /* leave the file where Avro-C expects it */
+    if (fseek(self->file, pos, SEEK_SET) != 0) {
+        PyErr_SetFromErrno(PyExc_IOError);
+        return -1;
+    }
+    return 1;
+}
 
 static int
 AvroFileReader_init(AvroFileReader *self, PyObject *args, PyObject *kwds)
@@ -30,16 +122,42 @@ AvroFileReader_init(AvroFileReader *self, PyObject *args, PyObject *kwds)
     char *schema_json;
     avro_writer_t schema_json_writer;
     size_t len;
-    static char *kwlist[] = {"file", "types", NULL};
+    PyObject *pyreader_schema = Py_None;
+    avro_schema_t reader_schema;
+    int bytes_views = 0;
+    int typed_arrays = 0;
+    PyObject *dedup_strings = Py_None;
+    Py_ssize_t dedup_size = STRING_CACHE_DEFAULT_SIZE;
+    static char *kwlist[] = {"file", "types", "reader_schema", "bytes_views",
+                             "typed_arrays", "dedup_strings", "dedup_size",
+                             NULL};
 
     self->pyfile = NULL;
     self->flags = 0;
     self->iface = NULL;
+    self->resolver = NULL;
+    self->avro_records = 0;
+    self->blocks = NULL;
+    self->datum_reader = NULL;
+    self->block_count = 0;
+    self->block_index = 0;
+    self->info.views = NULL;
+    self->info.strings = NULL;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|OOiiOn", kwlist,
+                                     &pyfile, &types, &pyreader_schema,
+                                     &bytes_views, &typed_arrays,
+                                     &dedup_strings, &dedup_size)) {
+        return -1;
+    }
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|O", kwlist,
-                                     &pyfile, &types)) {
+    self->info.strings = string_cache_new(dedup_strings, dedup_size,
+                                          &self->stats);
+    if (self->info.strings == NULL && PyErr_Occurred()) {
         return -1;
     }
+    self->info.dedup = self->info.strings != NULL
+        && string_cache_all(self->info.strings);
 
     file = pyfile_to_file(pyfile, "rb");
 
@@ -51,15 +169,19 @@ AvroFileReader_init(AvroFileReader *self, PyObject *args, PyObject *kwds)
     self->pyfile = pyfile;
     Py_INCREF(pyfile);
 
+    self->file = file;
+    self->start = ftell(file);
+
+    allocator_note_use();
     if (avro_file_reader_fp(file, "pyfile", 0, &self->reader)) {
         PyErr_Format(PyExc_IOError, "Error opening file: %s", avro_strerror());
         goto exit_with_error;
     }
 
-    self->flags |= AVROFILE_READER_OK;
-
     self->schema = avro_file_reader_get_writer_schema(self->reader);
 
+    self->flags |= AVROFILE_READER_OK;
+
     if (self->schema == NULL) {
         PyErr_Format(PyExc_IOError, "Error reading schema: %s", avro_strerror());
         goto exit_with_error;
@@ -96,26 +218,49 @@ AvroFileReader_init(AvroFileReader *self, PyObject *args, PyObject *kwds)
         goto exit_with_error;
     }
 
-    if (types != NULL && PyObject_IsTrue(types)) {
-        /* we still haven't incref'ed types here */
-        if (Py_TYPE(types) == get_avro_types_type()) {
-            Py_INCREF(types);
-            self->info.types = types;
-        } else {
-            self->info.types = PyObject_CallFunctionObjArgs((PyObject *)get_avro_types_type(), NULL);
-            if (self->info.types == NULL) {
-                goto exit_with_error;
-            }
-            declare_types(&self->info, self->schema);
+    if (pyreader_schema != Py_None) {
+        reader_schema = get_avro_schema(pyreader_schema, NULL);
+        if (reader_schema == NULL) {
+            goto exit_with_error;
+        }
+        self->resolver = resolver_new(self->schema, reader_schema);
+        avro_schema_decref(reader_schema);
+        if (self->resolver == NULL) {
+            PyErr_Format(PyExc_ValueError, "Cannot resolve schemas: %s",
+                         avro_strerror());
+            goto exit_with_error;
         }
-    } else {
-        self->info.types = NULL;
+    }
+
+    /*
+     * Only where we read the blocks ourselves, and the values come out in
+     * the order they were written.
+     */
+    if (bytes_views || typed_arrays) {
+        rval = self->resolver != NULL ? 1 : use_blocks(self);
+        if (rval < 0) {
+            goto exit_with_error;
+        }
+        if (rval > 0) {
+            PyErr_SetString(PyExc_ValueError,
+                            "bytes_views and typed_arrays need a seekable file "
+                            "with the null or deflate codec and no reader_schema");
+            goto exit_with_error;
+        }
+        self->bytes_views = bytes_views;
+        self->typed_arrays = typed_arrays;
+        self->info.views = &self->views;
+    }
+
+    if (set_avro_types(&self->info, types, self->resolver != NULL ?
+                       self->resolver->reader_schema : self->schema)) {
+        goto exit_with_error;
     }
 
     return 0;
 
 exit_with_error:
-    Py_DECREF(pyfile);
+    Py_CLEAR(self->pyfile);
     return -1;
 }
 
@@ -136,12 +281,25 @@ AvroFileReader_dealloc(AvroFileReader *self)
     if (self->iface != NULL) {
         avro_value_iface_decref(self->iface);
     }
+    if (self->resolver != NULL) {
+        resolver_free(self->resolver);
+    }
     if (self->flags & AVROFILE_SCHEMA_OK) {
         avro_schema_decref(self->schema);
         Py_CLEAR(self->schema_json);
     }
+    if (self->blocks != NULL) {
+        block_reader_free(self->blocks);
+    }
+    if (self->datum_reader != NULL) {
+        avro_reader_free(self->datum_reader);
+    }
+    Py_CLEAR(self->views.block);
+    free(self->bytes_spans.pairs);
+    free(self->array_spans.pairs);
+    string_cache_free(self->info.strings);
     if (self->pyfile != NULL) {
-        if (is_open(self)) {
+        if (is_open(self) && self->blocks == NULL) {
             avro_file_reader_close(self->reader);
         }
 
@@ -158,15 +316,289 @@ AvroFileReader_self(AvroFileReader *self)
     return (PyObject *)self;
 }
 
+/* hand the block over to a BlockBuffer, for memoryviews of it */
+static int
+keep_block(AvroFileReader *self)
+{
+    PyObject *buffer;
+    PyObject *view = NULL;
+
+    buffer = block_buffer_new(block_reader_detach(self->blocks, self->block_len),
+                              self->block_len);
+    if (buffer != NULL) {
+        /* the data may have moved if it was shrunk */
+        self->block_data = ((BlockBuffer *)buffer)->data;
+        view = PyMemoryView_FromObject(buffer);
+        Py_DECREF(buffer);
+    }
+    if (view == NULL) {
+        /* the block has gone, so skip the rest of it */
+        self->block_data = NULL;
+        self->block_count = 0;
+        PyErr_Clear();
+        avro_set_error("Cannot keep block");
+        return ENOMEM;
+    }
+
+    Py_XDECREF(self->views.block);
+    self->views.block = view;
+    return 0;
+}
+
+/* make sure there is a record left in the current block */
+static int
+next_record(AvroFileReader *self)
+{
+    int rval;
+
+    while (self->block_index >= self->block_count) {
+        allocator_block_done();
+        rval = block_reader_next(self->blocks, &self->block_data,
+                                 &self->block_len, &self->block_count);
+        if (rval) {
+            return rval;
+        }
+        self->block_index = 0;
+        self->block_pos = 0;
+        self->block_pos_ok = 1;
+        self->source_ok = 0;
+
+        if (self->bytes_views) {
+            rval = keep_block(self);
+            if (rval) {
+                return rval;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Values are read straight through the block, so we only know the byte
+ * offset of the next record after raw reads.  Going the other way, step
+ * over the records already read.
+ */
+static int
+find_block_pos(AvroFileReader *self)
+{
+    int rval;
+    int64_t i;
+    size_t size;
+
+    if (self->block_pos_ok) {
+        return 0;
+    }
+
+    self->block_pos = 0;
+    for (i = 0; i < self->block_index; i++) {
+        rval = skip_datum(self->block_data + self->block_pos,
+                          self->block_len - self->block_pos,
+                          self->schema, &size);
+        if (rval) {
+            return rval;
+        }
+        self->block_pos += size;
+    }
+    self->block_pos_ok = 1;
+
+    return 0;
+}
+
+static int
+read_value(AvroFileReader *self, avro_value_t *value)
+{
+    int rval;
+    uint64_t start;
+
+    if (self->blocks == NULL) {
+        start = stats_now();
+        rval = avro_file_reader_read_value(self->reader, value);
+        self->stats.avro_ns += stats_now() - start;
+        self->stats.records += !rval;
+        self->avro_records += !rval;
+        return rval;
+    }
+
+    rval = next_record(self);
+    if (rval) {
+        return rval;
+    }
+
+    if (self->info.views != NULL) {
+        /* find where this record's values are, and its end */
+        size_t size;
+
+        rval = find_block_pos(self);
+        if (!rval) {
+            rval = locate_values(self->block_data + self->block_pos,
+                                 self->block_len - self->block_pos,
+                                 self->schema, &size,
+                                 self->bytes_views ? &self->bytes_spans : NULL,
+                                 self->typed_arrays ? &self->array_spans : NULL);
+        }
+        if (rval) {
+            return rval;
+        }
+        self->views.data = self->block_data;
+        self->views.base = self->block_pos;
+        self->views.len = size;
+        self->views.bytes = self->bytes_spans.pairs;
+        self->views.bytes_count = self->bytes_spans.count;
+        self->views.bytes_next = 0;
+        self->views.arrays = self->array_spans.pairs;
+        self->views.arrays_count = self->array_spans.count;
+        self->views.arrays_next = 0;
+        self->views.in_map = 0;
+
+        avro_reader_memory_set_source(self->datum_reader,
+                                      self->block_data + self->block_pos, size);
+        self->block_pos += size;
+        self->block_index++;
+        self->source_ok = 0;
+    } else {
+        if (!self->source_ok) {
+            avro_reader_memory_set_source(self->datum_reader,
+                                          self->block_data + self->block_pos,
+                                          self->block_len - self->block_pos);
+            self->source_ok = 1;
+        }
+        self->block_index++;
+        self->block_pos_ok = 0;
+    }
+
+    start = stats_now();
+    rval = avro_value_read(self->datum_reader, value);
+    self->stats.avro_ns += stats_now() - start;
+    self->stats.records += !rval;
+    return rval;
+}
+
+/* find the encoded bytes of the next record */
+static int
+read_raw(AvroFileReader *self, size_t *start, size_t *size)
+{
+    int rval;
+
+    rval = next_record(self);
+    if (!rval) {
+        rval = find_block_pos(self);
+    }
+    if (!rval) {
+        rval = skip_datum(self->block_data + self->block_pos,
+                          self->block_len - self->block_pos,
+                          self->schema, size);
+    }
+    if (rval) {
+        return rval;
+    }
+
+    *start = self->block_pos;
+    self->block_pos += *size;
+    self->block_index++;
+    self->source_ok = 0;
+    self->stats.records++;
+
+    return 0;
+}
+
+/* the rest of the current block as (bytes, offsets) */
+static PyObject *
+read_raw_block(AvroFileReader *self)
+{
+    int rval;
+    int64_t i;
+    int64_t n;
+    size_t start;
+    size_t size;
+    uint64_t *offsets;
+    PyObject *pydata;
+    PyObject *pyoffsets;
+    PyObject *result = NULL;
+
+    rval = next_record(self);
+    if (!rval) {
+        rval = find_block_pos(self);
+    }
+    if (rval) {
+        if (rval != EOF) {
+            set_avro_error(rval);
+            set_error_prefix("Error reading: ");
+        }
+        return NULL;
+    }
+
+    n = self->block_count - self->block_index;
+    offsets = (uint64_t *)PyMem_Malloc((n + 1) * sizeof(uint64_t));
+    if (offsets == NULL) {
+        return PyErr_NoMemory();
+    }
+
+    start = self->block_pos;
+    offsets[0] = 0;
+    for (i = 0; i < n; i++) {
+        rval = skip_datum(self->block_data + self->block_pos,
+                          self->block_len - self->block_pos,
+                          self->schema, &size);
+        if (rval) {
+            set_avro_error(rval);
+            set_error_prefix("Error reading: ");
+            PyMem_Free(offsets);
+            return NULL;
+        }
+        self->block_pos += size;
+        offsets[i + 1] = self->block_pos - start;
+    }
+    self->block_index = self->block_count;
+    self->source_ok = 0;
+    self->stats.records += n;
+
+    pydata = chars_size_to_pybytes((char *)self->block_data + start,
+                                   self->block_pos - start);
+    pyoffsets = offsets_to_pyarray(offsets, n + 1);
+    PyMem_Free(offsets);
+
+    if (pydata != NULL && pyoffsets != NULL) {
+        result = PyTuple_Pack(2, pydata, pyoffsets);
+    }
+    Py_XDECREF(pydata);
+    Py_XDECREF(pyoffsets);
+
+    return result;
+}
+
+static PyObject *
+to_python(AvroFileReader *self, avro_value_t *value)
+{
+    uint64_t start = stats_now();
+    PyObject *result = avro_to_python(&self->info, value);
+
+    self->stats.convert_ns += stats_now() - start;
+    return result;
+}
+
 static PyObject *
 AvroFileReader_iternext(AvroFileReader *self)
 {
     avro_value_t value;
     PyObject *result;
+    int rval;
+
+    if (self->resolver != NULL) {
+        avro_value_reset(&self->resolver->reader_value);
+        rval = read_value(self, &self->resolver->writer_value);
+        if (rval) {
+            if (rval != EOF) {
+                set_error_prefix("Error reading: ");
+            }
+            return NULL;
+        }
+        return to_python(self, &self->resolver->reader_value);
+    }
 
     avro_generic_value_new(self->iface, &value);
 
-    int rval = avro_file_reader_read_value(self->reader, &value);
+    rval = read_value(self, &value);
 
     if (rval) {
         avro_value_decref(&value);
@@ -178,19 +610,200 @@ AvroFileReader_iternext(AvroFileReader *self)
         return NULL;
     }
 
-    result = avro_to_python(&self->info, &value);
+    result = to_python(self, &value);
 
     avro_value_decref(&value);
 
     return result;
 }
 
+/* decode the next record straight into row, without Avro-C */
+static int
+read_into_row(AvroFileReader *self, const ReadIntoPlan *plan, char *row)
+{
+    int rval;
+    size_t size;
+
+    rval = next_record(self);
+    if (!rval) {
+        rval = find_block_pos(self);
+    }
+    if (!rval) {
+        rval = read_into_decode(plan, self->block_data + self->block_pos,
+                                self->block_len - self->block_pos, row, &size);
+    }
+    if (rval) {
+        return rval;
+    }
+
+    self->block_pos += size;
+    self->block_index++;
+    self->source_ok = 0;
+    self->stats.records++;
+    return 0;
+}
+
+/*
+ * Fill the rows of a structured buffer with the next records, returning
+ * how many were read: fewer than the rows at the end of the file.
+ */
+static PyObject *
+AvroFileReader_read_into(AvroFileReader *self, PyObject *args)
+{
+    int rval = 0;
+    int direct;
+    uint64_t start;
+    Py_ssize_t i;
+    Py_buffer view;
+    avro_value_t value;
+    avro_value_t *record;
+    ReadIntoPlan *plan;
+    PyObject *pybuf;
+
+    if (!PyArg_ParseTuple(args, "O", &pybuf)) {
+        return NULL;
+    }
+
+    if (PyObject_GetBuffer(pybuf, &view, PyBUF_RECORDS) < 0) {
+        return NULL;
+    }
+    if (view.ndim != 1) {
+        PyErr_SetString(PyExc_ValueError,
+                        "read_into needs a one dimensional buffer");
+        PyBuffer_Release(&view);
+        return NULL;
+    }
+
+    plan = read_into_plan_new(self->resolver != NULL ?
+                              self->resolver->reader_schema : self->schema,
+                              &view);
+    if (plan == NULL) {
+        PyBuffer_Release(&view);
+        return NULL;
+    }
+
+    /* where we can have the blocks, skip Avro-C's values altogether */
+    direct = 0;
+    if (self->resolver == NULL) {
+        rval = use_blocks(self);
+        if (rval < 0) {
+            read_into_plan_free(plan);
+            PyBuffer_Release(&view);
+            return NULL;
+        }
+        direct = (rval == 0);
+        rval = 0;
+    }
+    if (self->resolver != NULL) {
+        record = &self->resolver->reader_value;
+    } else {
+        record = &value;
+        if (!direct) {
+            avro_generic_value_new(self->iface, &value);
+        }
+    }
+
+    start = stats_now();
+    for (i = 0; i < view.shape[0]; i++) {
+        char *row = (char *)view.buf + i * view.strides[0];
+
+        if (direct) {
+            rval = read_into_row(self, plan, row);
+        } else {
+            if (self->resolver != NULL) {
+                avro_value_reset(record);
+                rval = read_value(self, &self->resolver->writer_value);
+            } else {
+                rval = read_value(self, record);
+            }
+            if (!rval) {
+                rval = read_into_value(plan, record, row);
+            }
+        }
+        if (rval) {
+            break;
+        }
+    }
+    if (direct) {
+        self->stats.avro_ns += stats_now() - start;
+    }
+
+    if (!direct && self->resolver == NULL) {
+        avro_value_decref(&value);
+    }
+    read_into_plan_free(plan);
+    PyBuffer_Release(&view);
+
+    if (rval && rval != EOF) {
+        set_avro_error(rval);
+        set_error_prefix("Error reading record %zd: ", i);
+        return NULL;
+    }
+
+    return PyLong_FromSsize_t(i);
+}
+
+static PyObject *
+AvroFileReader_iter_raw(AvroFileReader *self, PyObject *args, PyObject *kwds)
+{
+    int rval;
+    int blocks = 0;
+    AvroFileReaderRawIter *iter;
+    static char *kwlist[] = {"blocks", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|i", kwlist, &blocks)) {
+        return NULL;
+    }
+
+    rval = use_blocks(self);
+    if (rval < 0) {
+        return NULL;
+    }
+    if (rval > 0) {
+        PyErr_SetString(PyExc_IOError,
+                        "iter_raw needs a seekable file with the null or "
+                        "deflate codec");
+        return NULL;
+    }
+
+    iter = PyObject_New(AvroFileReaderRawIter, &avroFileReaderRawIterType);
+    if (iter == NULL) {
+        return NULL;
+    }
+    Py_INCREF(self);
+    iter->reader = self;
+    iter->blocks = blocks;
+
+    return (PyObject *)iter;
+}
+
 static PyMethodDef AvroFileReader_methods[] = {
     /*
     {"next", (PyCFunction)AvroFileReader_next, METH_VARARGS,
      "Read a record."
     },
     */
+    {"iter_raw", (PyCFunction)AvroFileReader_iter_raw, METH_VARARGS | METH_KEYWORDS,
+     "Iterate over the encoded bytes of each record without decoding.\n"
+     "With blocks=True, yield (bytes, offsets) for each block instead."
+    },
+    {"read_into", (PyCFunction)AvroFileReader_read_into, METH_VARARGS,
+     "read_into(buf): decode the next records into the rows of a structured\n"
+     "buffer, such as a numpy structured array, matching columns to fields\n"
+     "by name.  Returns the number of rows filled."
+    },
+    {NULL}  /* Sentinel */
+};
+
+static PyObject *
+AvroFileReader_get_stats(AvroFileReader *self, void *closure)
+{
+    return stats_to_pydict(&self->stats, 0);
+}
+
+static PyGetSetDef AvroFileReader_getset[] = {
+    {"stats", (getter)AvroFileReader_get_stats, NULL,
+     "counters and times (ns) for the records read so far", NULL},
     {NULL}  /* Sentinel */
 };
 
@@ -232,7 +845,7 @@ PyTypeObject avroFileReaderType = {
     (iternextfunc)AvroFileReader_iternext,    /* tp_iternext */
     AvroFileReader_methods,                   /* tp_methods */
     AvroFileReader_members,                   /* tp_members */
-    0,                         /* tp_getset */
+    AvroFileReader_getset,                    /* tp_getset */
     0,                         /* tp_base */
     0,                         /* tp_dict */
     0,                         /* tp_descr_get */
@@ -242,3 +855,71 @@ PyTypeObject avroFileReaderType = {
     0,                         /* tp_alloc */
     0,                         /* tp_new */
 };
+
+static void
+AvroFileReaderRawIter_dealloc(AvroFileReaderRawIter *self)
+{
+    Py_CLEAR(self->reader);
+    PyObject_Del(self);
+}
+
+static PyObject *
+AvroFileReaderRawIter_self(AvroFileReaderRawIter *self)
+{
+    Py_INCREF(self);
+    return (PyObject *)self;
+}
+
+static PyObject *
+AvroFileReaderRawIter_iternext(AvroFileReaderRawIter *self)
+{
+    int rval;
+    size_t start;
+    size_t size;
+    AvroFileReader *reader = self->reader;
+
+    if (self->blocks) {
+        return read_raw_block(reader);
+    }
+
+    rval = read_raw(reader, &start, &size);
+    if (rval) {
+        if (rval != EOF) {
+            set_avro_error(rval);
+            set_error_prefix("Error reading: ");
+        }
+        return NULL;
+    }
+
+    return chars_size_to_pybytes((char *)reader->block_data + start, size);
+}
+
+PyTypeObject avroFileReaderRawIterType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "_pyavro.AvroFileReaderRawIter",  /* tp_name */
+    sizeof(AvroFileReaderRawIter),    /* tp_basicsize */
+    0,                         /* tp_itemsize */
+    (destructor)AvroFileReaderRawIter_dealloc,    /* tp_dealloc */
+    0,                         /* tp_print */
+    0,                         /* tp_getattr */
+    0,                         /* tp_setattr */
+    0,                         /* tp_compare */
+    0,                         /* tp_repr */
+    0,                         /* tp_as_number */
+    0,                         /* tp_as_sequence */
+    0,                         /* tp_as_mapping */
+    0,                         /* tp_hash */
+    0,                         /* tp_call */
+    0,                         /* tp_str */
+    0,                         /* tp_getattro */
+    0,                         /* tp_setattro */
+    0,                         /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,        /* tp_flags */
+    "Raw record iterator",     /* tp_doc */
+    0,                         /* tp_traverse */
+    0,                         /* tp_clear */
+    0,                         /* tp_richcompare */
+    0,                         /* tp_weaklistoffset */
+    (getiterfunc)AvroFileReaderRawIter_self,         /* tp_iter */
+    (iternextfunc)AvroFileReaderRawIter_iternext,    /* tp_iternext */
+};
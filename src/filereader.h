@@ -20,6 +20,10 @@
 #include "Python.h"
 #include "convert.h"
 #include "avro.h"
+#include "container.h"
+#include "resolver.h"
+#include "skip.h"
+#include "stats.h"
 
 #define AVROFILE_READER_OK 0x1
 #define AVROFILE_SCHEMA_OK 0x2
@@ -35,10 +39,45 @@ typedef struct {
     PyObject *schema_json;
 
     avro_file_reader_t reader;
+    FILE *file;
+    long start;     /* offset of the header, or -1 if we can't seek */
+    int64_t avro_records;  /* records Avro-C has returned */
     avro_schema_t schema;
     avro_value_iface_t *iface;
+    Resolver *resolver;  /* when decoding into a different reader schema */
+
+    /* used instead of reader once a feature needs the blocks, if we can */
+    BlockReader *blocks;
+    avro_reader_t datum_reader;
+    const char *block_data;
+    size_t block_len;
+    size_t block_pos;      /* offset of record block_index, if block_pos_ok */
+    int64_t block_count;
+    int64_t block_index;
+    int block_pos_ok;
+    int source_ok;         /* datum_reader is positioned at block_index */
+
+    /*
+     * with bytes_views, each block is kept in a BlockBuffer; with
+     * typed_arrays, numeric arrays are decoded from the block
+     */
+    int bytes_views;
+    int typed_arrays;
+    BlockViews views;
+    Spans bytes_spans;
+    Spans array_spans;
+
+    Stats stats;
 } AvroFileReader;
 
+typedef struct {
+    PyObject_HEAD
+
+    AvroFileReader *reader;
+    int blocks;
+} AvroFileReaderRawIter;
+
 extern PyTypeObject avroFileReaderType;
+extern PyTypeObject avroFileReaderRawIterType;
 
 #endif
@@ -19,52 +19,162 @@
 #include "convert.h"
 #include "structmember.h"
 #include "error.h"
+#include "skip.h"
+#include "avroschema.h"
+#include "allocator.h"
 
 #define PYAVROC_BLOCK_SIZE (128 * 1024)
 
+static int
+open_for_append(AvroFileWriter *self, FILE *file, const char *codec, int block_size, int threads)
+{
+    avro_schema_t file_schema;
+    char file_codec[32];
+    char sync[CONTAINER_SYNC_SIZE];
+    container_codec_t container_codec;
+
+    if (fseek(file, 0, SEEK_END) != 0) {
+        PyErr_Format(PyExc_IOError, "Error opening file: %s", strerror(errno));
+        return -1;
+    }
+
+    if (ftell(file) == 0) {
+        /* nothing there yet, so start a new file */
+        if (!(self->flags & AVROFILE_SCHEMA_OK)) {
+            PyErr_SetString(PyExc_ValueError, "schema_json is required to append to an empty file");
+            return -1;
+        }
+        if (container_codec_from_name(codec, &container_codec)) {
+            PyErr_Format(PyExc_ValueError, "codec %s cannot be used for appending", codec);
+            return -1;
+        }
+        if (container_write_header(file, self->schema, codec, sync)) {
+            PyErr_Format(PyExc_IOError, "Error opening file: %s", avro_strerror());
+            return -1;
+        }
+    } else {
+        rewind(file);
+        if (container_read_header(file, &file_schema, file_codec, sizeof(file_codec), sync)) {
+            PyErr_Format(PyExc_IOError, "Error reading file header: %s", avro_strerror());
+            return -1;
+        }
+        if (self->flags & AVROFILE_SCHEMA_OK) {
+            int same = avro_schema_equal(self->schema, file_schema);
+            avro_schema_decref(file_schema);
+            if (!same) {
+                PyErr_SetString(PyExc_ValueError, "schema does not match the schema of the file");
+                return -1;
+            }
+        } else {
+            self->schema = file_schema;
+            self->flags |= AVROFILE_SCHEMA_OK;
+        }
+        /* the codec argument is ignored: we have to carry on with the file's */
+        if (container_codec_from_name(file_codec, &container_codec)) {
+            PyErr_Format(PyExc_ValueError, "Cannot append to file using codec %s", file_codec);
+            return -1;
+        }
+        if (fseek(file, 0, SEEK_END) != 0) {
+            PyErr_Format(PyExc_IOError, "Error opening file: %s", strerror(errno));
+            return -1;
+        }
+    }
+
+    self->blocks = block_writer_new(file, container_codec, sync, block_size, threads,
+                                    &self->stats);
+    if (self->blocks == NULL) {
+        PyErr_Format(PyExc_IOError, "Error opening file: %s", avro_strerror());
+        return -1;
+    }
+
+    return 0;
+}
+
 static int
 AvroFileWriter_init(AvroFileWriter *self, PyObject *args, PyObject *kwds)
 {
-    int rval;
     PyObject *pyfile;
-    PyObject *schema_json;
-    PyObject *schema_json_bytes;
+    PyObject *schema_json = NULL;
     FILE *file;
     char *codec = "null";
     int block_size = PYAVROC_BLOCK_SIZE;
+    int threads = 1;
+    char *mode = "w";
+    int append;
+    container_codec_t container_codec;
 
     self->pyfile = NULL;
     self->flags = 0;
     self->iface = NULL;
+    self->blocks = NULL;
 
-    static char *kwlist[] = { "pyfile", "schema_json", "codec", "block_size", NULL };
+    static char *kwlist[] = { "pyfile", "schema_json", "codec", "block_size", "threads", "mode", NULL };
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OO|si", kwlist, &pyfile, &schema_json, &codec, &block_size)) {
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|Osiis", kwlist, &pyfile, &schema_json, &codec, &block_size, &threads, &mode)) {
         return -1;
     }
 
-    schema_json_bytes = pystring_to_pybytes(schema_json);
-    rval = avro_schema_from_json(pybytes_to_chars(schema_json_bytes), 0, &self->schema, NULL);
-    Py_DECREF(schema_json_bytes);
+    append = (strcmp(mode, "append") == 0);
+    if (!append && strcmp(mode, "w") != 0) {
+        PyErr_Format(PyExc_ValueError, "mode must be 'w' or 'append', not '%s'", mode);
+        return -1;
+    }
 
-    if (rval != 0 || self->schema == NULL) {
-        PyErr_Format(PyExc_IOError, "Error reading schema: %s", avro_strerror());
+    if (!append && schema_json == NULL) {
+        PyErr_SetString(PyExc_TypeError, "schema_json is required");
         return -1;
     }
 
-    self->flags |= AVROFILE_SCHEMA_OK;
+    if (!append && threads > 1 && container_codec_from_name(codec, &container_codec)) {
+        PyErr_Format(PyExc_ValueError, "codec %s cannot be used with threads", codec);
+        return -1;
+    }
 
-    file = pyfile_to_file(pyfile, "wb");
+    if (schema_json != NULL) {
+        self->schema = get_avro_schema(schema_json, NULL);
+        if (self->schema == NULL) {
+            return -1;
+        }
+
+        self->flags |= AVROFILE_SCHEMA_OK;
+    }
+
+    allocator_note_use();
+
+    /* appending has to read the existing header first */
+    file = pyfile_to_file(pyfile, append ? "r+b" : "wb");
 
     if (file == NULL) {
-        PyErr_Format(PyExc_TypeError, "Error accessing file object.  Is it a file or file-like object?");
+        if (append) {
+            PyErr_Format(PyExc_TypeError, "Error accessing file object.  Is it a file opened for reading and writing?");
+        } else {
+            PyErr_Format(PyExc_TypeError, "Error accessing file object.  Is it a file or file-like object?");
+        }
         return -1;
     }
 
     self->pyfile = pyfile;
     Py_INCREF(pyfile);
 
-    if (avro_file_writer_create_with_codec_fp(file, "pyfile", 0, self->schema, &self->writer, codec, block_size)) {
+    if (append) {
+        if (open_for_append(self, file, codec, block_size, threads) < 0) {
+            goto exit_with_error;
+        }
+    } else if (threads > 1) {
+        /* compress blocks in parallel, so we have to write them ourselves */
+        char sync[CONTAINER_SYNC_SIZE];
+
+        if (container_write_header(file, self->schema, codec, sync)) {
+            PyErr_Format(PyExc_IOError, "Error opening file: %s", avro_strerror());
+            goto exit_with_error;
+        }
+        self->blocks = block_writer_new(file, container_codec, sync, block_size, threads,
+                                        &self->stats);
+        if (self->blocks == NULL) {
+            PyErr_Format(PyExc_IOError, "Error opening file: %s", avro_strerror());
+            goto exit_with_error;
+        }
+    } else if (avro_file_writer_create_with_codec_fp(file, "pyfile", 0, self->schema, &self->writer, codec, block_size)) {
         PyErr_Format(PyExc_IOError, "Error opening file: %s", avro_strerror());
         goto exit_with_error;
     }
@@ -81,7 +191,11 @@ AvroFileWriter_init(AvroFileWriter *self, PyObject *args, PyObject *kwds)
     return 0;
 
 exit_with_error:
-    Py_DECREF(pyfile);
+    if (self->blocks != NULL) {
+        block_writer_close(self->blocks, 0);
+        self->blocks = NULL;
+    }
+    Py_CLEAR(self->pyfile);
     return -1;
 }
 
@@ -109,7 +223,12 @@ do_close(AvroFileWriter *self)
     }
 
     if (self->pyfile != NULL) {
-        if (is_open(self)) {
+        if (self->blocks != NULL) {
+            /* stop the worker threads even if the file has gone away */
+            block_writer_close(self->blocks, is_open(self));
+            self->blocks = NULL;
+            self->flags &= ~AVROFILE_READER_OK;
+        } else if (is_open(self)) {
             avro_file_writer_close(self->writer);
             self->flags &= ~AVROFILE_READER_OK;
         }
@@ -132,6 +251,7 @@ static PyObject *
 AvroFileWriter_write(AvroFileWriter *self, PyObject *args)
 {
     int rval;
+    uint64_t start;
     avro_value_t value;
     PyObject *pyobj;
 
@@ -146,10 +266,19 @@ AvroFileWriter_write(AvroFileWriter *self, PyObject *args)
 
     avro_generic_value_new(self->iface, &value);
 
+    start = stats_now();
     rval = python_to_avro(NULL, pyobj, &value);
+    self->stats.convert_ns += stats_now() - start;
 
     if (!rval) {
-        rval = avro_file_writer_append_value(self->writer, &value);
+        if (self->blocks != NULL) {
+            rval = block_writer_append_value(self->blocks, &value);
+        } else {
+            start = stats_now();
+            rval = avro_file_writer_append_value(self->writer, &value);
+            self->stats.avro_ns += stats_now() - start;
+        }
+        self->stats.records += !rval;
     }
 
     if (rval) {
@@ -165,6 +294,115 @@ AvroFileWriter_write(AvroFileWriter *self, PyObject *args)
     return Py_None;
 }
 
+static int
+write_encoded(AvroFileWriter *self, const char *buf, Py_ssize_t len, int check)
+{
+    int rval;
+    size_t size;
+
+    if (check) {
+        rval = validate_datum(buf, len, self->schema, &size);
+        if (!rval && size != (size_t)len) {
+            avro_set_error("%lld bytes left over after datum", (long long)(len - size));
+            rval = EILSEQ;
+        }
+        if (rval) {
+            PyErr_Format(PyExc_ValueError, "Invalid datum: %s", avro_strerror());
+            return -1;
+        }
+    }
+
+    if (self->blocks != NULL) {
+        rval = block_writer_append_encoded(self->blocks, buf, len);
+    } else {
+        rval = avro_file_writer_append_encoded(self->writer, buf, len);
+    }
+    self->stats.records += !rval;
+
+    if (rval) {
+        PyErr_Format(PyExc_IOError, "Error writing: %s", avro_strerror());
+        return -1;
+    }
+    return 0;
+}
+
+static PyObject *
+AvroFileWriter_write_raw(AvroFileWriter *self, PyObject *args, PyObject *kwds)
+{
+    int rval;
+    Py_buffer buffer;
+    PyObject *check = NULL;
+    static char *kwlist[] = {"datum", "validate", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s*|O", kwlist, &buffer, &check)) {
+        return NULL;
+    }
+
+    if (!is_open(self)) {
+        PyBuffer_Release(&buffer);
+        PyErr_SetString(PyExc_IOError, "file closed");
+        return NULL;
+    }
+
+    rval = write_encoded(self, (const char *)buffer.buf, buffer.len,
+                         check != NULL && PyObject_IsTrue(check));
+    PyBuffer_Release(&buffer);
+
+    if (rval < 0) {
+        return NULL;
+    }
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+static PyObject *
+AvroFileWriter_write_raw_many(AvroFileWriter *self, PyObject *args, PyObject *kwds)
+{
+    int rval = 0;
+    int do_check;
+    PyObject *datums;
+    PyObject *iter;
+    PyObject *item;
+    PyObject *check = NULL;
+    static char *kwlist[] = {"datums", "validate", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|O", kwlist, &datums, &check)) {
+        return NULL;
+    }
+
+    if (!is_open(self)) {
+        PyErr_SetString(PyExc_IOError, "file closed");
+        return NULL;
+    }
+
+    do_check = (check != NULL && PyObject_IsTrue(check));
+
+    iter = PyObject_GetIter(datums);
+    if (iter == NULL) {
+        return NULL;
+    }
+
+    while (rval == 0 && (item = PyIter_Next(iter)) != NULL) {
+        Py_buffer buffer;
+
+        rval = PyObject_GetBuffer(item, &buffer, PyBUF_SIMPLE);
+        if (rval == 0) {
+            rval = write_encoded(self, (const char *)buffer.buf, buffer.len, do_check);
+            PyBuffer_Release(&buffer);
+        }
+        Py_DECREF(item);
+    }
+    Py_DECREF(iter);
+
+    if (rval < 0 || PyErr_Occurred()) {
+        return NULL;
+    }
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
 static PyObject *
 AvroFileWriter_close(AvroFileWriter *self, PyObject *args)
 {
@@ -174,6 +412,18 @@ AvroFileWriter_close(AvroFileWriter *self, PyObject *args)
     return Py_None;
 }
 
+static PyObject *
+AvroFileWriter_get_stats(AvroFileWriter *self, void *closure)
+{
+    return stats_to_pydict(&self->stats, 1);
+}
+
+static PyGetSetDef AvroFileWriter_getset[] = {
+    {"stats", (getter)AvroFileWriter_get_stats, NULL,
+     "counters and times (ns) for the records written so far", NULL},
+    {NULL}  /* Sentinel */
+};
+
 static PyMethodDef AvroFileWriter_methods[] = {
     {"close", (PyCFunction)AvroFileWriter_close, METH_VARARGS,
      "Close Avro file writer."
@@ -181,6 +431,14 @@ static PyMethodDef AvroFileWriter_methods[] = {
     {"write", (PyCFunction)AvroFileWriter_write, METH_VARARGS,
      "Write a record."
     },
+    {"write_raw", (PyCFunction)AvroFileWriter_write_raw, METH_VARARGS | METH_KEYWORDS,
+     "write_raw(datum, validate=False): write a record which is already\n"
+     "binary encoded.  With validate, first check that the bytes hold\n"
+     "exactly one well formed datum for the schema."
+    },
+    {"write_raw_many", (PyCFunction)AvroFileWriter_write_raw_many, METH_VARARGS | METH_KEYWORDS,
+     "write_raw_many(datums, validate=False): write_raw each of datums."
+    },
     {NULL}  /* Sentinel */
 };
 
@@ -214,7 +472,7 @@ PyTypeObject avroFileWriterType = {
     0,                         /* tp_iternext */
     AvroFileWriter_methods,    /* tp_methods */
     0,                         /* tp_members */
-    0,                         /* tp_getset */
+    AvroFileWriter_getset,     /* tp_getset */
     0,                         /* tp_base */
     0,                         /* tp_dict */
     0,                         /* tp_descr_get */
@@ -19,6 +19,8 @@
 
 #include "Python.h"
 #include "convert.h"
+#include "container.h"
+#include "stats.h"
 #include "avro.h"
 
 #define AVROFILE_READER_OK 0x1
@@ -33,8 +35,11 @@ typedef struct {
 
     PyObject *pyfile;
     avro_file_writer_t writer;
+    BlockWriter *blocks;  /* used instead of writer when we do the blocks */
     avro_schema_t schema;
     avro_value_iface_t *iface;
+
+    Stats stats;
 } AvroFileWriter;
 
 extern PyTypeObject avroFileWriterType;
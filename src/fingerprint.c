@@ -0,0 +1,269 @@
+/*
+ * Copyright 2015 Byhiras (Europe) Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fingerprint.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define FINGERPRINT_EMPTY 0xc15d213aa4d7a795ULL
+
+typedef struct {
+    char *buf;
+    size_t len;
+    size_t size;
+    int rval;
+} Builder;
+
+static void
+append(Builder *b, const char *s)
+{
+    size_t n = strlen(s);
+    char *newbuf;
+
+    if (b->rval) {
+        return;
+    }
+    if (b->len + n + 1 > b->size) {
+        size_t new_size = b->size ? b->size : 256;
+        while (b->len + n + 1 > new_size) {
+            new_size *= 2;
+        }
+        newbuf = (char *)realloc(b->buf, new_size);
+        if (newbuf == NULL) {
+            avro_set_error("Cannot allocate canonical form");
+            b->rval = ENOMEM;
+            return;
+        }
+        b->buf = newbuf;
+        b->size = new_size;
+    }
+    memcpy(b->buf + b->len, s, n + 1);
+    b->len += n;
+}
+
+/* names and symbols are [A-Za-z0-9_.] so need no escaping */
+static void
+append_quoted(Builder *b, const char *s)
+{
+    append(b, "\"");
+    append(b, s);
+    append(b, "\"");
+}
+
+static void
+append_fullname(Builder *b, avro_schema_t schema)
+{
+    const char *ns = avro_schema_namespace(schema);
+
+    append(b, "\"");
+    if (ns != NULL && *ns != '\0') {
+        append(b, ns);
+        append(b, ".");
+    }
+    append(b, avro_schema_name(schema));
+    append(b, "\"");
+}
+
+static void
+append_named_start(Builder *b, avro_schema_t schema, const char *type)
+{
+    append(b, "{\"name\":");
+    append_fullname(b, schema);
+    append(b, ",\"type\":\"");
+    append(b, type);
+    append(b, "\"");
+}
+
+static void
+canonical(Builder *b, avro_schema_t schema)
+{
+    size_t i;
+    size_t n;
+    char size[32];
+
+    switch (avro_typeof(schema)) {
+    case AVRO_NULL:
+        append(b, "\"null\"");
+        break;
+    case AVRO_BOOLEAN:
+        append(b, "\"boolean\"");
+        break;
+    case AVRO_INT32:
+        append(b, "\"int\"");
+        break;
+    case AVRO_INT64:
+        append(b, "\"long\"");
+        break;
+    case AVRO_FLOAT:
+        append(b, "\"float\"");
+        break;
+    case AVRO_DOUBLE:
+        append(b, "\"double\"");
+        break;
+    case AVRO_BYTES:
+        append(b, "\"bytes\"");
+        break;
+    case AVRO_STRING:
+        append(b, "\"string\"");
+        break;
+    case AVRO_FIXED:
+        snprintf(size, sizeof(size), "%lld",
+                 (long long)avro_schema_fixed_size(schema));
+        append_named_start(b, schema, "fixed");
+        append(b, ",\"size\":");
+        append(b, size);
+        append(b, "}");
+        break;
+    case AVRO_ENUM:
+        append_named_start(b, schema, "enum");
+        append(b, ",\"symbols\":[");
+        n = avro_schema_enum_number_of_symbols(schema);
+        for (i = 0; i < n; i++) {
+            if (i > 0) {
+                append(b, ",");
+            }
+            append_quoted(b, avro_schema_enum_get(schema, i));
+        }
+        append(b, "]}");
+        break;
+    case AVRO_ARRAY:
+        append(b, "{\"type\":\"array\",\"items\":");
+        canonical(b, avro_schema_array_items(schema));
+        append(b, "}");
+        break;
+    case AVRO_MAP:
+        append(b, "{\"type\":\"map\",\"values\":");
+        canonical(b, avro_schema_map_values(schema));
+        append(b, "}");
+        break;
+    case AVRO_UNION:
+        append(b, "[");
+        n = avro_schema_union_size(schema);
+        for (i = 0; i < n; i++) {
+            if (i > 0) {
+                append(b, ",");
+            }
+            canonical(b, avro_schema_union_branch(schema, i));
+        }
+        append(b, "]");
+        break;
+    case AVRO_RECORD:
+        append_named_start(b, schema, "record");
+        append(b, ",\"fields\":[");
+        n = avro_schema_record_size(schema);
+        for (i = 0; i < n; i++) {
+            if (i > 0) {
+                append(b, ",");
+            }
+            append(b, "{\"name\":");
+            append_quoted(b, avro_schema_record_field_name(schema, i));
+            append(b, ",\"type\":");
+            canonical(b, avro_schema_record_field_get_by_index(schema, i));
+            append(b, "}");
+        }
+        append(b, "]}");
+        break;
+    case AVRO_LINK:
+        /* a named type already written out in full */
+        append_fullname(b, avro_schema_link_target(schema));
+        break;
+    default:
+        avro_set_error("Unknown schema type");
+        b->rval = EINVAL;
+        break;
+    }
+}
+
+char *
+schema_canonical_form(avro_schema_t schema)
+{
+    Builder b = { NULL, 0, 0, 0 };
+
+    canonical(&b, schema);
+    if (b.rval) {
+        free(b.buf);
+        return NULL;
+    }
+    return b.buf;
+}
+
+uint64_t
+rabin_fingerprint(const char *buf, size_t len)
+{
+    static uint64_t table[256];
+    uint64_t fp;
+    size_t i;
+    int j;
+
+    if (table[1] == 0) {
+        for (i = 0; i < 256; i++) {
+            fp = i;
+            for (j = 0; j < 8; j++) {
+                fp = (fp >> 1) ^ (FINGERPRINT_EMPTY & -(fp & 1));
+            }
+            table[i] = fp;
+        }
+    }
+
+    fp = FINGERPRINT_EMPTY;
+    for (i = 0; i < len; i++) {
+        fp = (fp >> 8) ^ table[(fp ^ (unsigned char)buf[i]) & 0xff];
+    }
+    return fp;
+}
+
+int
+schema_fingerprint(avro_schema_t schema, uint64_t *fingerprint)
+{
+    char *canonical_form = schema_canonical_form(schema);
+
+    if (canonical_form == NULL) {
+        return EINVAL;
+    }
+    *fingerprint = rabin_fingerprint(canonical_form, strlen(canonical_form));
+    free(canonical_form);
+    return 0;
+}
+
+void
+single_object_header(uint64_t fingerprint, char *header)
+{
+    int i;
+
+    header[0] = (char)0xc3;
+    header[1] = (char)0x01;
+    for (i = 0; i < 8; i++) {
+        header[2 + i] = (char)(fingerprint >> (8 * i));
+    }
+}
+
+int
+parse_single_object_header(const char *buf, size_t len, uint64_t *fingerprint)
+{
+    int i;
+
+    if (len < SINGLE_OBJECT_HEADER_SIZE
+        || (unsigned char)buf[0] != 0xc3 || buf[1] != 0x01) {
+        avro_set_error("Not single-object encoded");
+        return EILSEQ;
+    }
+    *fingerprint = 0;
+    for (i = 0; i < 8; i++) {
+        *fingerprint |= (uint64_t)(unsigned char)buf[2 + i] << (8 * i);
+    }
+    return 0;
+}
@@ -0,0 +1,44 @@
+/*
+ * Copyright 2015 Byhiras (Europe) Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INC_FINGERPRINT_H
+#define INC_FINGERPRINT_H
+
+#include "avro.h"
+
+/* single-object encoding: marker, then the fingerprint, little endian */
+#define SINGLE_OBJECT_HEADER_SIZE 10
+
+/*
+ * Parsing Canonical Form of a schema, as defined by the Avro
+ * specification.  Returns a malloc'ed string, or NULL with the avro error
+ * set.
+ */
+char *schema_canonical_form(avro_schema_t schema);
+
+/* CRC-64-AVRO (Rabin) fingerprint of some bytes */
+uint64_t rabin_fingerprint(const char *buf, size_t len);
+
+/* fingerprint of the canonical form */
+int schema_fingerprint(avro_schema_t schema, uint64_t *fingerprint);
+
+void single_object_header(uint64_t fingerprint, char *header);
+
+/* returns 0 and sets *fingerprint if buf starts with a header */
+int parse_single_object_header(const char *buf, size_t len,
+                               uint64_t *fingerprint);
+
+#endif
@@ -0,0 +1,398 @@
+/*
+ * Copyright 2015 Byhiras (Europe) Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define PY_SSIZE_T_CLEAN
+
+#include "multideserializer.h"
+#include "convert.h"
+#include "structmember.h"
+#include "error.h"
+#include "util.h"
+#include "avroschema.h"
+#include "allocator.h"
+
+/* build the decoder for a JSON string or Schema */
+static RegistryEntry *
+add_entry(MultiSchemaDeserializer *self, long id, PyObject *pyschema)
+{
+    avro_schema_t schema;
+    RegistryEntry *entry;
+
+    if (!(self->flags & MULTIDESERIALIZER_REGISTRY_OK)) {
+        PyErr_SetString(PyExc_IOError, "Deserializer is closed");
+        return NULL;
+    }
+
+    schema = get_avro_schema(pyschema, NULL);
+    if (schema == NULL) {
+        set_error_prefix("Schema for id %ld: ", id);
+        return NULL;
+    }
+
+    entry = registry_add(&self->registry, (uint64_t)id, schema);
+    if (entry == NULL) {
+        PyErr_Format(PyExc_ValueError, "Cannot resolve schema for id %ld: %s",
+                     id, avro_strerror());
+    } else if (self->info.types != NULL && self->registry.reader_schema == NULL) {
+        declare_types(&self->info, schema);
+    }
+    avro_schema_decref(schema);
+
+    return entry;
+}
+
+/* look up id, asking our lookup callback on a miss */
+static RegistryEntry *
+find_entry(MultiSchemaDeserializer *self, long id)
+{
+    RegistryEntry *entry = registry_find(&self->registry, (uint64_t)id);
+    PyObject *lookup;
+    PyObject *schema_json;
+
+    if (entry != NULL) {
+        return entry;
+    }
+
+    if (self->lookup == NULL) {
+        PyErr_Format(PyExc_ValueError, "Read error: unknown schema id %ld", id);
+        return NULL;
+    }
+
+    /* the callback may close us, which drops our reference to it */
+    lookup = self->lookup;
+    Py_INCREF(lookup);
+    schema_json = PyObject_CallFunction(lookup, "l", id);
+    Py_DECREF(lookup);
+    if (schema_json == NULL) {
+        return NULL;
+    }
+    if (!(self->flags & MULTIDESERIALIZER_READER_OK)
+        || !(self->flags & MULTIDESERIALIZER_REGISTRY_OK)) {
+        Py_DECREF(schema_json);
+        PyErr_SetString(PyExc_IOError, "Deserializer is closed");
+        return NULL;
+    }
+    if (schema_json == Py_None) {
+        PyErr_Format(PyExc_ValueError, "Read error: unknown schema id %ld", id);
+        entry = NULL;
+    } else {
+        entry = add_entry(self, id, schema_json);
+    }
+    Py_DECREF(schema_json);
+
+    return entry;
+}
+
+static PyObject *
+read_datum(MultiSchemaDeserializer *self, const char *buffer,
+           size_t buffer_size)
+{
+    int rval;
+    long id;
+    avro_value_t *value;
+    RegistryEntry *entry;
+    const unsigned char *header = (const unsigned char *)buffer;
+
+    if (!(self->flags & MULTIDESERIALIZER_READER_OK)) {
+        PyErr_SetString(PyExc_IOError, "Deserializer is closed");
+        return NULL;
+    }
+
+    if (buffer_size < REGISTRY_HEADER_SIZE || header[0] != 0) {
+        PyErr_SetString(PyExc_ValueError,
+                        "Read error: no schema registry header");
+        return NULL;
+    }
+    id = ((long)header[1] << 24) | ((long)header[2] << 16)
+        | ((long)header[3] << 8) | (long)header[4];
+
+    entry = find_entry(self, id);
+    if (entry == NULL) {
+        return NULL;
+    }
+
+    avro_reader_memory_set_source(self->datum_reader,
+                                  buffer + REGISTRY_HEADER_SIZE,
+                                  buffer_size - REGISTRY_HEADER_SIZE);
+    rval = registry_read(entry, self->datum_reader, &value);
+    if (rval) {
+        set_error_prefix("Read error: ");
+        return NULL;
+    }
+
+    return avro_to_python(&self->info, value);
+}
+
+static int
+MultiSchemaDeserializer_init(MultiSchemaDeserializer *self, PyObject *args,
+                             PyObject *kwds)
+{
+    PyObject *schemas = NULL;
+    PyObject *lookup = NULL;
+    PyObject *types = NULL;
+    PyObject *key;
+    PyObject *pyschema;
+    PyObject *pyreader_schema = Py_None;
+    Py_ssize_t pos = 0;
+    long id;
+    avro_schema_t reader_schema = NULL;
+    static char *kwlist[] = {"schemas", "lookup", "reader_schema", "types",
+                             NULL};
+
+    self->flags = 0;
+    self->lookup = NULL;
+    self->info.types = NULL;
+    self->info.views = NULL;
+    self->info.strings = NULL;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|OOOO", kwlist,
+                                     &schemas, &lookup, &pyreader_schema,
+                                     &types)) {
+        return -1;
+    }
+
+    if (lookup == Py_None) {
+        lookup = NULL;
+    }
+    if (lookup != NULL && !PyCallable_Check(lookup)) {
+        PyErr_SetString(PyExc_TypeError, "lookup must be callable");
+        return -1;
+    }
+    if (schemas == Py_None) {
+        schemas = NULL;
+    }
+    if (schemas != NULL && !PyDict_Check(schemas)) {
+        PyErr_SetString(PyExc_TypeError, "schemas must be a dict");
+        return -1;
+    }
+
+    if (pyreader_schema != Py_None) {
+        reader_schema = get_avro_schema(pyreader_schema, NULL);
+        if (reader_schema == NULL) {
+            return -1;
+        }
+    }
+
+    allocator_note_use();
+
+    /* the registry keeps our reference to reader_schema */
+    registry_init(&self->registry, reader_schema);
+    self->flags |= MULTIDESERIALIZER_REGISTRY_OK;
+
+    self->datum_reader = avro_reader_memory(NULL, 0);
+    if (!self->datum_reader) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    self->flags |= MULTIDESERIALIZER_READER_OK;
+
+    /* without a reader schema, add_entry declares each writer schema */
+    if (set_avro_types(&self->info, types, reader_schema)) {
+        return -1;
+    }
+
+    if (lookup != NULL) {
+        Py_INCREF(lookup);
+        self->lookup = lookup;
+    }
+
+    while (schemas != NULL && PyDict_Next(schemas, &pos, &key, &pyschema)) {
+        id = pyint_to_long(key);
+        if (id == -1 && PyErr_Occurred()) {
+            return -1;
+        }
+        if (add_entry(self, id, pyschema) == NULL) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int
+do_close(MultiSchemaDeserializer *self)
+{
+    if (self->flags & MULTIDESERIALIZER_READER_OK) {
+        avro_reader_free(self->datum_reader);
+        self->flags &= ~MULTIDESERIALIZER_READER_OK;
+    }
+    if (self->flags & MULTIDESERIALIZER_REGISTRY_OK) {
+        registry_clear(&self->registry);
+        self->flags &= ~MULTIDESERIALIZER_REGISTRY_OK;
+    }
+    Py_CLEAR(self->lookup);
+    return 0;
+}
+
+static void
+MultiSchemaDeserializer_dealloc(MultiSchemaDeserializer *self)
+{
+    do_close(self);
+    Py_CLEAR(self->info.types);
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static PyObject *
+MultiSchemaDeserializer_deserialize(MultiSchemaDeserializer *self,
+                                    PyObject *args)
+{
+    Py_buffer view;
+    PyObject *result;
+
+    if (!PyArg_ParseTuple(args, "s*", &view)) {
+        return NULL;
+    }
+    result = read_datum(self, (const char *)view.buf, view.len);
+    PyBuffer_Release(&view);
+    return result;
+}
+
+static PyObject *
+MultiSchemaDeserializer_deserialize_many(MultiSchemaDeserializer *self,
+                                         PyObject *args)
+{
+    Py_ssize_t i;
+    Py_ssize_t n;
+    Py_buffer view;
+    PyObject *pybuffers;
+    PyObject *seq;
+    PyObject *pyvalue;
+    PyObject *result;
+
+    if (!PyArg_ParseTuple(args, "O", &pybuffers)) {
+        return NULL;
+    }
+
+    seq = PySequence_Fast(pybuffers, "expected a sequence of buffers");
+    if (seq == NULL) {
+        return NULL;
+    }
+    n = PySequence_Fast_GET_SIZE(seq);
+
+    result = PyList_New(n);
+    if (result == NULL) {
+        Py_DECREF(seq);
+        return NULL;
+    }
+
+    for (i = 0; i < n; i++) {
+        if (PyObject_GetBuffer(PySequence_Fast_GET_ITEM(seq, i), &view,
+                               PyBUF_SIMPLE) < 0) {
+            Py_CLEAR(result);
+            break;
+        }
+        pyvalue = read_datum(self, (const char *)view.buf, view.len);
+        PyBuffer_Release(&view);
+        if (pyvalue == NULL) {
+            Py_CLEAR(result);
+            break;
+        }
+        PyList_SET_ITEM(result, i, pyvalue);
+    }
+    Py_DECREF(seq);
+
+    return result;
+}
+
+static PyObject *
+MultiSchemaDeserializer_add_schema(MultiSchemaDeserializer *self,
+                                   PyObject *args)
+{
+    long id;
+    PyObject *schema_json;
+
+    if (!PyArg_ParseTuple(args, "lO", &id, &schema_json)) {
+        return NULL;
+    }
+    if (add_entry(self, id, schema_json) == NULL) {
+        return NULL;
+    }
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+static PyObject *
+MultiSchemaDeserializer_close(MultiSchemaDeserializer *self, PyObject *args)
+{
+    do_close(self);
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+static PyMethodDef MultiSchemaDeserializer_methods[] = {
+    {"close", (PyCFunction)MultiSchemaDeserializer_close, METH_VARARGS,
+     "Close deserializer."
+    },
+    {"deserialize", (PyCFunction)MultiSchemaDeserializer_deserialize, METH_VARARGS,
+     "Deserialize a record with a schema registry header."
+    },
+    {"deserialize_many", (PyCFunction)MultiSchemaDeserializer_deserialize_many, METH_VARARGS,
+     "Deserialize a sequence of records, returning a list."
+    },
+    {"add_schema", (PyCFunction)MultiSchemaDeserializer_add_schema, METH_VARARGS,
+     "Register the schema for an id."
+    },
+    {NULL}  /* Sentinel */
+};
+
+static PyMemberDef MultiSchemaDeserializer_members[] = {
+    {"types", T_OBJECT, offsetof(MultiSchemaDeserializer, info.types), 0,
+     "types info"},
+    {NULL}  /* Sentinel */
+};
+
+PyTypeObject multiSchemaDeserializerType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "_pyavro.MultiSchemaDeserializer",            /* tp_name */
+    sizeof(MultiSchemaDeserializer),              /* tp_basicsize */
+    0,                                            /* tp_itemsize */
+    (destructor)MultiSchemaDeserializer_dealloc,  /* tp_dealloc */
+    0,                                            /* tp_print */
+    0,                                            /* tp_getattr */
+    0,                                            /* tp_setattr */
+    0,                                            /* tp_compare */
+    0,                                            /* tp_repr */
+    0,                                            /* tp_as_number */
+    0,                                            /* tp_as_sequence */
+    0,                                            /* tp_as_mapping */
+    0,                                            /* tp_hash */
+    0,                                            /* tp_call */
+    0,                                            /* tp_str */
+    0,                                            /* tp_getattro */
+    0,                                            /* tp_setattro */
+    0,                                            /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,                           /* tp_flags */
+    "MultiSchemaDeserializer objects",            /* tp_doc */
+    0,                                            /* tp_traverse */
+    0,                                            /* tp_clear */
+    0,                                            /* tp_richcompare */
+    0,                                            /* tp_weaklistoffset */
+    0,                                            /* tp_iter */
+    0,                                            /* tp_iternext */
+    MultiSchemaDeserializer_methods,              /* tp_methods */
+    MultiSchemaDeserializer_members,              /* tp_members */
+    0,                                            /* tp_getset */
+    0,                                            /* tp_base */
+    0,                                            /* tp_dict */
+    0,                                            /* tp_descr_get */
+    0,                                            /* tp_descr_set */
+    0,                                            /* tp_dictoffset */
+    (initproc)MultiSchemaDeserializer_init,       /* tp_init */
+    0,                                            /* tp_alloc */
+    0,                                            /* tp_new */
+};
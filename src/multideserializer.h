@@ -0,0 +1,44 @@
+/*
+ * Copyright 2015 Byhiras (Europe) Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INC_MULTIDESERIALIZER_H
+#define INC_MULTIDESERIALIZER_H
+
+#include "Python.h"
+#include "convert.h"
+#include "avro.h"
+#include "registry.h"
+
+#define MULTIDESERIALIZER_READER_OK 0x1
+#define MULTIDESERIALIZER_REGISTRY_OK 0x2
+
+/* schema registry framing: magic byte 0, then a 4 byte big endian id */
+#define REGISTRY_HEADER_SIZE 5
+
+typedef struct {
+    PyObject_HEAD
+
+    int flags;
+    ConvertInfo info;
+
+    PyObject *lookup;  /* called with an id we don't know, or NULL */
+    Registry registry;
+    avro_reader_t datum_reader;
+} MultiSchemaDeserializer;
+
+extern PyTypeObject multiSchemaDeserializerType;
+
+#endif
@@ -21,37 +21,40 @@
 #include "filewriter.h"
 #include "serializer.h"
 #include "deserializer.h"
+#include "multideserializer.h"
+#include "avroschema.h"
+#include "validator.h"
+#include "allocator.h"
+#include "blockbuffer.h"
 #include "convert.h"
 
 static PyObject *
 create_types_func(PyObject *self, PyObject *args)
 {
-    int rval;
     avro_schema_t schema;
     PyObject *schema_json;
     ConvertInfo info;
-    PyObject *schema_json_bytes;
 
     if (!PyArg_ParseTuple(args, "O", &schema_json)) {
         return NULL;
     }
 
-    schema_json_bytes = pystring_to_pybytes(schema_json);
-    rval = avro_schema_from_json(pybytes_to_chars(schema_json_bytes), 0, &schema, NULL);
-    Py_DECREF(schema_json_bytes);
-
-    if (rval != 0 || schema == NULL) {
-        PyErr_Format(PyExc_IOError, "Error reading schema: %s", avro_strerror());
+    schema = get_avro_schema(schema_json, NULL);
+    if (schema == NULL) {
         return NULL;
     }
 
+    info.views = NULL;
+    info.strings = NULL;
     info.types = PyObject_CallFunctionObjArgs((PyObject *)get_avro_types_type(), NULL);
     if (info.types == NULL) {
         /* XXX: is the exception already set? */
+        avro_schema_decref(schema);
         return NULL;
     }
 
     declare_types(&info, schema);
+    avro_schema_decref(schema);
 
     return info.types;
 }
@@ -60,22 +63,63 @@ static PyObject *
 validate_func(PyObject *self, PyObject *args) {
     int rval;
     PyObject *datum;
-    char *schema_json;
+    PyObject *schema_json;
     avro_schema_t schema;
 
-    if (!PyArg_ParseTuple(args, "Os", &datum, &schema_json)) {
+    if (!PyArg_ParseTuple(args, "OO", &datum, &schema_json)) {
+        return NULL;
+    }
+
+    schema = get_avro_schema(schema_json, NULL);
+    if (schema == NULL) {
+        return NULL;
+    }
+    rval = validate(datum, schema);
+    avro_schema_decref(schema);
+
+    return Py_BuildValue("i", rval);
+}
+
+static PyObject *
+set_allocator_func(PyObject *self, PyObject *args)
+{
+    const char *name;
+    allocator_mode_t mode;
+    allocator_mode_t old_mode = allocator_get_mode();
+
+    if (!PyArg_ParseTuple(args, "s", &name)) {
         return NULL;
     }
 
-    rval = avro_schema_from_json(schema_json, 0, &schema, NULL);
-    if (rval != 0 || schema == NULL) {
-        PyErr_Format(PyExc_IOError, "Error reading schema: %s",
-                     avro_strerror());
+    if (allocator_mode_from_name(name, &mode)) {
+        PyErr_Format(PyExc_ValueError,
+                     "Unknown allocator %s: expected system, pymem or arena",
+                     name);
         return NULL;
     }
-    return Py_BuildValue("i", validate(datum, schema));
+    if (allocator_set_mode(mode)) {
+        PyErr_Format(PyExc_RuntimeError,
+                     "Cannot use the %s allocator after Avro-C has "
+                     "allocated memory: set it before creating schemas, "
+                     "readers or writers", name);
+        return NULL;
+    }
+
+    return chars_to_pystring(allocator_mode_name(old_mode));
 }
 
+static PyObject *
+allocator_stats_func(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    int reset_peak = 0;
+    static char *kwlist[] = {"reset_peak", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|i", kwlist, &reset_peak)) {
+        return NULL;
+    }
+
+    return allocator_stats_to_pydict(reset_peak);
+}
 
 static PyMethodDef mod_methods[] = {
     {"create_types", (PyCFunction)create_types_func, METH_VARARGS,
@@ -87,6 +131,18 @@ static PyMethodDef mod_methods[] = {
      "the n elements in an enum), return the corresponding index (0...n-1);\n"
      "if it matches, but it's not a union or enum, return 0."
     },
+    {"set_allocator", (PyCFunction)set_allocator_func, METH_VARARGS,
+     "set_allocator(mode): allocate Avro-C's memory with the C library\n"
+     "(\"system\"), with PyMem so tracemalloc sees it (\"pymem\"), or from\n"
+     "an arena started again for each block read (\"arena\").\n"
+     "\"pymem\" and \"arena\" replace Avro-C's allocator for the whole\n"
+     "process, and must be chosen before Avro-C is used.\n"
+     "Returns the previous mode."
+    },
+    {"allocator_stats", (PyCFunction)allocator_stats_func, METH_VARARGS | METH_KEYWORDS,
+     "allocator_stats(reset_peak=False): the allocator mode, and bytes held\n"
+     "by Avro-C now and at the peak.  reset_peak starts the peak again."
+    },
     {NULL}  /* Sentinel */
 };
 
@@ -124,6 +180,10 @@ init_pyavroc(void)
         INIT_RETURN(NULL);
     }
 
+    if (PyType_Ready(&avroFileReaderRawIterType) < 0) {
+        INIT_RETURN(NULL);
+    }
+
     avroFileWriterType.tp_new = PyType_GenericNew;
     if (PyType_Ready(&avroFileWriterType) < 0) {
         INIT_RETURN(NULL);
@@ -139,6 +199,23 @@ init_pyavroc(void)
         INIT_RETURN(NULL);
     }
 
+    multiSchemaDeserializerType.tp_new = PyType_GenericNew;
+    if (PyType_Ready(&multiSchemaDeserializerType) < 0) {
+        INIT_RETURN(NULL);
+    }
+
+    if (PyType_Ready(&avroSchemaType) < 0) {
+        INIT_RETURN(NULL);
+    }
+
+    if (PyType_Ready(&avroValidatorType) < 0) {
+        INIT_RETURN(NULL);
+    }
+
+    if (PyType_Ready(&blockBufferType) < 0) {
+        INIT_RETURN(NULL);
+    }
+
 #if PY_MAJOR_VERSION >= 3
     m = PyModule_Create(&moduledef);
 #else
@@ -159,6 +236,13 @@ init_pyavroc(void)
     PyModule_AddObject(m, "AvroDeserializer",
                        (PyObject *)&avroDeserializerType);
 
+    Py_INCREF(&multiSchemaDeserializerType);
+    PyModule_AddObject(m, "MultiSchemaDeserializer",
+                       (PyObject *)&multiSchemaDeserializerType);
+
+    Py_INCREF(&avroSchemaType);
+    PyModule_AddObject(m, "Schema", (PyObject *)&avroSchemaType);
+
     PyModule_AddObject(m, "AvroTypes", (PyObject*)get_avro_types_type());
 
     INIT_RETURN(m);
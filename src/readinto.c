@@ -0,0 +1,786 @@
+/*
+ * Copyright 2015 Byhiras (Europe) Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "readinto.h"
+#include "skip.h"
+#include "varint.h"
+
+#include <string.h>
+#include <math.h>
+
+typedef enum {
+    COLUMN_INT,
+    COLUMN_UINT,
+    COLUMN_FLOAT,
+    COLUMN_BOOL
+} column_kind_t;
+
+typedef struct {
+    const char *name;  /* in the buffer's format, not terminated */
+    size_t name_len;
+    column_kind_t kind;
+    size_t size;
+    size_t offset;
+    int used;
+} Column;
+
+typedef struct {
+    const char *name;
+    avro_schema_t schema;
+    avro_type_t type;        /* without the null */
+    int64_t symbols;         /* for enums */
+    int null_branch;         /* -1 if it can't be null */
+    const Column *column;    /* NULL to skip the field */
+    const Column *null_column;
+    size_t run;              /* int and long fields from here, up to RUN_MAX */
+} FieldPlan;
+
+/* how many varints we decode together */
+#define RUN_MAX 64
+
+struct ReadIntoPlan {
+    size_t field_count;
+    FieldPlan *fields;
+    size_t column_count;
+    Column *columns;
+};
+
+typedef struct {
+    const char *pos;
+    const char *end;
+} Cursor;
+
+/* Parsing the buffer's format: PEP 3118 struct syntax, as numpy gives it */
+
+static int
+is_little_endian(void)
+{
+    const int one = 1;
+    return *(const char *)&one;
+}
+
+static int
+set_column_type(Column *col, char code, int native)
+{
+    switch (code) {
+    case '?':
+        col->kind = COLUMN_BOOL;
+        col->size = 1;
+        return 0;
+    case 'b': case 'B':
+        col->size = 1;
+        break;
+    case 'h': case 'H':
+        col->size = 2;
+        break;
+    case 'i': case 'I':
+        col->size = native ? sizeof(int) : 4;
+        break;
+    case 'l': case 'L':
+        col->size = native ? sizeof(long) : 4;
+        break;
+    case 'q': case 'Q':
+        col->size = 8;
+        break;
+    case 'n': case 'N':
+        if (!native) {
+            return -1;
+        }
+        col->size = sizeof(Py_ssize_t);
+        break;
+    case 'f':
+        col->kind = COLUMN_FLOAT;
+        col->size = 4;
+        return 0;
+    case 'd':
+        col->kind = COLUMN_FLOAT;
+        col->size = 8;
+        return 0;
+    default:
+        return -1;
+    }
+    col->kind = (code >= 'a' && code <= 'z') ? COLUMN_INT : COLUMN_UINT;
+    return 0;
+}
+
+static int
+parse_format(ReadIntoPlan *plan, const Py_buffer *view)
+{
+    const char *p = view->format;
+    size_t offset = 0;
+    size_t count;
+    size_t n = 0;
+    int native = 1;
+    int aligned = 1;
+    Column *col;
+
+    if (p == NULL || strncmp(p, "T{", 2) != 0) {
+        PyErr_SetString(PyExc_ValueError,
+                        "read_into needs a buffer of records with named fields");
+        return -1;
+    }
+    p += 2;
+
+    /* at most one column per character */
+    plan->columns = (Column *)PyMem_Malloc(strlen(p) * sizeof(Column));
+    if (plan->columns == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    while (*p != '}') {
+        switch (*p) {
+        case '@':
+            native = aligned = 1;
+            p++;
+            continue;
+        case '^':
+            native = 1;
+            aligned = 0;
+            p++;
+            continue;
+        case '=':
+        case '<':
+        case '>':
+        case '!':
+            if ((*p == '>' || *p == '!') == is_little_endian()) {
+                PyErr_SetString(PyExc_ValueError,
+                                "read_into needs native byte order");
+                return -1;
+            }
+            native = aligned = 0;
+            p++;
+            continue;
+        case ' ':
+            p++;
+            continue;
+        case '\0':
+            goto bad_format;
+        }
+
+        count = 1;
+        if (*p >= '0' && *p <= '9') {
+            count = 0;
+            while (*p >= '0' && *p <= '9') {
+                count = 10 * count + (*p++ - '0');
+            }
+        }
+        if (*p == 'x') {
+            offset += count;
+            p++;
+            continue;
+        }
+
+        col = &plan->columns[n];
+        if (set_column_type(col, *p, native)) {
+            PyErr_Format(PyExc_ValueError,
+                         "read_into can't fill columns of type '%c'", *p);
+            return -1;
+        }
+        p++;
+        if (count != 1) {
+            PyErr_SetString(PyExc_ValueError,
+                            "read_into can't fill sub-array columns");
+            return -1;
+        }
+        if (*p != ':' || strchr(p + 1, ':') == NULL) {
+            goto bad_format;
+        }
+        col->name = p + 1;
+        col->name_len = strchr(p + 1, ':') - (p + 1);
+        p += col->name_len + 2;
+
+        if (aligned) {
+            offset = (offset + col->size - 1) / col->size * col->size;
+        }
+        col->offset = offset;
+        col->used = 0;
+        offset += col->size;
+        n++;
+    }
+
+    if (offset > (size_t)view->itemsize) {
+        goto bad_format;
+    }
+    plan->column_count = n;
+    return 0;
+
+bad_format:
+    PyErr_Format(PyExc_ValueError, "read_into can't follow the buffer format %s",
+                 view->format);
+    return -1;
+}
+
+static Column *
+find_column(ReadIntoPlan *plan, const char *name, const char *suffix)
+{
+    size_t i;
+    size_t len = strlen(name);
+    size_t suffix_len = strlen(suffix);
+    Column *col;
+
+    for (i = 0; i < plan->column_count; i++) {
+        col = &plan->columns[i];
+        if (col->name_len == len + suffix_len
+            && memcmp(col->name, name, len) == 0
+            && memcmp(col->name + len, suffix, suffix_len) == 0) {
+            col->used = 1;
+            return col;
+        }
+    }
+    return NULL;
+}
+
+/* fill in the field's type, seeing through a union with null */
+static int
+plan_field_type(FieldPlan *field, avro_schema_t schema)
+{
+    avro_schema_t branch;
+    int i;
+
+    field->null_branch = -1;
+    if (avro_typeof(schema) == AVRO_UNION) {
+        if (avro_schema_union_size(schema) != 2) {
+            return -1;
+        }
+        for (i = 0; i < 2; i++) {
+            branch = avro_schema_union_branch(schema, i);
+            if (avro_typeof(branch) == AVRO_NULL) {
+                field->null_branch = i;
+                schema = avro_schema_union_branch(schema, 1 - i);
+                break;
+            }
+        }
+        if (field->null_branch < 0) {
+            return -1;
+        }
+    }
+
+    while (avro_typeof(schema) == AVRO_LINK) {
+        schema = avro_schema_link_target(schema);
+    }
+
+    field->type = avro_typeof(schema);
+    switch (field->type) {
+    case AVRO_ENUM:
+        field->symbols = avro_schema_enum_number_of_symbols(schema);
+        return 0;
+    case AVRO_INT32:
+    case AVRO_INT64:
+    case AVRO_FLOAT:
+    case AVRO_DOUBLE:
+    case AVRO_BOOLEAN:
+        return 0;
+    default:
+        return -1;
+    }
+}
+
+static int
+plan_field(ReadIntoPlan *plan, FieldPlan *field)
+{
+    field->column = find_column(plan, field->name, "");
+    if (field->column == NULL) {
+        return 0;
+    }
+
+    if (plan_field_type(field, field->schema)) {
+        PyErr_Format(PyExc_ValueError,
+                     "read_into can't fill column %s: only int, long, float, "
+                     "double, boolean and enum fields, or a union of one "
+                     "with null", field->name);
+        return -1;
+    }
+
+    if ((field->type == AVRO_FLOAT || field->type == AVRO_DOUBLE)
+        && field->column->kind != COLUMN_FLOAT) {
+        PyErr_Format(PyExc_ValueError,
+                     "read_into can't fill column %s: needs a float column",
+                     field->name);
+        return -1;
+    }
+    if (field->type != AVRO_BOOLEAN && field->column->kind == COLUMN_BOOL) {
+        PyErr_Format(PyExc_ValueError,
+                     "read_into can't fill column %s: bool column for a "
+                     "field that isn't boolean", field->name);
+        return -1;
+    }
+
+    if (field->null_branch >= 0) {
+        field->null_column = find_column(plan, field->name, "_null");
+        if (field->null_column == NULL
+            && field->column->kind != COLUMN_FLOAT) {
+            PyErr_Format(PyExc_ValueError,
+                         "read_into can't fill column %s: it can be null, so "
+                         "it needs a float column or a %s_null column",
+                         field->name, field->name);
+            return -1;
+        }
+        if (field->null_column != NULL
+            && field->null_column->kind == COLUMN_FLOAT) {
+            PyErr_Format(PyExc_ValueError,
+                         "read_into can't fill column %s_null: needs a bool "
+                         "or integer column", field->name);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+ReadIntoPlan *
+read_into_plan_new(avro_schema_t schema, const Py_buffer *view)
+{
+    ReadIntoPlan *plan;
+    FieldPlan *field;
+    size_t i;
+
+    if (avro_typeof(schema) != AVRO_RECORD) {
+        PyErr_SetString(PyExc_ValueError, "read_into needs a record schema");
+        return NULL;
+    }
+
+    plan = (ReadIntoPlan *)PyMem_Malloc(sizeof(ReadIntoPlan));
+    if (plan == NULL) {
+        PyErr_NoMemory();
+        return NULL;
+    }
+    plan->columns = NULL;
+    plan->column_count = 0;
+    plan->field_count = avro_schema_record_size(schema);
+    plan->fields = (FieldPlan *)PyMem_Malloc(
+        (plan->field_count + 1) * sizeof(FieldPlan));
+    if (plan->fields == NULL) {
+        read_into_plan_free(plan);
+        PyErr_NoMemory();
+        return NULL;
+    }
+
+    if (parse_format(plan, view)) {
+        read_into_plan_free(plan);
+        return NULL;
+    }
+
+    for (i = 0; i < plan->field_count; i++) {
+        field = &plan->fields[i];
+        field->name = avro_schema_record_field_name(schema, i);
+        field->schema = avro_schema_record_field_get_by_index(schema, i);
+        field->null_column = NULL;
+        if (plan_field(plan, field)) {
+            read_into_plan_free(plan);
+            return NULL;
+        }
+    }
+
+    /* runs of int and long fields that can't be null */
+    for (i = plan->field_count; i-- > 0; ) {
+        field = &plan->fields[i];
+        field->run = 0;
+        if (field->column != NULL && field->null_branch < 0
+            && (field->type == AVRO_INT32 || field->type == AVRO_INT64)) {
+            field->run = 1;
+            if (i + 1 < plan->field_count && plan->fields[i + 1].run > 0
+                && plan->fields[i + 1].run < RUN_MAX) {
+                field->run += plan->fields[i + 1].run;
+            }
+        }
+    }
+
+    for (i = 0; i < plan->column_count; i++) {
+        if (!plan->columns[i].used) {
+            char name[128];
+
+            snprintf(name, sizeof(name), "%.*s",
+                     (int)plan->columns[i].name_len, plan->columns[i].name);
+            PyErr_Format(PyExc_ValueError,
+                         "read_into can't fill column %s: no such field", name);
+            read_into_plan_free(plan);
+            return NULL;
+        }
+    }
+
+    return plan;
+}
+
+void
+read_into_plan_free(ReadIntoPlan *plan)
+{
+    PyMem_Free(plan->fields);
+    PyMem_Free(plan->columns);
+    PyMem_Free(plan);
+}
+
+/* Storing values in a row */
+
+static int
+in_range(const Column *col, int64_t l)
+{
+    int bits = 8 * (int)col->size;
+
+    if (col->kind == COLUMN_INT) {
+        return bits == 64 || (l >= -((int64_t)1 << (bits - 1))
+                              && l < ((int64_t)1 << (bits - 1)));
+    }
+    return l >= 0 && (bits == 64 || l < ((int64_t)1 << bits));
+}
+
+/* the low bytes of l, which are the same for signed and unsigned */
+static void
+store_int(char *dest, size_t size, int64_t l)
+{
+    int8_t i8;
+    int16_t i16;
+    int32_t i32;
+
+    switch (size) {
+    case 1:
+        i8 = (int8_t)l;
+        memcpy(dest, &i8, 1);
+        break;
+    case 2:
+        i16 = (int16_t)l;
+        memcpy(dest, &i16, 2);
+        break;
+    case 4:
+        i32 = (int32_t)l;
+        memcpy(dest, &i32, 4);
+        break;
+    default:
+        memcpy(dest, &l, 8);
+    }
+}
+
+static void
+store_double(const Column *col, char *row, double d)
+{
+    float f;
+
+    if (col->size == 4) {
+        f = (float)d;
+        memcpy(row + col->offset, &f, 4);
+    } else {
+        memcpy(row + col->offset, &d, 8);
+    }
+}
+
+static int
+store_long(const Column *col, char *row, int64_t l)
+{
+    switch (col->kind) {
+    case COLUMN_BOOL:
+        row[col->offset] = (l != 0);
+        return 0;
+    case COLUMN_FLOAT:
+        store_double(col, row, (double)l);
+        return 0;
+    default:
+        if (!in_range(col, l)) {
+            avro_set_error("Value %lld out of range for the column",
+                           (long long)l);
+            return EINVAL;
+        }
+        store_int(row + col->offset, col->size, l);
+        return 0;
+    }
+}
+
+static int
+store_null(const FieldPlan *field, char *row)
+{
+    if (field->column->kind == COLUMN_FLOAT) {
+        store_double(field->column, row, NAN);
+    } else {
+        memset(row + field->column->offset, 0, field->column->size);
+    }
+    return field->null_column != NULL ? store_long(field->null_column, row, 1) : 0;
+}
+
+/* Decoding straight from the encoded record */
+
+static int
+read_long(Cursor *cur, int64_t *l)
+{
+    uint64_t n = 0;
+    int shift = 0;
+    unsigned char c;
+
+    do {
+        if (cur->pos >= cur->end || shift >= 64) {
+            avro_set_error("Truncated or invalid varint");
+            return EILSEQ;
+        }
+        c = (unsigned char)*cur->pos++;
+        n |= (uint64_t)(c & 0x7f) << shift;
+        shift += 7;
+    } while (c & 0x80);
+
+    *l = (int64_t)(n >> 1) ^ -(int64_t)(n & 1);
+    return 0;
+}
+
+/* Avro floats and doubles are little endian whatever the host */
+static int
+read_le(Cursor *cur, int size, uint64_t *bits)
+{
+    const unsigned char *p = (const unsigned char *)cur->pos;
+    int i;
+
+    if (cur->end - cur->pos < size) {
+        avro_set_error("Truncated datum");
+        return EILSEQ;
+    }
+    *bits = 0;
+    for (i = size - 1; i >= 0; i--) {
+        *bits = (*bits << 8) | p[i];
+    }
+    cur->pos += size;
+    return 0;
+}
+
+static int
+decode_field(const FieldPlan *field, Cursor *cur, char *row)
+{
+    int rval;
+    int64_t l;
+    uint64_t bits;
+    size_t size;
+
+    if (field->column == NULL) {
+        rval = skip_datum(cur->pos, cur->end - cur->pos, field->schema, &size);
+        cur->pos += rval ? 0 : size;
+        return rval;
+    }
+
+    if (field->null_branch >= 0) {
+        rval = read_long(cur, &l);
+        if (rval) {
+            return rval;
+        }
+        if (l == field->null_branch) {
+            return store_null(field, row);
+        }
+        if (l != 1 - field->null_branch) {
+            avro_set_error("Union index %lld out of range", (long long)l);
+            return EILSEQ;
+        }
+        if (field->null_column != NULL) {
+            store_long(field->null_column, row, 0);
+        }
+    }
+
+    switch (field->type) {
+    case AVRO_INT32:
+        rval = read_long(cur, &l);
+        if (!rval && (l < INT32_MIN || l > INT32_MAX)) {
+            avro_set_error("Value %lld out of range for int", (long long)l);
+            rval = EILSEQ;
+        }
+        return rval ? rval : store_long(field->column, row, l);
+    case AVRO_INT64:
+        rval = read_long(cur, &l);
+        return rval ? rval : store_long(field->column, row, l);
+    case AVRO_ENUM:
+        rval = read_long(cur, &l);
+        if (!rval && (l < 0 || l >= field->symbols)) {
+            avro_set_error("Enum index %lld out of range", (long long)l);
+            rval = EILSEQ;
+        }
+        return rval ? rval : store_long(field->column, row, l);
+    case AVRO_BOOLEAN:
+        if (cur->pos >= cur->end || (unsigned char)*cur->pos > 1) {
+            avro_set_error("Truncated or invalid boolean");
+            return EILSEQ;
+        }
+        return store_long(field->column, row, *cur->pos++);
+    case AVRO_FLOAT:
+        rval = read_le(cur, 4, &bits);
+        if (!rval) {
+            uint32_t bits32 = (uint32_t)bits;
+            float f;
+            memcpy(&f, &bits32, 4);
+            store_double(field->column, row, f);
+        }
+        return rval;
+    case AVRO_DOUBLE:
+        rval = read_le(cur, 8, &bits);
+        if (!rval) {
+            double d;
+            memcpy(&d, &bits, 8);
+            store_double(field->column, row, d);
+        }
+        return rval;
+    default:
+        avro_set_error("Unexpected field type");
+        return EINVAL;
+    }
+}
+
+/*
+ * Consecutive int and long fields have their varints decoded together.
+ * Sets *failed to the field in error.
+ */
+static int
+decode_run(const FieldPlan *fields, size_t run, Cursor *cur, char *row,
+           size_t *failed)
+{
+    int64_t values[RUN_MAX];
+    size_t i;
+    int rval;
+
+    *failed = 0;
+    if (varint_decode_longs(&cur->pos, cur->end, values, run)) {
+        avro_set_error("Truncated or invalid varint");
+        return EILSEQ;
+    }
+
+    for (i = 0; i < run; i++) {
+        *failed = i;
+        if (fields[i].type == AVRO_INT32
+            && (values[i] < INT32_MIN || values[i] > INT32_MAX)) {
+            avro_set_error("Value %lld out of range for int",
+                           (long long)values[i]);
+            return EILSEQ;
+        }
+        rval = store_long(fields[i].column, row, values[i]);
+        if (rval) {
+            return rval;
+        }
+    }
+    return 0;
+}
+
+int
+read_into_decode(const ReadIntoPlan *plan, const char *buf, size_t len,
+                 char *row, size_t *size)
+{
+    Cursor cur;
+    size_t i;
+    size_t failed;
+    int rval;
+
+    cur.pos = buf;
+    cur.end = buf + len;
+
+    for (i = 0; i < plan->field_count; ) {
+        if (plan->fields[i].run > 1) {
+            rval = decode_run(&plan->fields[i], plan->fields[i].run, &cur, row,
+                              &failed);
+            if (rval) {
+                avro_prefix_error("%s: ", plan->fields[i + failed].name);
+                return rval;
+            }
+            i += plan->fields[i].run;
+            continue;
+        }
+        rval = decode_field(&plan->fields[i], &cur, row);
+        if (rval) {
+            avro_prefix_error("%s: ", plan->fields[i].name);
+            return rval;
+        }
+        i++;
+    }
+
+    *size = cur.pos - buf;
+    return 0;
+}
+
+/* Copying from a decoded record, when Avro-C has done the reading */
+
+static int
+value_field(const FieldPlan *field, avro_value_t *value, char *row)
+{
+    int rval;
+    int discriminant;
+    avro_value_t branch;
+    union {
+        int32_t i;
+        int64_t l;
+        int e;
+        int b;
+        float f;
+        double d;
+    } v;
+
+    if (field->null_branch >= 0) {
+        rval = avro_value_get_discriminant(value, &discriminant);
+        if (rval) {
+            return rval;
+        }
+        if (discriminant == field->null_branch) {
+            return store_null(field, row);
+        }
+        if (field->null_column != NULL) {
+            store_long(field->null_column, row, 0);
+        }
+        rval = avro_value_get_current_branch(value, &branch);
+        if (rval) {
+            return rval;
+        }
+        value = &branch;
+    }
+
+    switch (field->type) {
+    case AVRO_INT32:
+        rval = avro_value_get_int(value, &v.i);
+        return rval ? rval : store_long(field->column, row, v.i);
+    case AVRO_INT64:
+        rval = avro_value_get_long(value, &v.l);
+        return rval ? rval : store_long(field->column, row, v.l);
+    case AVRO_ENUM:
+        rval = avro_value_get_enum(value, &v.e);
+        return rval ? rval : store_long(field->column, row, v.e);
+    case AVRO_BOOLEAN:
+        rval = avro_value_get_boolean(value, &v.b);
+        return rval ? rval : store_long(field->column, row, v.b);
+    case AVRO_FLOAT:
+        rval = avro_value_get_float(value, &v.f);
+        if (!rval) {
+            store_double(field->column, row, v.f);
+        }
+        return rval;
+    case AVRO_DOUBLE:
+        rval = avro_value_get_double(value, &v.d);
+        if (!rval) {
+            store_double(field->column, row, v.d);
+        }
+        return rval;
+    default:
+        avro_set_error("Unexpected field type");
+        return EINVAL;
+    }
+}
+
+int
+read_into_value(const ReadIntoPlan *plan, avro_value_t *value, char *row)
+{
+    avro_value_t field_value;
+    size_t i;
+    int rval;
+
+    for (i = 0; i < plan->field_count; i++) {
+        if (plan->fields[i].column == NULL) {
+            continue;
+        }
+        rval = avro_value_get_by_index(value, i, &field_value, NULL);
+        if (!rval) {
+            rval = value_field(&plan->fields[i], &field_value, row);
+        }
+        if (rval) {
+            avro_prefix_error("%s: ", plan->fields[i].name);
+            return rval;
+        }
+    }
+    return 0;
+}
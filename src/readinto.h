@@ -0,0 +1,50 @@
+/*
+ * Copyright 2015 Byhiras (Europe) Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INC_READINTO_H
+#define INC_READINTO_H
+
+#include "Python.h"
+#include "avro.h"
+
+/*
+ * Decoding records straight into rows of a structured buffer, such as a
+ * numpy structured array, matched to the record's fields by name using
+ * the buffer's struct format.  Fields must be int, long, float, double,
+ * boolean or enum, or a union of null and one of those.  A null goes in
+ * as NaN in a floating point column; otherwise the buffer needs a
+ * "<name>_null" column, which is set to 1 for null and 0 otherwise.
+ * Record fields without a column are skipped.
+ */
+typedef struct ReadIntoPlan ReadIntoPlan;
+
+/* match schema to view's format, or set a Python error and return NULL */
+ReadIntoPlan *read_into_plan_new(avro_schema_t schema, const Py_buffer *view);
+
+void read_into_plan_free(ReadIntoPlan *plan);
+
+/*
+ * Decode the binary encoded record at the start of buf into row, and set
+ * *size to its length.  Returns 0, or an error code with the avro error
+ * set.
+ */
+int read_into_decode(const ReadIntoPlan *plan, const char *buf, size_t len,
+                     char *row, size_t *size);
+
+/* the same, from an already decoded record */
+int read_into_value(const ReadIntoPlan *plan, avro_value_t *value, char *row);
+
+#endif
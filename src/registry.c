@@ -0,0 +1,185 @@
+/*
+ * Copyright 2015 Byhiras (Europe) Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "registry.h"
+
+#include <stdlib.h>
+
+static size_t
+slot_of(Registry *registry, uint64_t key)
+{
+    /* registry ids are small and sequential, so mix them up */
+    return (size_t)((key * 0x9e3779b97f4a7c15ULL) >> 32) & (registry->size - 1);
+}
+
+void
+registry_init(Registry *registry, avro_schema_t reader_schema)
+{
+    registry->table = NULL;
+    registry->size = 0;
+    registry->count = 0;
+    registry->reader_schema = reader_schema;
+}
+
+RegistryEntry *
+registry_find(Registry *registry, uint64_t key)
+{
+    size_t i;
+
+    if (registry->count == 0) {
+        return NULL;
+    }
+    for (i = slot_of(registry, key); registry->table[i] != NULL;
+         i = (i + 1) & (registry->size - 1)) {
+        if (registry->table[i]->key == key) {
+            return registry->table[i];
+        }
+    }
+    return NULL;
+}
+
+static void
+entry_free(RegistryEntry *entry)
+{
+    if (entry->resolver != NULL) {
+        resolver_free(entry->resolver);
+    } else {
+        avro_value_decref(&entry->value);
+        avro_value_iface_decref(entry->iface);
+    }
+    avro_schema_decref(entry->schema);
+    free(entry);
+}
+
+static RegistryEntry *
+entry_new(Registry *registry, uint64_t key, avro_schema_t schema)
+{
+    RegistryEntry *entry = (RegistryEntry *)calloc(1, sizeof(RegistryEntry));
+
+    if (entry == NULL) {
+        avro_set_error("Cannot allocate registry entry");
+        return NULL;
+    }
+    entry->key = key;
+
+    if (registry->reader_schema != NULL) {
+        entry->resolver = resolver_new(schema, registry->reader_schema);
+        if (entry->resolver == NULL) {
+            free(entry);
+            return NULL;
+        }
+    } else {
+        entry->iface = avro_generic_class_from_schema(schema);
+        if (entry->iface == NULL) {
+            free(entry);
+            return NULL;
+        }
+        avro_generic_value_new(entry->iface, &entry->value);
+    }
+
+    entry->schema = avro_schema_incref(schema);
+    return entry;
+}
+
+static int
+grow(Registry *registry)
+{
+    RegistryEntry **old_table = registry->table;
+    size_t old_size = registry->size;
+    size_t i;
+    size_t j;
+
+    registry->size = old_size ? 2 * old_size : 16;
+    registry->table = (RegistryEntry **)calloc(registry->size,
+                                               sizeof(RegistryEntry *));
+    if (registry->table == NULL) {
+        registry->table = old_table;
+        registry->size = old_size;
+        avro_set_error("Cannot allocate registry");
+        return ENOMEM;
+    }
+
+    for (i = 0; i < old_size; i++) {
+        if (old_table[i] != NULL) {
+            for (j = slot_of(registry, old_table[i]->key);
+                 registry->table[j] != NULL; j = (j + 1) & (registry->size - 1)) {
+            }
+            registry->table[j] = old_table[i];
+        }
+    }
+    free(old_table);
+    return 0;
+}
+
+RegistryEntry *
+registry_add(Registry *registry, uint64_t key, avro_schema_t schema)
+{
+    size_t i;
+    RegistryEntry *entry;
+
+    /* keep the table at most half full */
+    if (2 * (registry->count + 1) > registry->size && grow(registry)) {
+        return NULL;
+    }
+
+    entry = entry_new(registry, key, schema);
+    if (entry == NULL) {
+        return NULL;
+    }
+
+    for (i = slot_of(registry, key); registry->table[i] != NULL;
+         i = (i + 1) & (registry->size - 1)) {
+        if (registry->table[i]->key == key) {
+            entry_free(registry->table[i]);
+            registry->table[i] = entry;
+            return entry;
+        }
+    }
+    registry->table[i] = entry;
+    registry->count++;
+    return entry;
+}
+
+int
+registry_read(RegistryEntry *entry, avro_reader_t reader, avro_value_t **value)
+{
+    if (entry->resolver != NULL) {
+        *value = &entry->resolver->reader_value;
+        return resolver_read(entry->resolver, reader);
+    }
+    *value = &entry->value;
+    return avro_value_read(reader, &entry->value);
+}
+
+void
+registry_clear(Registry *registry)
+{
+    size_t i;
+
+    for (i = 0; i < registry->size; i++) {
+        if (registry->table[i] != NULL) {
+            entry_free(registry->table[i]);
+        }
+    }
+    free(registry->table);
+    registry->table = NULL;
+    registry->size = 0;
+    registry->count = 0;
+    if (registry->reader_schema != NULL) {
+        avro_schema_decref(registry->reader_schema);
+        registry->reader_schema = NULL;
+    }
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright 2015 Byhiras (Europe) Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INC_REGISTRY_H
+#define INC_REGISTRY_H
+
+#include "avro.h"
+#include "resolver.h"
+
+/*
+ * Decoders for several writer schemas, looked up by a 64 bit key: a
+ * schema fingerprint or a registry id.  Each entry is built once, with
+ * its value reused for every datum.
+ */
+typedef struct {
+    uint64_t key;
+    avro_schema_t schema;
+    avro_value_iface_t *iface;
+    avro_value_t value;
+    Resolver *resolver;  /* when there is a reader schema */
+} RegistryEntry;
+
+typedef struct {
+    RegistryEntry **table;  /* open addressing, size a power of two */
+    size_t size;
+    size_t count;
+    avro_schema_t reader_schema;  /* or NULL to decode as written */
+} Registry;
+
+/* takes a reference to reader_schema, which may be NULL */
+void registry_init(Registry *registry, avro_schema_t reader_schema);
+
+RegistryEntry *registry_find(Registry *registry, uint64_t key);
+
+/*
+ * Build a decoder for schema, replacing any with the same key.  Returns
+ * the entry, or NULL with the avro error set.
+ */
+RegistryEntry *registry_add(Registry *registry, uint64_t key,
+                            avro_schema_t schema);
+
+/* decode the next datum from reader, setting *value to the result */
+int registry_read(RegistryEntry *entry, avro_reader_t reader,
+                  avro_value_t **value);
+
+void registry_clear(Registry *registry);
+
+#endif
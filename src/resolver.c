@@ -0,0 +1,151 @@
+/*
+ * Copyright 2015 Byhiras (Europe) Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "resolver.h"
+#include "fingerprint.h"
+
+/*
+ * Interfaces already built, by the fingerprints of their writer and reader
+ * schemas.  Parsing Canonical Form leaves out docs, aliases and defaults,
+ * none of which Avro-C's resolution uses.  Beyond this many pairs, start
+ * the cache again.  Only used with the GIL held.
+ */
+#define RESOLVER_CACHE_SIZE 64
+
+typedef struct {
+    uint64_t writer_fingerprint;
+    uint64_t reader_fingerprint;
+    avro_value_iface_t *writer_iface;
+    avro_value_iface_t *reader_iface;
+} CacheEntry;
+
+static CacheEntry cache[RESOLVER_CACHE_SIZE];
+static size_t cache_count = 0;
+
+static int
+build_ifaces(Resolver *resolver, avro_schema_t writer_schema,
+             avro_schema_t reader_schema)
+{
+    resolver->writer_iface = avro_resolved_writer_new(writer_schema,
+                                                      reader_schema);
+    if (resolver->writer_iface == NULL) {
+        return EINVAL;
+    }
+
+    resolver->reader_iface = avro_generic_class_from_schema(reader_schema);
+    if (resolver->reader_iface == NULL) {
+        avro_value_iface_decref(resolver->writer_iface);
+        return EINVAL;
+    }
+    return 0;
+}
+
+/* set the resolver's interfaces, from the cache if we can */
+static int
+get_ifaces(Resolver *resolver, avro_schema_t writer_schema,
+           avro_schema_t reader_schema)
+{
+    int rval;
+    uint64_t writer_fingerprint;
+    uint64_t reader_fingerprint;
+    CacheEntry *entry;
+    size_t i;
+
+    if (schema_fingerprint(writer_schema, &writer_fingerprint)
+        || schema_fingerprint(reader_schema, &reader_fingerprint)) {
+        return build_ifaces(resolver, writer_schema, reader_schema);
+    }
+
+    for (i = 0; i < cache_count; i++) {
+        entry = &cache[i];
+        if (entry->writer_fingerprint == writer_fingerprint
+            && entry->reader_fingerprint == reader_fingerprint) {
+            avro_value_iface_incref(entry->writer_iface);
+            avro_value_iface_incref(entry->reader_iface);
+            resolver->writer_iface = entry->writer_iface;
+            resolver->reader_iface = entry->reader_iface;
+            return 0;
+        }
+    }
+
+    rval = build_ifaces(resolver, writer_schema, reader_schema);
+    if (rval) {
+        return rval;
+    }
+
+    if (cache_count == RESOLVER_CACHE_SIZE) {
+        for (i = 0; i < cache_count; i++) {
+            avro_value_iface_decref(cache[i].writer_iface);
+            avro_value_iface_decref(cache[i].reader_iface);
+        }
+        cache_count = 0;
+    }
+    entry = &cache[cache_count++];
+    entry->writer_fingerprint = writer_fingerprint;
+    entry->reader_fingerprint = reader_fingerprint;
+    avro_value_iface_incref(resolver->writer_iface);
+    avro_value_iface_incref(resolver->reader_iface);
+    entry->writer_iface = resolver->writer_iface;
+    entry->reader_iface = resolver->reader_iface;
+
+    return 0;
+}
+
+Resolver *
+resolver_new(avro_schema_t writer_schema, avro_schema_t reader_schema)
+{
+    Resolver *resolver = (Resolver *)avro_new(Resolver);
+
+    if (resolver == NULL) {
+        avro_set_error("Cannot allocate resolver");
+        return NULL;
+    }
+
+    if (get_ifaces(resolver, writer_schema, reader_schema)) {
+        avro_freet(Resolver, resolver);
+        return NULL;
+    }
+
+    avro_generic_value_new(resolver->reader_iface, &resolver->reader_value);
+    avro_resolved_writer_new_value(resolver->writer_iface,
+                                   &resolver->writer_value);
+    avro_resolved_writer_set_dest(&resolver->writer_value,
+                                  &resolver->reader_value);
+
+    resolver->writer_schema = avro_schema_incref(writer_schema);
+    resolver->reader_schema = avro_schema_incref(reader_schema);
+
+    return resolver;
+}
+
+int
+resolver_read(Resolver *resolver, avro_reader_t reader)
+{
+    avro_value_reset(&resolver->reader_value);
+    return avro_value_read(reader, &resolver->writer_value);
+}
+
+void
+resolver_free(Resolver *resolver)
+{
+    avro_value_decref(&resolver->writer_value);
+    avro_value_decref(&resolver->reader_value);
+    avro_value_iface_decref(resolver->writer_iface);
+    avro_value_iface_decref(resolver->reader_iface);
+    avro_schema_decref(resolver->writer_schema);
+    avro_schema_decref(resolver->reader_schema);
+    avro_freet(Resolver, resolver);
+}
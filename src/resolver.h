@@ -0,0 +1,46 @@
+/*
+ * Copyright 2015 Byhiras (Europe) Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INC_RESOLVER_H
+#define INC_RESOLVER_H
+
+#include "avro.h"
+
+/*
+ * Decodes data written with one schema into values of another, using
+ * Avro-C's resolved writer: read into writer_value and the result appears
+ * in reader_value.  Building the interfaces is the expensive part, so
+ * they are cached for each pair of writer and reader schemas, and shared
+ * by the resolvers for that pair; each resolver has its own values.
+ */
+typedef struct {
+    avro_schema_t writer_schema;
+    avro_schema_t reader_schema;
+    avro_value_iface_t *writer_iface;
+    avro_value_iface_t *reader_iface;
+    avro_value_t writer_value;
+    avro_value_t reader_value;
+} Resolver;
+
+/* returns NULL with the avro error set if the schemas don't match */
+Resolver *resolver_new(avro_schema_t writer_schema, avro_schema_t reader_schema);
+
+/* decode the next datum from reader into reader_value */
+int resolver_read(Resolver *resolver, avro_reader_t reader);
+
+void resolver_free(Resolver *resolver);
+
+#endif
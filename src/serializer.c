@@ -19,31 +19,42 @@
 #include "structmember.h"
 #include "error.h"
 #include "util.h"
+#include "avroschema.h"
 
 #define PYAVROC_BUFFER_SIZE (128 * 1024)
 
+/* how many calls between checks whether the buffer can shrink */
+#define PYAVROC_SHRINK_INTERVAL 64
+
 
 static int
 AvroSerializer_init(AvroSerializer *self, PyObject *args, PyObject *kwds)
 {
-    int rval;
-    const char *schema_json;
+    PyObject *pyschema;
+    int single_object = 0;
+    uint64_t fingerprint;
+    static char *kwlist[] = {"schema", "single_object", NULL};
 
     self->flags = 0;
     self->iface = NULL;
+    self->header_len = 0;
 
-    if (!PyArg_ParseTuple(args, "s", &schema_json)) {
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|i", kwlist,
+                                     &pyschema, &single_object)) {
         return -1;
     }
 
-    rval = avro_schema_from_json(schema_json, 0, &self->schema, NULL);
-    if (rval != 0 || self->schema == NULL) {
-        PyErr_Format(PyExc_IOError, "Error reading schema: %s",
-                     avro_strerror());
+    self->schema = get_avro_schema(pyschema, &fingerprint);
+    if (self->schema == NULL) {
         return -1;
     }
     self->flags |= SERIALIZER_SCHEMA_OK;
 
+    if (single_object) {
+        single_object_header(fingerprint, self->header);
+        self->header_len = SINGLE_OBJECT_HEADER_SIZE;
+    }
+
     self->iface = avro_generic_class_from_schema(self->schema);
     if (self->iface == NULL) {
         PyErr_SetString(PyExc_IOError,
@@ -52,11 +63,14 @@ AvroSerializer_init(AvroSerializer *self, PyObject *args, PyObject *kwds)
     }
 
     self->buffer_size = PYAVROC_BUFFER_SIZE;  /* Initial size */
+    self->high_water = 0;
+    self->calls = 0;
     self->buffer = (char *) avro_malloc(self->buffer_size);
     if (!self->buffer) {
         PyErr_NoMemory();
         return -1;
     }
+    stats_count_alloc(&self->stats, 0);
     self->flags |= SERIALIZER_BUFFER_OK;
 
     self->datum_writer = avro_writer_memory(self->buffer, self->buffer_size);
@@ -99,11 +113,135 @@ AvroSerializer_dealloc(AvroSerializer *self)
     Py_TYPE(self)->tp_free((PyObject*) self);
 }
 
+static int
+resize_buffer(AvroSerializer *self, size_t new_size)
+{
+    char *new_buffer = (char *)avro_realloc(self->buffer, self->buffer_size,
+                                            new_size);
+    if (!new_buffer) {
+        return ENOMEM;
+    }
+    if (new_size > self->buffer_size) {
+        stats_count_alloc(&self->stats, self->buffer_size);
+    } else {
+        self->stats.allocations++;
+    }
+    self->buffer = new_buffer;
+    self->buffer_size = new_size;
+    return 0;
+}
+
+/* smallest power of two multiple of the initial size holding size bytes */
+static size_t
+buffer_size_for(size_t size)
+{
+    size_t new_size = PYAVROC_BUFFER_SIZE;
+
+    while (new_size < size) {
+        new_size *= 2;
+    }
+    return new_size;
+}
+
+/*
+ * Encode value at offset pos in our buffer and set *len to the encoded
+ * size.  If it doesn't fit, find out exactly how big it is and grow the
+ * buffer once, so a big record is encoded at most twice.
+ */
+static int
+write_value(AvroSerializer *self, avro_value_t *value, size_t pos, size_t *len)
+{
+    int rval;
+    size_t size;
+    uint64_t start = stats_now();
+
+    avro_writer_memory_set_dest(self->datum_writer, self->buffer + pos,
+                                self->buffer_size - pos);
+    rval = avro_value_write(self->datum_writer, value);
+
+    if (rval == ENOSPC) {
+        rval = avro_value_sizeof(value, &size);
+        if (!rval && resize_buffer(self, buffer_size_for(pos + size))) {
+            PyErr_NoMemory();
+            return ENOMEM;
+        }
+        if (!rval) {
+            avro_writer_memory_set_dest(self->datum_writer, self->buffer + pos,
+                                        self->buffer_size - pos);
+            rval = avro_value_write(self->datum_writer, value);
+        }
+    }
+
+    if (!rval) {
+        *len = avro_writer_tell(self->datum_writer);
+        self->stats.records++;
+        self->stats.uncompressed_bytes += *len;
+    }
+    self->stats.avro_ns += stats_now() - start;
+    return rval;
+}
+
+static int
+to_avro(AvroSerializer *self, PyObject *pyobj, avro_value_t *value)
+{
+    uint64_t start = stats_now();
+    int rval = python_to_avro(NULL, pyobj, value);
+
+    self->stats.convert_ns += stats_now() - start;
+    return rval;
+}
+
+/* write our header, if any, then the value */
+static int
+write_framed(AvroSerializer *self, avro_value_t *value, size_t pos,
+             size_t *len)
+{
+    int rval;
+
+    if (pos + self->header_len > self->buffer_size
+        && resize_buffer(self, buffer_size_for(pos + self->header_len))) {
+        PyErr_NoMemory();
+        return ENOMEM;
+    }
+    memcpy(self->buffer + pos, self->header, self->header_len);
+
+    rval = write_value(self, value, pos + self->header_len, len);
+    if (!rval) {
+        *len += self->header_len;
+    }
+    return rval;
+}
+
+/*
+ * Don't hold on to a big buffer after an outlier: every
+ * PYAVROC_SHRINK_INTERVAL calls, shrink it to fit the most used since.
+ */
+static void
+update_high_water(AvroSerializer *self, size_t used)
+{
+    size_t new_size;
+
+    if (used > self->high_water) {
+        self->high_water = used;
+    }
+    if (++self->calls < PYAVROC_SHRINK_INTERVAL) {
+        return;
+    }
+
+    new_size = buffer_size_for(self->high_water);
+    if (new_size < self->buffer_size) {
+        /* keeping the bigger buffer is fine if this fails */
+        resize_buffer(self, new_size);
+    }
+    self->high_water = 0;
+    self->calls = 0;
+}
+
 static PyObject *
 AvroSerializer_serialize(AvroSerializer *self, PyObject *args)
 {
     int rval;
-    size_t new_size;
+    size_t len;
     avro_value_t value;
     PyObject *pyvalue;
     PyObject *serialized;
@@ -112,35 +250,201 @@ AvroSerializer_serialize(AvroSerializer *self, PyObject *args)
         return NULL;
     }
     avro_generic_value_new(self->iface, &value);
-    rval = python_to_avro(NULL, pyvalue, &value);
+    rval = to_avro(self, pyvalue, &value);
     if (!rval) {
-        rval = avro_value_write(self->datum_writer, &value);
+        rval = write_framed(self, &value, 0, &len);
     }
 
-    while(rval == ENOSPC) {
-        new_size = self->buffer_size * 2;
-        self->buffer = (char*) avro_realloc(
-            self->buffer, self->buffer_size, new_size);
-        if (!self->buffer) {
-            PyErr_NoMemory();
-            return NULL;
+    if (rval) {
+        avro_value_decref(&value);
+        if (rval != ENOMEM) {
+            set_error_prefix("Write error: ");
         }
-        self->buffer_size = new_size;
-        avro_writer_memory_set_dest(
-              self->datum_writer, self->buffer, self->buffer_size);
-        rval = avro_value_write(self->datum_writer, &value);
+        return NULL;
+    }
+
+    serialized = chars_size_to_pybytes(self->buffer, len);
+    avro_value_decref(&value);
+    update_high_water(self, len);
+    return serialized;
+}
+
+/* the number of bytes serialize or serialize_into would take for a record */
+static PyObject *
+AvroSerializer_size(AvroSerializer *self, PyObject *args)
+{
+    int rval;
+    size_t size;
+    avro_value_t value;
+    PyObject *pyvalue;
+
+    if (!PyArg_ParseTuple(args, "O", &pyvalue)) {
+        return NULL;
+    }
+    avro_generic_value_new(self->iface, &value);
+    rval = to_avro(self, pyvalue, &value);
+    if (!rval) {
+        rval = avro_value_sizeof(&value, &size);
+        if (rval) {
+            set_avro_error(rval);
+        }
+    }
+    avro_value_decref(&value);
+    if (rval) {
+        set_error_prefix("Write error: ");
+        return NULL;
+    }
+
+    return PyLong_FromSize_t(self->header_len + size);
+}
+
+/*
+ * Encode a record straight into a writable buffer at offset, returning
+ * the number of bytes written.  If it doesn't fit, the error gives the
+ * size needed, which size() also gives, and the buffer may have been
+ * partly written.
+ */
+static PyObject *
+AvroSerializer_serialize_into(AvroSerializer *self, PyObject *args,
+                              PyObject *kwds)
+{
+    int rval;
+    size_t size = 0;
+    uint64_t start;
+    Py_ssize_t offset = 0;
+    Py_buffer view;
+    avro_value_t value;
+    PyObject *pyvalue;
+    PyObject *pybuf;
+    PyObject *result = NULL;
+    static char *kwlist[] = {"datum", "buf", "offset", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OO|n", kwlist,
+                                     &pyvalue, &pybuf, &offset)) {
+        return NULL;
+    }
+
+    if (PyObject_GetBuffer(pybuf, &view, PyBUF_WRITABLE) < 0) {
+        return NULL;
+    }
+
+    if (offset < 0 || offset > view.len) {
+        PyErr_Format(PyExc_ValueError, "Offset %zd out of range", offset);
+        PyBuffer_Release(&view);
+        return NULL;
     }
 
+    avro_generic_value_new(self->iface, &value);
+    rval = to_avro(self, pyvalue, &value);
+    if (rval) {
+        set_error_prefix("Write error: ");
+        goto done;
+    }
+
+    if ((size_t)(view.len - offset) < self->header_len) {
+        rval = ENOSPC;
+    } else {
+        memcpy((char *)view.buf + offset, self->header, self->header_len);
+        avro_writer_memory_set_dest(self->datum_writer,
+                                    (char *)view.buf + offset + self->header_len,
+                                    view.len - offset - self->header_len);
+        start = stats_now();
+        rval = avro_value_write(self->datum_writer, &value);
+        self->stats.avro_ns += stats_now() - start;
+    }
+    if (rval == ENOSPC) {
+        avro_value_sizeof(&value, &size);
+        PyErr_Format(PyExc_ValueError,
+                     "Buffer too small: need %zu bytes at offset %zd, have %zd",
+                     self->header_len + size, offset, view.len - offset);
+        goto done;
+    }
     if (rval) {
-        avro_value_decref(&value);
         set_error_prefix("Write error: ");
+        goto done;
+    }
+
+    size = avro_writer_tell(self->datum_writer);
+    self->stats.records++;
+    self->stats.uncompressed_bytes += size;
+    result = PyLong_FromSsize_t(self->header_len + size);
+
+done:
+    avro_value_decref(&value);
+    PyBuffer_Release(&view);
+    return result;
+}
+
+/*
+ * Encode a sequence of records back to back, returning the bytes and an
+ * array of n + 1 offsets: record i is data[offsets[i]:offsets[i + 1]].
+ */
+static PyObject *
+AvroSerializer_serialize_many(AvroSerializer *self, PyObject *args)
+{
+    int rval = 0;
+    Py_ssize_t i;
+    Py_ssize_t n;
+    size_t pos = 0;
+    size_t len;
+    uint64_t *offsets;
+    avro_value_t value;
+    PyObject *pyvalues;
+    PyObject *seq;
+    PyObject *pydata;
+    PyObject *pyoffsets;
+    PyObject *result = NULL;
+
+    if (!PyArg_ParseTuple(args, "O", &pyvalues)) {
         return NULL;
     }
 
-    serialized = chars_size_to_pybytes(self->buffer, avro_writer_tell(self->datum_writer));
-    avro_writer_reset(self->datum_writer);
+    seq = PySequence_Fast(pyvalues, "expected a sequence of records");
+    if (seq == NULL) {
+        return NULL;
+    }
+    n = PySequence_Fast_GET_SIZE(seq);
+
+    offsets = (uint64_t *)PyMem_Malloc((n + 1) * sizeof(uint64_t));
+    if (offsets == NULL) {
+        Py_DECREF(seq);
+        return PyErr_NoMemory();
+    }
+    offsets[0] = 0;
+
+    /* one value, reset for each record */
+    avro_generic_value_new(self->iface, &value);
+    for (i = 0; i < n; i++) {
+        avro_value_reset(&value);
+        rval = to_avro(self, PySequence_Fast_GET_ITEM(seq, i), &value);
+        if (!rval) {
+            rval = write_framed(self, &value, pos, &len);
+        }
+        if (rval) {
+            if (rval != ENOMEM) {
+                set_error_prefix("Write error in record %zd: ", i);
+            }
+            break;
+        }
+        pos += len;
+        offsets[i + 1] = pos;
+    }
     avro_value_decref(&value);
-    return serialized;
+    Py_DECREF(seq);
+
+    if (!rval) {
+        pydata = chars_size_to_pybytes(self->buffer, pos);
+        update_high_water(self, pos);
+        pyoffsets = offsets_to_pyarray(offsets, n + 1);
+        if (pydata != NULL && pyoffsets != NULL) {
+            result = PyTuple_Pack(2, pydata, pyoffsets);
+        }
+        Py_XDECREF(pydata);
+        Py_XDECREF(pyoffsets);
+    }
+    PyMem_Free(offsets);
+
+    return result;
 }
 
 static PyObject *
@@ -159,6 +463,37 @@ static PyMethodDef AvroSerializer_methods[] = {
     {"serialize", (PyCFunction)AvroSerializer_serialize, METH_VARARGS,
      "Serialize a record."
     },
+    {"serialize_into", (PyCFunction)AvroSerializer_serialize_into, METH_VARARGS | METH_KEYWORDS,
+     "Serialize a record into a writable buffer at offset.\n"
+     "Returns the number of bytes written."
+    },
+    {"size", (PyCFunction)AvroSerializer_size, METH_VARARGS,
+     "Return the number of bytes serializing a record would take,\n"
+     "for sizing a buffer for serialize_into."
+    },
+    {"serialize_many", (PyCFunction)AvroSerializer_serialize_many, METH_VARARGS,
+     "Serialize a sequence of records into one buffer.\n"
+     "Returns (bytes, offsets), with n + 1 offsets."
+    },
+    {NULL}  /* Sentinel */
+};
+
+static PyObject *
+AvroSerializer_get_stats(AvroSerializer *self, void *closure)
+{
+    return stats_to_pydict(&self->stats, 1);
+}
+
+static PyGetSetDef AvroSerializer_getset[] = {
+    {"stats", (getter)AvroSerializer_get_stats, NULL,
+     "counters and times (ns) for the records serialized so far", NULL},
+    {NULL}  /* Sentinel */
+};
+
+static PyMemberDef AvroSerializer_members[] = {
+    /* size_t, but the same width */
+    {"buffer_size", T_PYSSIZET, offsetof(AvroSerializer, buffer_size), READONLY,
+     "current size of the output buffer"},
     {NULL}  /* Sentinel */
 };
 
@@ -191,8 +526,8 @@ PyTypeObject avroSerializerType = {
     0,                                   /* tp_iter */
     0,                                   /* tp_iternext */
     AvroSerializer_methods,              /* tp_methods */
-    0,                                   /* tp_members */
-    0,                                   /* tp_getset */
+    AvroSerializer_members,              /* tp_members */
+    AvroSerializer_getset,               /* tp_getset */
     0,                                   /* tp_base */
     0,                                   /* tp_dict */
     0,                                   /* tp_descr_get */
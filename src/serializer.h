@@ -20,6 +20,8 @@
 #include "Python.h"
 #include "convert.h"
 #include "avro.h"
+#include "fingerprint.h"
+#include "stats.h"
 
 #define SERIALIZER_WRITER_OK 0x1
 #define SERIALIZER_SCHEMA_OK 0x2
@@ -31,10 +33,17 @@ typedef struct {
     int flags;
     char *buffer;
     size_t buffer_size;
+    size_t high_water;  /* most of the buffer used since the last shrink */
+    int calls;
+
+    char header[SINGLE_OBJECT_HEADER_SIZE];
+    size_t header_len;  /* 0 unless single-object encoding */
 
     avro_schema_t schema;
     avro_value_iface_t *iface;
     avro_writer_t datum_writer;
+
+    Stats stats;
 } AvroSerializer;
 
 extern PyTypeObject avroSerializerType;
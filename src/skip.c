@@ -0,0 +1,378 @@
+/*
+ * Copyright 2015 Byhiras (Europe) Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "skip.h"
+
+#include <stdlib.h>
+
+typedef struct {
+    const char *pos;
+    const char *end;
+    const char *start;
+    Spans *bytes;   /* if we are collecting bytes values */
+    Spans *arrays;  /* and arrays of ints or longs */
+    int in_map;
+    int validate;   /* check the items of blocks that give their size */
+} Cursor;
+
+static int
+add_span(Spans *spans, size_t offset, size_t len)
+{
+    size_t *pairs;
+    size_t size;
+
+    if (spans->count == spans->size) {
+        size = spans->size ? 2 * spans->size : 16;
+        pairs = (size_t *)realloc(spans->pairs, 2 * size * sizeof(size_t));
+        if (pairs == NULL) {
+            avro_set_error("Cannot allocate spans");
+            return ENOMEM;
+        }
+        spans->pairs = pairs;
+        spans->size = size;
+    }
+    spans->pairs[2 * spans->count] = offset;
+    spans->pairs[2 * spans->count + 1] = len;
+    spans->count++;
+    return 0;
+}
+
+static int
+skip_bytes(Cursor *cur, int64_t n)
+{
+    if (n < 0 || n > cur->end - cur->pos) {
+        avro_set_error("Truncated or invalid datum");
+        return EILSEQ;
+    }
+    cur->pos += n;
+    return 0;
+}
+
+static int
+read_long(Cursor *cur, int64_t *l)
+{
+    uint64_t n = 0;
+    int shift = 0;
+    unsigned char c;
+
+    do {
+        if (cur->pos >= cur->end || shift >= 64) {
+            avro_set_error("Truncated or invalid varint");
+            return EILSEQ;
+        }
+        c = (unsigned char)*cur->pos++;
+        n |= (uint64_t)(c & 0x7f) << shift;
+        shift += 7;
+    } while (c & 0x80);
+
+    *l = (int64_t)(n >> 1) ^ -(int64_t)(n & 1);
+    return 0;
+}
+
+static int
+read_index(Cursor *cur, int64_t size, int64_t *index)
+{
+    int rval = read_long(cur, index);
+
+    if (!rval && (*index < 0 || *index >= size)) {
+        avro_set_error("Index %lld out of range", (long long)*index);
+        return EILSEQ;
+    }
+    return rval;
+}
+
+static int skip(Cursor *cur, avro_schema_t schema);
+
+/*
+ * Whether a value always encodes to no bytes at all: null, a fixed of
+ * size 0, or a record of those.  depth stops at links that go round.
+ */
+static int
+zero_width(avro_schema_t schema, int depth)
+{
+    size_t i;
+
+    switch (avro_typeof(schema)) {
+    case AVRO_NULL:
+        return 1;
+    case AVRO_FIXED:
+        return avro_schema_fixed_size(schema) == 0;
+    case AVRO_RECORD:
+        for (i = 0; i < avro_schema_record_size(schema); i++) {
+            if (!zero_width(avro_schema_record_field_get_by_index(schema, i),
+                            depth)) {
+                return 0;
+            }
+        }
+        return 1;
+    case AVRO_LINK:
+        return depth < 16
+            && zero_width(avro_schema_link_target(schema), depth + 1);
+    default:
+        return 0;
+    }
+}
+
+/*
+ * arrays and maps: a sequence of blocks, ending with an empty one.  Sets
+ * *total to the number of items.
+ */
+static int
+skip_blocks(Cursor *cur, avro_schema_t items, int is_map, size_t *total)
+{
+    int rval;
+    int64_t count;
+    int64_t block_size;
+    int64_t width = 0;
+    const char *block_end;
+
+    /*
+     * floats and doubles can be stepped over a block at a time, and
+     * items with no bytes at all in no time
+     */
+    if (avro_typeof(items) == AVRO_FLOAT && !is_map) {
+        width = 4;
+    } else if (avro_typeof(items) == AVRO_DOUBLE && !is_map) {
+        width = 8;
+    } else if (!is_map && zero_width(items, 0)) {
+        width = -1;
+    }
+
+    *total = 0;
+    for (;;) {
+        rval = read_long(cur, &count);
+        if (rval || count == 0) {
+            return rval;
+        }
+        if (count == INT64_MIN) {
+            avro_set_error("Invalid block count");
+            return EILSEQ;
+        }
+        *total += (size_t)(count < 0 ? -count : count);
+        block_end = NULL;
+        if (count < 0) {
+            /* the writer told us the size, so jump straight over */
+            rval = read_long(cur, &block_size);
+            if (rval) {
+                return rval;
+            }
+            if (!cur->validate && cur->bytes == NULL && cur->arrays == NULL) {
+                rval = skip_bytes(cur, block_size);
+                if (rval) {
+                    return rval;
+                }
+                continue;
+            }
+            /* unless we need to check or find the values inside */
+            if (block_size < 0 || block_size > cur->end - cur->pos) {
+                avro_set_error("Truncated or invalid datum");
+                return EILSEQ;
+            }
+            block_end = cur->pos + block_size;
+            count = -count;
+        }
+        if (width > 0) {
+            if (count > (cur->end - cur->pos) / width) {
+                avro_set_error("Truncated or invalid datum");
+                return EILSEQ;
+            }
+            cur->pos += count * width;
+        } else if (!width && count > cur->end - cur->pos) {
+            /* each item takes a byte at least, so don't trust the count */
+            avro_set_error("Block count %lld is more than the datum holds",
+                           (long long)count);
+            return EILSEQ;
+        }
+        for ( ; !width && count > 0; count--) {
+            int64_t key_size;
+
+            if (is_map) {
+                rval = read_long(cur, &key_size);
+                if (!rval) {
+                    rval = skip_bytes(cur, key_size);
+                }
+                if (rval) {
+                    return rval;
+                }
+            }
+            rval = skip(cur, items);
+            if (rval) {
+                return rval;
+            }
+        }
+        if (block_end != NULL && cur->pos != block_end) {
+            avro_set_error("Block size %lld does not match its items",
+                           (long long)block_size);
+            return EILSEQ;
+        }
+    }
+}
+
+static int
+skip(Cursor *cur, avro_schema_t schema)
+{
+    int rval;
+    int64_t l;
+
+    switch (avro_typeof(schema)) {
+    case AVRO_NULL:
+        return 0;
+    case AVRO_BOOLEAN:
+        if (cur->pos >= cur->end || (unsigned char)*cur->pos > 1) {
+            avro_set_error("Truncated or invalid boolean");
+            return EILSEQ;
+        }
+        cur->pos++;
+        return 0;
+    case AVRO_INT32:
+        rval = read_long(cur, &l);
+        if (!rval && (l < INT32_MIN || l > INT32_MAX)) {
+            avro_set_error("Value %lld out of range for int", (long long)l);
+            return EILSEQ;
+        }
+        return rval;
+    case AVRO_INT64:
+        return read_long(cur, &l);
+    case AVRO_FLOAT:
+        return skip_bytes(cur, 4);
+    case AVRO_DOUBLE:
+        return skip_bytes(cur, 8);
+    case AVRO_BYTES:
+        rval = read_long(cur, &l);
+        if (!rval && cur->bytes != NULL && !cur->in_map
+            && l >= 0 && l <= cur->end - cur->pos) {
+            rval = add_span(cur->bytes, cur->pos - cur->start, (size_t)l);
+        }
+        return rval ? rval : skip_bytes(cur, l);
+    case AVRO_STRING:
+        rval = read_long(cur, &l);
+        return rval ? rval : skip_bytes(cur, l);
+    case AVRO_FIXED:
+        return skip_bytes(cur, avro_schema_fixed_size(schema));
+    case AVRO_ENUM:
+        return read_index(cur, avro_schema_enum_number_of_symbols(schema), &l);
+    case AVRO_ARRAY:
+        {
+            avro_schema_t items = avro_schema_array_items(schema);
+            size_t offset = cur->pos - cur->start;
+            size_t total;
+
+            rval = skip_blocks(cur, items, 0, &total);
+            if (!rval && cur->arrays != NULL && !cur->in_map
+                && (avro_typeof(items) == AVRO_INT32
+                    || avro_typeof(items) == AVRO_INT64
+                    || avro_typeof(items) == AVRO_FLOAT
+                    || avro_typeof(items) == AVRO_DOUBLE)) {
+                rval = add_span(cur->arrays, offset, total);
+            }
+            return rval;
+        }
+    case AVRO_MAP:
+        {
+            size_t total;
+
+            cur->in_map++;
+            rval = skip_blocks(cur, avro_schema_map_values(schema), 1, &total);
+            cur->in_map--;
+            return rval;
+        }
+    case AVRO_UNION:
+        rval = read_index(cur, avro_schema_union_size(schema), &l);
+        return rval ? rval : skip(cur, avro_schema_union_branch(schema, l));
+    case AVRO_RECORD:
+        {
+            size_t field_count = avro_schema_record_size(schema);
+            size_t i;
+            for (i = 0; i < field_count; i++) {
+                rval = skip(cur, avro_schema_record_field_get_by_index(schema, i));
+                if (rval) {
+                    avro_prefix_error("%s.%s: ", avro_schema_name(schema),
+                                      avro_schema_record_field_name(schema, i));
+                    return rval;
+                }
+            }
+            return 0;
+        }
+    case AVRO_LINK:
+        return skip(cur, avro_schema_link_target(schema));
+    default:
+        avro_set_error("Unknown schema type");
+        return EINVAL;
+    }
+}
+
+static int
+skip_all(const char *buf, size_t len, avro_schema_t schema, size_t *size,
+         int validate)
+{
+    Cursor cur;
+    int rval;
+
+    cur.pos = buf;
+    cur.end = buf + len;
+    cur.start = buf;
+    cur.bytes = NULL;
+    cur.arrays = NULL;
+    cur.in_map = 0;
+    cur.validate = validate;
+
+    rval = skip(&cur, schema);
+    if (!rval) {
+        *size = cur.pos - buf;
+    }
+    return rval;
+}
+
+int
+skip_datum(const char *buf, size_t len, avro_schema_t schema, size_t *size)
+{
+    return skip_all(buf, len, schema, size, 0);
+}
+
+int
+validate_datum(const char *buf, size_t len, avro_schema_t schema,
+               size_t *size)
+{
+    return skip_all(buf, len, schema, size, 1);
+}
+
+int
+locate_values(const char *buf, size_t len, avro_schema_t schema,
+              size_t *size, Spans *bytes, Spans *arrays)
+{
+    Cursor cur;
+    int rval;
+
+    cur.pos = buf;
+    cur.end = buf + len;
+    cur.start = buf;
+    cur.bytes = bytes;
+    cur.arrays = arrays;
+    cur.in_map = 0;
+    cur.validate = 0;
+    if (bytes != NULL) {
+        bytes->count = 0;
+    }
+    if (arrays != NULL) {
+        arrays->count = 0;
+    }
+
+    rval = skip(&cur, schema);
+    if (!rval) {
+        *size = cur.pos - buf;
+    }
+    return rval;
+}
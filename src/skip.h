@@ -0,0 +1,58 @@
+/*
+ * Copyright 2015 Byhiras (Europe) Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INC_SKIP_H
+#define INC_SKIP_H
+
+#include "avro.h"
+
+/*
+ * Find the size of the binary encoded datum at the start of buf by
+ * stepping over it, without building any values.  Along the way it checks
+ * that the encoding is well formed: lengths and counts in range, union and
+ * enum indices valid, booleans 0 or 1.  Array and map blocks that give
+ * their size in bytes are jumped over without looking at their items.
+ *
+ * Returns 0 and sets *size, or EILSEQ with the avro error set.
+ */
+int skip_datum(const char *buf, size_t len, avro_schema_t schema,
+               size_t *size);
+
+/*
+ * skip_datum, also checking the items of sized blocks, and that they take
+ * up exactly the size given.
+ */
+int validate_datum(const char *buf, size_t len, avro_schema_t schema,
+                   size_t *size);
+
+/* offset from the start of the datum, and a length or count, of values */
+typedef struct {
+    size_t *pairs;
+    size_t count;
+    size_t size;  /* pairs allocated; free pairs when done */
+} Spans;
+
+/*
+ * skip_datum, also noting where the bytes values are and their lengths,
+ * and where the arrays of ints, longs, floats or doubles are and their
+ * item counts, in the order they are decoded.  Either spans may be NULL.
+ * Values inside maps are left out, as Avro-C can merge entries with the
+ * same key.
+ */
+int locate_values(const char *buf, size_t len, avro_schema_t schema,
+                  size_t *size, Spans *bytes, Spans *arrays);
+
+#endif
@@ -0,0 +1,86 @@
+/*
+ * Copyright 2015 Byhiras (Europe) Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "stats.h"
+
+#include <time.h>
+
+uint64_t
+stats_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void
+stats_count_alloc(Stats *stats, size_t old_size)
+{
+    stats->allocations++;
+    if (old_size > 0) {
+        stats->buffer_grows++;
+    }
+}
+
+static int
+set_counter(PyObject *dict, const char *name, uint64_t value)
+{
+    int rval;
+    PyObject *pyvalue = PyLong_FromUnsignedLongLong(value);
+
+    if (pyvalue == NULL) {
+        return -1;
+    }
+    rval = PyDict_SetItemString(dict, name, pyvalue);
+    Py_DECREF(pyvalue);
+    return rval;
+}
+
+PyObject *
+stats_to_pydict(const Stats *stats, int writing)
+{
+    PyObject *dict = PyDict_New();
+
+    if (dict == NULL) {
+        return NULL;
+    }
+
+    if (set_counter(dict, "records", stats->records)
+        || set_counter(dict, "blocks", stats->blocks)
+        || set_counter(dict, "compressed_bytes", stats->compressed_bytes)
+        || set_counter(dict, "uncompressed_bytes", stats->uncompressed_bytes)
+        || set_counter(dict, "io_ns", stats->io_ns)
+        || set_counter(dict, writing ? "compress_ns" : "decompress_ns",
+                       stats->codec_ns)
+        || set_counter(dict, writing ? "encode_ns" : "decode_ns",
+                       stats->avro_ns)
+        || set_counter(dict, "convert_ns", stats->convert_ns)
+        || set_counter(dict, "allocations", stats->allocations)
+        || set_counter(dict, "buffer_grows", stats->buffer_grows)) {
+        Py_DECREF(dict);
+        return NULL;
+    }
+
+    if (!writing
+        && (set_counter(dict, "string_cache_hits", stats->string_hits)
+            || set_counter(dict, "string_cache_misses", stats->string_misses))) {
+        Py_DECREF(dict);
+        return NULL;
+    }
+
+    return dict;
+}
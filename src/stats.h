@@ -0,0 +1,54 @@
+/*
+ * Copyright 2015 Byhiras (Europe) Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INC_STATS_H
+#define INC_STATS_H
+
+#include "Python.h"
+#include <stdint.h>
+
+/*
+ * Counters kept by readers, writers, serializers and deserializers, cheap
+ * enough to leave on: a few adds per record, and a monotonic clock read
+ * around each stage.  Times are in nanoseconds.
+ *
+ * Whatever avro-c does internally (the snappy and lzma codecs) counts as
+ * encoding or decoding.
+ */
+typedef struct {
+    uint64_t records;
+    uint64_t blocks;
+    uint64_t compressed_bytes;
+    uint64_t uncompressed_bytes;
+    uint64_t io_ns;
+    uint64_t codec_ns;    /* compressing or decompressing blocks */
+    uint64_t avro_ns;     /* encoding or decoding records */
+    uint64_t convert_ns;  /* to or from Python objects */
+    uint64_t allocations;
+    uint64_t buffer_grows;
+    uint64_t string_hits;    /* in a reader's dedup_strings cache */
+    uint64_t string_misses;
+} Stats;
+
+uint64_t stats_now(void);
+
+/* count a buffer (re)allocation from old_size to a larger new_size */
+void stats_count_alloc(Stats *stats, size_t old_size);
+
+/* the counters as a dict, named for the direction of the data */
+PyObject *stats_to_pydict(const Stats *stats, int writing);
+
+#endif
@@ -0,0 +1,350 @@
+/*
+ * Copyright 2015 Byhiras (Europe) Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "strcache.h"
+#include "util.h"
+
+#include <string.h>
+
+/* when caching everything, give up after this many clears in a row */
+#define GIVE_UP_CLEARS 4
+
+typedef struct {
+    uint64_t hash;
+    const char *key;   /* the str's own UTF-8 */
+    size_t len;
+    PyObject *str;     /* NULL for an empty slot */
+} Entry;
+
+typedef struct {
+    avro_schema_t record;
+    size_t field_count;
+    unsigned char *wanted;
+} RecordFields;
+
+struct StringCache {
+    Entry *entries;
+    size_t capacity;       /* a power of two, at least twice size */
+    size_t count;
+    size_t size;
+    int all;
+    int enabled;
+    char **names;          /* the fields to cache, unless all */
+    size_t name_count;
+    RecordFields *records; /* which fields of each record are named */
+    size_t record_count;
+    uint64_t hits;         /* since the last clear */
+    uint64_t misses;
+    int bad_clears;
+    Stats *stats;
+};
+
+/* FNV-1a */
+static uint64_t
+hash_bytes(const char *buf, size_t len)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        hash ^= (unsigned char)buf[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static void
+clear_entries(StringCache *cache)
+{
+    size_t i;
+
+    for (i = 0; i < cache->capacity; i++) {
+        Py_CLEAR(cache->entries[i].str);
+    }
+    cache->count = 0;
+}
+
+static int
+set_names(StringCache *cache, PyObject *fields)
+{
+    PyObject *seq;
+    PyObject *tmp;
+    const char *name;
+    Py_ssize_t len;
+    Py_ssize_t i;
+
+    if (is_pystring(fields) || !PySequence_Check(fields)) {
+        PyErr_SetString(PyExc_TypeError,
+                        "dedup_strings must be True or a sequence of field names");
+        return -1;
+    }
+    seq = PySequence_Fast(fields, "dedup_strings must be a sequence");
+    if (seq == NULL) {
+        return -1;
+    }
+
+    cache->names = (char **)PyMem_Malloc(
+        (PySequence_Fast_GET_SIZE(seq) + 1) * sizeof(char *));
+    if (cache->names == NULL) {
+        Py_DECREF(seq);
+        PyErr_NoMemory();
+        return -1;
+    }
+    for (i = 0; i < PySequence_Fast_GET_SIZE(seq); i++) {
+        name = pystring_to_utf8(PySequence_Fast_GET_ITEM(seq, i), &len, &tmp);
+        if (name == NULL) {
+            Py_DECREF(seq);
+            return -1;
+        }
+        cache->names[i] = pymem_strdup(name);
+        Py_XDECREF(tmp);
+        if (cache->names[i] == NULL) {
+            Py_DECREF(seq);
+            PyErr_NoMemory();
+            return -1;
+        }
+        cache->name_count++;
+    }
+
+    Py_DECREF(seq);
+    return 0;
+}
+
+StringCache *
+string_cache_new(PyObject *fields, Py_ssize_t size, Stats *stats)
+{
+    StringCache *cache;
+    int on;
+
+    if (fields == NULL) {
+        return NULL;
+    }
+    on = PyObject_IsTrue(fields);
+    if (on <= 0) {
+        return NULL;
+    }
+    if (size <= 0) {
+        PyErr_SetString(PyExc_ValueError, "dedup_size must be positive");
+        return NULL;
+    }
+
+    cache = (StringCache *)PyMem_Malloc(sizeof(StringCache));
+    if (cache == NULL) {
+        PyErr_NoMemory();
+        return NULL;
+    }
+    memset(cache, 0, sizeof(StringCache));
+    cache->size = (size_t)size;
+    cache->all = PyBool_Check(fields);
+    cache->enabled = 1;
+    cache->stats = stats;
+
+    if (!cache->all && set_names(cache, fields)) {
+        string_cache_free(cache);
+        return NULL;
+    }
+
+    cache->capacity = 16;
+    while (cache->capacity < 2 * cache->size) {
+        cache->capacity *= 2;
+    }
+    cache->entries = (Entry *)PyMem_Malloc(cache->capacity * sizeof(Entry));
+    if (cache->entries == NULL) {
+        cache->capacity = 0;
+        string_cache_free(cache);
+        PyErr_NoMemory();
+        return NULL;
+    }
+    memset(cache->entries, 0, cache->capacity * sizeof(Entry));
+
+    return cache;
+}
+
+void
+string_cache_free(StringCache *cache)
+{
+    size_t i;
+
+    if (cache == NULL) {
+        return;
+    }
+    if (cache->entries != NULL) {
+        clear_entries(cache);
+        PyMem_Free(cache->entries);
+    }
+    for (i = 0; i < cache->name_count; i++) {
+        PyMem_Free(cache->names[i]);
+    }
+    PyMem_Free(cache->names);
+    for (i = 0; i < cache->record_count; i++) {
+        avro_schema_decref(cache->records[i].record);
+        PyMem_Free(cache->records[i].wanted);
+    }
+    PyMem_Free(cache->records);
+    PyMem_Free(cache);
+}
+
+int
+string_cache_all(const StringCache *cache)
+{
+    return cache->all;
+}
+
+static RecordFields *
+add_record(StringCache *cache, avro_schema_t record)
+{
+    RecordFields *records;
+    RecordFields *fields;
+    const char *name;
+    size_t i;
+    size_t j;
+
+    records = (RecordFields *)PyMem_Realloc(
+        cache->records, (cache->record_count + 1) * sizeof(RecordFields));
+    if (records == NULL) {
+        return NULL;
+    }
+    cache->records = records;
+
+    fields = &records[cache->record_count];
+    fields->field_count = avro_schema_record_size(record);
+    fields->wanted = (unsigned char *)PyMem_Malloc(fields->field_count + 1);
+    if (fields->wanted == NULL) {
+        return NULL;
+    }
+    for (i = 0; i < fields->field_count; i++) {
+        name = avro_schema_record_field_name(record, i);
+        fields->wanted[i] = 0;
+        for (j = 0; j < cache->name_count; j++) {
+            if (strcmp(name, cache->names[j]) == 0) {
+                fields->wanted[i] = 1;
+            }
+        }
+    }
+    fields->record = avro_schema_incref(record);
+    cache->record_count++;
+
+    return fields;
+}
+
+int
+string_cache_field_wanted(StringCache *cache, avro_schema_t record,
+                          size_t index)
+{
+    RecordFields *fields = NULL;
+    size_t i;
+
+    for (i = 0; i < cache->record_count; i++) {
+        if (cache->records[i].record == record) {
+            fields = &cache->records[i];
+            break;
+        }
+    }
+    if (fields == NULL) {
+        fields = add_record(cache, record);
+        if (fields == NULL) {
+            return 0;
+        }
+    }
+    return index < fields->field_count && fields->wanted[index];
+}
+
+/*
+ * Whether to add another entry.  A full cache that mostly misses holds
+ * the wrong strings, so start again; one that mostly hits is kept.
+ */
+static int
+make_room(StringCache *cache)
+{
+    int bad;
+
+    if (cache->count < cache->size) {
+        return 1;
+    }
+    if (cache->hits >= cache->misses) {
+        return 0;
+    }
+
+    bad = cache->hits * 8 < cache->misses;
+    clear_entries(cache);
+    cache->hits = 0;
+    cache->misses = 0;
+    cache->bad_clears = bad ? cache->bad_clears + 1 : 0;
+    if (cache->all && cache->bad_clears >= GIVE_UP_CLEARS) {
+        /* too many distinct strings to be worth it */
+        cache->enabled = 0;
+        return 0;
+    }
+    return 1;
+}
+
+PyObject *
+string_cache_get(StringCache *cache, const char *buf, size_t len)
+{
+    size_t mask = cache->capacity - 1;
+    uint64_t hash;
+    size_t i;
+    Entry *entry;
+    PyObject *str;
+    PyObject *tmp;
+    const char *key;
+    Py_ssize_t key_len;
+
+    if (!cache->enabled || len > STRING_CACHE_MAX_LEN) {
+        return utf8_to_pystring(buf, len);
+    }
+
+    hash = hash_bytes(buf, len);
+    for (i = hash & mask; cache->entries[i].str != NULL; i = (i + 1) & mask) {
+        entry = &cache->entries[i];
+        if (entry->hash == hash && entry->len == len
+            && memcmp(entry->key, buf, len) == 0) {
+            cache->hits++;
+            cache->stats->string_hits++;
+            Py_INCREF(entry->str);
+            return entry->str;
+        }
+    }
+
+    cache->misses++;
+    cache->stats->string_misses++;
+    str = utf8_to_pystring(buf, len);
+    if (str == NULL || !make_room(cache)) {
+        return str;
+    }
+
+    /* the key is the str's own UTF-8, which Python 3 keeps with it */
+    key = pystring_to_utf8(str, &key_len, &tmp);
+    if (key == NULL || tmp != NULL) {
+        Py_XDECREF(tmp);
+        PyErr_Clear();
+        return str;
+    }
+
+    /* the cache may have been cleared, so probe again */
+    for (i = hash & mask; cache->entries[i].str != NULL; i = (i + 1) & mask) {
+    }
+    entry = &cache->entries[i];
+    entry->hash = hash;
+    entry->key = key;
+    entry->len = len;
+    Py_INCREF(str);
+    entry->str = str;
+    cache->count++;
+
+    return str;
+}
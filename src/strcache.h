@@ -0,0 +1,62 @@
+/*
+ * Copyright 2015 Byhiras (Europe) Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef INC_STRCACHE_H
+#define INC_STRCACHE_H
+
+#include "Python.h"
+#include "avro.h"
+#include "stats.h"
+
+/*
+ * Readers can share one str object between records for each distinct
+ * string value, for fields like country or status with a handful of
+ * values, rather than making a new str per record.  The cache is a hash
+ * table of the strs made, keyed on their UTF-8, holding at most size of
+ * them, and only strings up to STRING_CACHE_MAX_LEN bytes.
+ *
+ * Either all strings go through the cache, which adapts to what it
+ * sees: when full it is cleared if most lookups missed, and it gives up
+ * if that keeps happening.  Or only the values of the named fields go
+ * through it.
+ */
+
+#define STRING_CACHE_MAX_LEN 256
+#define STRING_CACHE_DEFAULT_SIZE 1024
+
+typedef struct StringCache StringCache;
+
+/*
+ * From a reader's dedup_strings argument: True, or a sequence of field
+ * names.  Returns NULL without an exception for None or False.  Hits and
+ * misses are counted in stats.
+ */
+StringCache *string_cache_new(PyObject *fields, Py_ssize_t size, Stats *stats);
+
+void string_cache_free(StringCache *cache);
+
+/* whether all strings go through the cache, not just named fields */
+int string_cache_all(const StringCache *cache);
+
+/* whether a field of this record schema is one of the named ones */
+int string_cache_field_wanted(StringCache *cache, avro_schema_t record,
+                              size_t index);
+
+/* a str for the UTF-8 in buf, from the cache if we've seen it before */
+PyObject *string_cache_get(StringCache *cache, const char *buf, size_t len);
+
+#endif
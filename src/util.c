@@ -18,6 +18,10 @@
 
 #include "Python.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 char *
 pymem_strdup(const char *str)
 {
@@ -43,6 +47,93 @@ PyObject *pystring_to_pybytes(PyObject *pystr)
 #endif
 }
 
+/*
+ * The UTF-8 of a str, without making a bytes object where we can help it:
+ * Python 3 keeps the UTF-8 with the str.  *tmp is set to a new reference
+ * to drop when done with the UTF-8, or NULL.  Returns NULL with an
+ * exception set if pystr isn't a str or can't be encoded.
+ */
+const char *
+pystring_to_utf8(PyObject *pystr, Py_ssize_t *len, PyObject **tmp)
+{
+#if PY_MAJOR_VERSION < 3
+    char *buf;
+#endif
+
+    *tmp = NULL;
+#if PY_MAJOR_VERSION >= 3
+    if (!PyUnicode_Check(pystr)) {
+        PyErr_Format(PyExc_TypeError,
+                     "expected Unicode, %.200s found", Py_TYPE(pystr)->tp_name);
+        return NULL;
+    }
+    return PyUnicode_AsUTF8AndSize(pystr, len);
+#else
+    if (PyUnicode_Check(pystr)) {
+        *tmp = PyUnicode_AsUTF8String(pystr);
+        if (*tmp == NULL) {
+            return NULL;
+        }
+        pystr = *tmp;
+    }
+    if (PyString_AsStringAndSize(pystr, &buf, len) < 0) {
+        Py_CLEAR(*tmp);
+        return NULL;
+    }
+    return buf;
+#endif
+}
+
+/* whether the len bytes at buf are all ASCII */
+static int
+is_ascii(const char *buf, size_t len)
+{
+    size_t i = 0;
+    uint64_t word;
+    uint64_t bits = 0;
+#ifdef __SSE2__
+    __m128i vbits = _mm_setzero_si128();
+
+    for ( ; i + 16 <= len; i += 16) {
+        vbits = _mm_or_si128(vbits, _mm_loadu_si128((const __m128i *)(buf + i)));
+    }
+    if (_mm_movemask_epi8(vbits) != 0) {
+        return 0;
+    }
+#endif
+    for ( ; i + 8 <= len; i += 8) {
+        memcpy(&word, buf + i, 8);
+        bits |= word;
+    }
+    for ( ; i < len; i++) {
+        bits |= (unsigned char)buf[i];
+    }
+    return (bits & 0x8080808080808080ULL) == 0;
+}
+
+/*
+ * A str from UTF-8.  Most strings are ASCII, which on Python 3 can be
+ * copied straight into a new str once we have checked.  The rest go
+ * through Python's decoder, which validates as it goes.
+ */
+PyObject *
+utf8_to_pystring(const char *buf, size_t len)
+{
+#if PY_MAJOR_VERSION >= 3
+    PyObject *result;
+
+    /* Python shares the empty and one character strings */
+    if (len > 1 && is_ascii(buf, len)) {
+        result = PyUnicode_New(len, 127);
+        if (result != NULL) {
+            memcpy(PyUnicode_1BYTE_DATA(result), buf, len);
+        }
+        return result;
+    }
+#endif
+    return chars_size_to_pystring((char *)buf, len);
+}
+
 /**
  * Return the file object associated with p as a FILE*, if possible.
  *
@@ -115,3 +206,55 @@ pystring_concat_str(PyObject **pystr, PyObject *obj)
     PyString_ConcatAndDel(pystr, PyObject_Str(obj));
 #endif
 }
+
+/* array.array of unsigned 64 bit integers */
+PyObject *
+offsets_to_pyarray(const uint64_t *offsets, size_t count)
+{
+    static PyObject *array_type = NULL;
+    PyObject *array;
+    PyObject *pybytes;
+    PyObject *res;
+
+    if (array_type == NULL) {
+        PyObject *module = PyImport_ImportModule("array");
+        if (module == NULL) {
+            return NULL;
+        }
+        array_type = PyObject_GetAttrString(module, "array");
+        Py_DECREF(module);
+        if (array_type == NULL) {
+            return NULL;
+        }
+    }
+
+#if PY_MAJOR_VERSION >= 3
+    array = PyObject_CallFunction(array_type, "s", "Q");
+#else
+    /* no 'Q' before 3.3, but unsigned long is 64 bits where we build */
+    array = PyObject_CallFunction(array_type, "s", "L");
+#endif
+    if (array == NULL) {
+        return NULL;
+    }
+
+    pybytes = chars_size_to_pybytes((char *)offsets, count * sizeof(uint64_t));
+    if (pybytes == NULL) {
+        Py_DECREF(array);
+        return NULL;
+    }
+
+#if PY_MAJOR_VERSION >= 3
+    res = PyObject_CallMethod(array, "frombytes", "O", pybytes);
+#else
+    res = PyObject_CallMethod(array, "fromstring", "O", pybytes);
+#endif
+    Py_DECREF(pybytes);
+    if (res == NULL) {
+        Py_DECREF(array);
+        return NULL;
+    }
+    Py_DECREF(res);
+
+    return array;
+}
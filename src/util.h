@@ -25,6 +25,10 @@ PyObject *pystring_to_pybytes(PyObject *);
 
 PyObject *chars_size_to_pystring(char *, size_t);
 
+const char *pystring_to_utf8(PyObject *, Py_ssize_t *, PyObject **);
+
+PyObject *utf8_to_pystring(const char *, size_t);
+
 PyObject *chars_size_to_pybytes(char *, size_t);
 
 FILE *pyfile_to_file(PyObject *, const char*);
@@ -35,6 +39,8 @@ void pystring_concat_repr(PyObject **, PyObject *);
 
 void pystring_concat_str(PyObject **, PyObject *);
 
+PyObject *offsets_to_pyarray(const uint64_t *, size_t);
+
 #if PY_MAJOR_VERSION >= 3
 #define long_to_pyint(L) PyLong_FromLong(L)
 #define pyint_to_long(P) PyLong_AsLong(P)
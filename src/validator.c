@@ -0,0 +1,496 @@
+/*
+ * Copyright 2015 Byhiras (Europe) Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "validator.h"
+#include "util.h"
+
+struct ValidatorNode {
+    avro_schema_t schema;
+    avro_type_t type;
+    size_t size;               /* fixed size, or number of children */
+    ValidatorNode **children;  /* items, values, branches or fields */
+    PyObject **names;          /* record field names */
+    PyObject *symbols;         /* enum symbol -> index */
+};
+
+static int
+pyint_value(PyObject *pyobj, PY_LONG_LONG *value)
+{
+    int overflow;
+
+#if PY_MAJOR_VERSION < 3
+    if (PyInt_Check(pyobj)) {
+        *value = PyInt_AS_LONG(pyobj);
+        return 0;
+    }
+#endif
+    if (!PyLong_Check(pyobj)) {
+        return -1;
+    }
+    *value = PyLong_AsLongLongAndOverflow(pyobj, &overflow);
+    if (overflow || (*value == -1 && PyErr_Occurred())) {
+        PyErr_Clear();
+        return -1;
+    }
+    return 0;
+}
+
+int
+validate_int32(PyObject *pyobj)
+{
+    PY_LONG_LONG value;
+
+    if (pyint_value(pyobj, &value)) {
+        return -1;
+    }
+    return (value >= INT32_MIN && value <= INT32_MAX) ? 0 : -1;
+}
+
+int
+validate_int64(PyObject *pyobj)
+{
+    PY_LONG_LONG value;
+
+    return pyint_value(pyobj, &value);
+}
+
+/* fixed values are strings, checked by their UTF-8 size as written */
+int
+validate_fixed(PyObject *pyobj, size_t size)
+{
+    Py_ssize_t len;
+
+    if (!is_pystring(pyobj)) {
+        return -1;
+    }
+#if PY_MAJOR_VERSION >= 3
+    if (PyUnicode_IS_ASCII(pyobj)) {
+        len = PyUnicode_GET_LENGTH(pyobj);
+    } else if (PyUnicode_AsUTF8AndSize(pyobj, &len) == NULL) {
+        PyErr_Clear();
+        return -1;
+    }
+#else
+    if (PyString_Check(pyobj)) {
+        len = PyString_GET_SIZE(pyobj);
+    } else {
+        PyObject *pybytes = pystring_to_pybytes(pyobj);
+        if (pybytes == NULL) {
+            PyErr_Clear();
+            return -1;
+        }
+        len = PyString_GET_SIZE(pybytes);
+        Py_DECREF(pybytes);
+    }
+#endif
+    return (size_t)len == size ? 0 : -1;
+}
+
+static void
+node_free(ValidatorNode *node)
+{
+    size_t i;
+
+    if (node->names != NULL) {
+        for (i = 0; i < node->size; i++) {
+            Py_XDECREF(node->names[i]);
+        }
+        free(node->names);
+    }
+    free(node->children);
+    Py_XDECREF(node->symbols);
+    free(node);
+}
+
+static ValidatorNode *compile_node(AvroValidator *self, avro_schema_t schema);
+
+static int
+compile_children(ValidatorNode *node, size_t count)
+{
+    node->size = count;
+    node->children = (ValidatorNode **)calloc(count ? count : 1,
+                                              sizeof(ValidatorNode *));
+    if (node->children == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    return 0;
+}
+
+static int
+compile_record(AvroValidator *self, ValidatorNode *node)
+{
+    size_t i;
+
+    if (compile_children(node, avro_schema_record_size(node->schema))) {
+        return -1;
+    }
+    node->names = (PyObject **)calloc(node->size ? node->size : 1,
+                                      sizeof(PyObject *));
+    if (node->names == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    for (i = 0; i < node->size; i++) {
+        node->names[i] = chars_to_pystring(
+            avro_schema_record_field_name(node->schema, i));
+        if (node->names[i] == NULL) {
+            return -1;
+        }
+        node->children[i] = compile_node(
+            self, avro_schema_record_field_get_by_index(node->schema, i));
+        if (node->children[i] == NULL) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int
+compile_enum(ValidatorNode *node)
+{
+    int i;
+    int rval;
+    PyObject *symbol;
+    PyObject *index;
+
+    node->size = avro_schema_enum_number_of_symbols(node->schema);
+    node->symbols = PyDict_New();
+    if (node->symbols == NULL) {
+        return -1;
+    }
+    for (i = 0; i < (int)node->size; i++) {
+        symbol = chars_to_pystring(avro_schema_enum_get(node->schema, i));
+        index = long_to_pyint(i);
+        rval = (symbol == NULL || index == NULL
+                || PyDict_SetItem(node->symbols, symbol, index));
+        Py_XDECREF(symbol);
+        Py_XDECREF(index);
+        if (rval) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Nodes are shared by schema, so a recursive record refers back to the
+ * node already being compiled.
+ */
+static ValidatorNode *
+compile_node(AvroValidator *self, avro_schema_t schema)
+{
+    ValidatorNode *node;
+    size_t i;
+    int rval = 0;
+
+    while (avro_typeof(schema) == AVRO_LINK) {
+        schema = avro_schema_link_target(schema);
+    }
+
+    for (i = 0; i < self->node_count; i++) {
+        if (self->nodes[i]->schema == schema) {
+            return self->nodes[i];
+        }
+    }
+
+    if (self->node_count == self->node_alloc) {
+        size_t new_alloc = self->node_alloc ? 2 * self->node_alloc : 16;
+        ValidatorNode **nodes = (ValidatorNode **)realloc(
+            self->nodes, new_alloc * sizeof(ValidatorNode *));
+        if (nodes == NULL) {
+            PyErr_NoMemory();
+            return NULL;
+        }
+        self->nodes = nodes;
+        self->node_alloc = new_alloc;
+    }
+
+    node = (ValidatorNode *)calloc(1, sizeof(ValidatorNode));
+    if (node == NULL) {
+        PyErr_NoMemory();
+        return NULL;
+    }
+    node->schema = schema;
+    node->type = avro_typeof(schema);
+    self->nodes[self->node_count++] = node;
+
+    switch (node->type) {
+    case AVRO_FIXED:
+        node->size = avro_schema_fixed_size(schema);
+        break;
+    case AVRO_ENUM:
+        rval = compile_enum(node);
+        break;
+    case AVRO_ARRAY:
+    case AVRO_MAP:
+        rval = compile_children(node, 1);
+        if (!rval) {
+            node->children[0] = compile_node(
+                self, node->type == AVRO_ARRAY ? avro_schema_array_items(schema)
+                                               : avro_schema_map_values(schema));
+            rval = (node->children[0] == NULL);
+        }
+        break;
+    case AVRO_UNION:
+        rval = compile_children(node, avro_schema_union_size(schema));
+        for (i = 0; !rval && i < node->size; i++) {
+            node->children[i] = compile_node(
+                self, avro_schema_union_branch(schema, i));
+            rval = (node->children[i] == NULL);
+        }
+        break;
+    case AVRO_RECORD:
+        rval = compile_record(self, node);
+        break;
+    default:
+        break;
+    }
+
+    return rval ? NULL : node;
+}
+
+/* same results as validate() in convert.c */
+static int
+check(ValidatorNode *node, PyObject *pyobj)
+{
+    size_t i;
+
+    switch (node->type) {
+    case AVRO_NULL:
+        return pyobj == Py_None ? 0 : -1;
+    case AVRO_BOOLEAN:
+        return PyBool_Check(pyobj) ? 0 : -1;
+    case AVRO_BYTES:
+        return is_pybytes(pyobj) ? 0 : -1;
+    case AVRO_STRING:
+        return is_pystring(pyobj) ? 0 : -1;
+    case AVRO_INT32:
+        return validate_int32(pyobj);
+    case AVRO_INT64:
+        return validate_int64(pyobj);
+    case AVRO_FLOAT:
+    case AVRO_DOUBLE:
+        return (is_pyint(pyobj) || PyLong_Check(pyobj) ||
+                PyFloat_Check(pyobj)) ? 0 : -1;
+    case AVRO_FIXED:
+        return validate_fixed(pyobj, node->size);
+    case AVRO_ENUM:
+        if (is_pystring(pyobj)) {
+            PyObject *index = PyDict_GetItem(node->symbols, pyobj);  /* borrowed */
+            return index != NULL ? (int)pyint_to_long(index) : -1;
+        } else if (is_pyint(pyobj)) {
+            long index = pyint_to_long(pyobj);
+            if (index == -1 && PyErr_Occurred()) {
+                PyErr_Clear();
+                return -1;
+            }
+            return (index >= 0 && index < (long)node->size) ? (int)index : -1;
+        }
+        return -1;
+    case AVRO_ARRAY:
+        {
+            Py_ssize_t n;
+            if (!PyList_Check(pyobj)) {
+                return -1;
+            }
+            for (n = 0; n < PyList_GET_SIZE(pyobj); n++) {
+                if (check(node->children[0], PyList_GET_ITEM(pyobj, n)) < 0) {
+                    return -1;
+                }
+            }
+            return 0;
+        }
+    case AVRO_MAP:
+        {
+            PyObject *key, *value;
+            Py_ssize_t pos = 0;
+            if (!PyDict_Check(pyobj)) {
+                return -1;
+            }
+            while (PyDict_Next(pyobj, &pos, &key, &value)) {
+                if (!is_pystring(key) || check(node->children[0], value) < 0) {
+                    return -1;
+                }
+            }
+            return 0;
+        }
+    case AVRO_UNION:
+        for (i = 0; i < node->size; i++) {
+            if (check(node->children[i], pyobj) >= 0) {
+                return (int)i;
+            }
+        }
+        return -1;
+    case AVRO_RECORD:
+        if (!PyDict_Check(pyobj)) {
+            return -1;
+        }
+        for (i = 0; i < node->size; i++) {
+            PyObject *value = PyDict_GetItem(pyobj, node->names[i]);  /* borrowed */
+            if (check(node->children[i], value != NULL ? value : Py_None) < 0) {
+                return -1;
+            }
+        }
+        return 0;
+    default:
+        return -1;
+    }
+}
+
+PyObject *
+validator_new(avro_schema_t schema)
+{
+    AvroValidator *self = PyObject_New(AvroValidator, &avroValidatorType);
+
+    if (self == NULL) {
+        return NULL;
+    }
+    self->schema = avro_schema_incref(schema);
+    self->nodes = NULL;
+    self->node_count = 0;
+    self->node_alloc = 0;
+
+    self->root = compile_node(self, schema);
+    if (self->root == NULL) {
+        Py_DECREF(self);
+        return NULL;
+    }
+    return (PyObject *)self;
+}
+
+static void
+AvroValidator_dealloc(AvroValidator *self)
+{
+    size_t i;
+
+    for (i = 0; i < self->node_count; i++) {
+        node_free(self->nodes[i]);
+    }
+    free(self->nodes);
+    avro_schema_decref(self->schema);
+    PyObject_Del(self);
+}
+
+static PyObject *
+AvroValidator_validate(AvroValidator *self, PyObject *args)
+{
+    PyObject *datum;
+
+    if (!PyArg_ParseTuple(args, "O", &datum)) {
+        return NULL;
+    }
+    return long_to_pyint(check(self->root, datum));
+}
+
+static PyObject *
+AvroValidator_validate_many(AvroValidator *self, PyObject *args, PyObject *kwds)
+{
+    PyObject *data;
+    PyObject *seq;
+    PyObject *result;
+    PyObject *item;
+    Py_ssize_t n;
+    Py_ssize_t i;
+    int rval;
+    int first_failure = 0;
+    static char *kwlist[] = {"data", "first_failure", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|i", kwlist,
+                                     &data, &first_failure)) {
+        return NULL;
+    }
+
+    seq = PySequence_Fast(data, "validate_many expects a sequence");
+    if (seq == NULL) {
+        return NULL;
+    }
+    n = PySequence_Fast_GET_SIZE(seq);
+
+    if (first_failure) {
+        for (i = 0; i < n; i++) {
+            if (check(self->root, PySequence_Fast_GET_ITEM(seq, i)) < 0) {
+                Py_DECREF(seq);
+                return PyLong_FromSsize_t(i);
+            }
+        }
+        Py_DECREF(seq);
+        Py_RETURN_NONE;
+    }
+
+    result = PyList_New(n);
+    if (result == NULL) {
+        Py_DECREF(seq);
+        return NULL;
+    }
+    for (i = 0; i < n; i++) {
+        rval = check(self->root, PySequence_Fast_GET_ITEM(seq, i));
+        item = long_to_pyint(rval);
+        if (item == NULL) {
+            Py_DECREF(result);
+            Py_DECREF(seq);
+            return NULL;
+        }
+        PyList_SET_ITEM(result, i, item);
+    }
+    Py_DECREF(seq);
+
+    return result;
+}
+
+static PyMethodDef AvroValidator_methods[] = {
+    {"validate", (PyCFunction)AvroValidator_validate, METH_VARARGS,
+     "validate(datum): the same result as pyavroc.validate(datum, schema)"
+    },
+    {"validate_many", (PyCFunction)AvroValidator_validate_many,
+     METH_VARARGS | METH_KEYWORDS,
+     "validate_many(data, first_failure=False): list of validate results,\n"
+     "one per datum.  With first_failure, instead return the position of\n"
+     "the first datum that doesn't match, or None if they all do."
+    },
+    {NULL}  /* Sentinel */
+};
+
+PyTypeObject avroValidatorType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "_pyavro.Validator",                 /* tp_name */
+    sizeof(AvroValidator),               /* tp_basicsize */
+    0,                                   /* tp_itemsize */
+    (destructor)AvroValidator_dealloc,   /* tp_dealloc */
+    0,                                   /* tp_print */
+    0,                                   /* tp_getattr */
+    0,                                   /* tp_setattr */
+    0,                                   /* tp_compare */
+    0,                                   /* tp_repr */
+    0,                                   /* tp_as_number */
+    0,                                   /* tp_as_sequence */
+    0,                                   /* tp_as_mapping */
+    0,                                   /* tp_hash */
+    0,                                   /* tp_call */
+    0,                                   /* tp_str */
+    0,                                   /* tp_getattro */
+    0,                                   /* tp_setattro */
+    0,                                   /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,                  /* tp_flags */
+    "Compiled schema validator, from Schema.validator()",  /* tp_doc */
+    0,                                   /* tp_traverse */
+    0,                                   /* tp_clear */
+    0,                                   /* tp_richcompare */
+    0,                                   /* tp_weaklistoffset */
+    0,                                   /* tp_iter */
+    0,                                   /* tp_iternext */
+    AvroValidator_methods,               /* tp_methods */
+};
@@ -0,0 +1,50 @@
+/*
+ * Copyright 2015 Byhiras (Europe) Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INC_VALIDATOR_H
+#define INC_VALIDATOR_H
+
+#include "Python.h"
+#include "avro.h"
+
+/*
+ * Schema compiled for validating Python data: the tree is walked once up
+ * front, so checking a datum doesn't go back to avro-c for field names or
+ * enum symbols.  Results are the same as validate().
+ */
+typedef struct ValidatorNode ValidatorNode;
+
+typedef struct {
+    PyObject_HEAD
+
+    avro_schema_t schema;
+    ValidatorNode *root;
+    ValidatorNode **nodes;  /* every node, for freeing */
+    size_t node_count;
+    size_t node_alloc;
+} AvroValidator;
+
+extern PyTypeObject avroValidatorType;
+
+/* returns a new validator for schema, or NULL with the error set */
+PyObject *validator_new(avro_schema_t schema);
+
+/* checks shared with validate(): 0 if pyobj fits, else -1 */
+int validate_int32(PyObject *pyobj);
+int validate_int64(PyObject *pyobj);
+int validate_fixed(PyObject *pyobj, size_t size);
+
+#endif
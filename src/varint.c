@@ -0,0 +1,492 @@
+/*
+ * Copyright 2015 Byhiras (Europe) Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "varint.h"
+
+#include <errno.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define VARINT_X86
+#include <immintrin.h>
+#endif
+
+typedef int (*decode_longs_fn)(const char **pos, const char *end,
+                               int64_t *out, size_t n);
+typedef int (*decode_ints_fn)(const char **pos, const char *end,
+                              int32_t *out, size_t n);
+
+static decode_longs_fn decode_longs = NULL;
+static decode_ints_fn decode_ints = NULL;
+static const char *kernel_name = NULL;
+
+static int64_t
+unzigzag(uint64_t n)
+{
+    return (int64_t)(n >> 1) ^ -(int64_t)(n & 1);
+}
+
+/* one varint, a byte at a time */
+static int
+decode_one(const unsigned char **pos, const unsigned char *end, uint64_t *n)
+{
+    const unsigned char *p = *pos;
+    uint64_t v = 0;
+    int shift = 0;
+    unsigned char c;
+
+    do {
+        if (p >= end || shift >= 64) {
+            return EILSEQ;
+        }
+        c = *p++;
+        v |= (uint64_t)(c & 0x7f) << shift;
+        shift += 7;
+    } while (c & 0x80);
+
+    *pos = p;
+    *n = v;
+    return 0;
+}
+
+static int
+scalar_longs(const char **pos, const char *end, int64_t *out, size_t n)
+{
+    const unsigned char *p = (const unsigned char *)*pos;
+    const unsigned char *e = (const unsigned char *)end;
+    uint64_t v;
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        if (decode_one(&p, e, &v)) {
+            return EILSEQ;
+        }
+        out[i] = unzigzag(v);
+    }
+
+    *pos = (const char *)p;
+    return 0;
+}
+
+/* zigzag encoded ints are below 2^32 */
+static int
+scalar_ints(const char **pos, const char *end, int32_t *out, size_t n)
+{
+    const unsigned char *p = (const unsigned char *)*pos;
+    const unsigned char *e = (const unsigned char *)end;
+    uint64_t v;
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        if (decode_one(&p, e, &v) || (v >> 32) != 0) {
+            return EILSEQ;
+        }
+        out[i] = (int32_t)unzigzag(v);
+    }
+
+    *pos = (const char *)p;
+    return 0;
+}
+
+#ifdef VARINT_X86
+
+/*
+ * Decode the varints ending within the window of bytes at *pos, at most
+ * max of them, into raw.  mask has a bit set for each byte of the window
+ * with the continuation bit, so where each varint starts and ends is
+ * known up front, and decoding one doesn't wait on the one before.
+ * Returns how many, leaving the rest to decode_one: a varint running on
+ * past the window, or one that is too long.
+ */
+static inline size_t
+decode_window(const unsigned char **pos, uint32_t mask, uint32_t full,
+              uint64_t *raw, size_t max)
+{
+    const unsigned char *p = *pos;
+    uint32_t ends = ~mask & full;
+    unsigned start = 0;
+    unsigned stop;
+    size_t count = 0;
+    uint64_t v;
+    unsigned i;
+
+    while (ends != 0 && count < max) {
+        stop = (unsigned)__builtin_ctz(ends);
+        if (stop - start >= 10) {
+            break;
+        }
+        v = p[stop];
+        for (i = stop; i > start; i--) {
+            v = (v << 7) | (p[i - 1] & 0x7f);
+        }
+        raw[count++] = v;
+        ends &= ends - 1;
+        start = stop + 1;
+    }
+
+    *pos = p + start;
+    return count;
+}
+
+/*
+ * The vector kernels look at the next sixteen or thirty two bytes.  If
+ * none has the continuation bit set they are all one byte values, which
+ * are widened and unzigzagged together.  Otherwise the varints ending in
+ * those bytes are picked out with the mask of continuation bits.
+ */
+
+__attribute__((target("sse4.1")))
+static int
+sse41_longs(const char **pos, const char *end, int64_t *out, size_t n)
+{
+    const unsigned char *p = (const unsigned char *)*pos;
+    const unsigned char *e = (const unsigned char *)end;
+    const __m128i one = _mm_set1_epi64x(1);
+    const __m128i zero = _mm_setzero_si128();
+    __m128i bytes;
+    __m128i v;
+    uint32_t mask;
+    uint64_t raw[16];
+    uint64_t u;
+    size_t got;
+    size_t i;
+
+    while (n > 0) {
+        if (n >= 16 && e - p >= 16) {
+            bytes = _mm_loadu_si128((const __m128i *)p);
+            mask = (uint32_t)_mm_movemask_epi8(bytes);
+            if (mask == 0) {
+                for (i = 0; i < 8; i++) {
+                    v = _mm_cvtepu8_epi64(bytes);
+                    v = _mm_xor_si128(_mm_srli_epi64(v, 1),
+                                      _mm_sub_epi64(zero, _mm_and_si128(v, one)));
+                    _mm_storeu_si128((__m128i *)out, v);
+                    bytes = _mm_srli_si128(bytes, 2);
+                    out += 2;
+                }
+                p += 16;
+                n -= 16;
+                continue;
+            }
+            got = decode_window(&p, mask, 0xffff, raw, n);
+            for (i = 0; i < got; i++) {
+                out[i] = unzigzag(raw[i]);
+            }
+            out += got;
+            n -= got;
+            if (got > 0) {
+                continue;
+            }
+        }
+        if (decode_one(&p, e, &u)) {
+            return EILSEQ;
+        }
+        *out++ = unzigzag(u);
+        n--;
+    }
+
+    *pos = (const char *)p;
+    return 0;
+}
+
+__attribute__((target("sse4.1")))
+static int
+sse41_ints(const char **pos, const char *end, int32_t *out, size_t n)
+{
+    const unsigned char *p = (const unsigned char *)*pos;
+    const unsigned char *e = (const unsigned char *)end;
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i zero = _mm_setzero_si128();
+    __m128i bytes;
+    __m128i v;
+    uint32_t mask;
+    uint64_t raw[16];
+    uint64_t u;
+    size_t got;
+    size_t i;
+
+    while (n > 0) {
+        if (n >= 16 && e - p >= 16) {
+            bytes = _mm_loadu_si128((const __m128i *)p);
+            mask = (uint32_t)_mm_movemask_epi8(bytes);
+            if (mask == 0) {
+                for (i = 0; i < 4; i++) {
+                    v = _mm_cvtepu8_epi32(bytes);
+                    v = _mm_xor_si128(_mm_srli_epi32(v, 1),
+                                      _mm_sub_epi32(zero, _mm_and_si128(v, one)));
+                    _mm_storeu_si128((__m128i *)out, v);
+                    bytes = _mm_srli_si128(bytes, 4);
+                    out += 4;
+                }
+                p += 16;
+                n -= 16;
+                continue;
+            }
+            got = decode_window(&p, mask, 0xffff, raw, n);
+            for (i = 0; i < got; i++) {
+                if ((raw[i] >> 32) != 0) {
+                    return EILSEQ;
+                }
+                out[i] = (int32_t)unzigzag(raw[i]);
+            }
+            out += got;
+            n -= got;
+            if (got > 0) {
+                continue;
+            }
+        }
+        if (decode_one(&p, e, &u) || (u >> 32) != 0) {
+            return EILSEQ;
+        }
+        *out++ = (int32_t)unzigzag(u);
+        n--;
+    }
+
+    *pos = (const char *)p;
+    return 0;
+}
+
+__attribute__((target("avx2")))
+static int
+avx2_longs(const char **pos, const char *end, int64_t *out, size_t n)
+{
+    const unsigned char *p = (const unsigned char *)*pos;
+    const unsigned char *e = (const unsigned char *)end;
+    const __m256i one = _mm256_set1_epi64x(1);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i bytes;
+    __m256i v;
+    __m128i half;
+    int h;
+    uint32_t mask;
+    uint64_t raw[32];
+    uint64_t u;
+    size_t got;
+    size_t i;
+
+    while (n > 0) {
+        if (n >= 32 && e - p >= 32) {
+            bytes = _mm256_loadu_si256((const __m256i *)p);
+            mask = (uint32_t)_mm256_movemask_epi8(bytes);
+            if (mask == 0) {
+                for (h = 0; h < 2; h++) {
+                    half = h ? _mm256_extracti128_si256(bytes, 1)
+                             : _mm256_castsi256_si128(bytes);
+                    for (i = 0; i < 4; i++) {
+                        v = _mm256_cvtepu8_epi64(half);
+                        v = _mm256_xor_si256(_mm256_srli_epi64(v, 1),
+                                             _mm256_sub_epi64(zero, _mm256_and_si256(v, one)));
+                        _mm256_storeu_si256((__m256i *)out, v);
+                        half = _mm_srli_si128(half, 4);
+                        out += 4;
+                    }
+                }
+                p += 32;
+                n -= 32;
+                continue;
+            }
+            got = decode_window(&p, mask, 0xffffffff, raw, n);
+            for (i = 0; i < got; i++) {
+                out[i] = unzigzag(raw[i]);
+            }
+            out += got;
+            n -= got;
+            if (got > 0) {
+                continue;
+            }
+        }
+        if (decode_one(&p, e, &u)) {
+            return EILSEQ;
+        }
+        *out++ = unzigzag(u);
+        n--;
+    }
+
+    *pos = (const char *)p;
+    return 0;
+}
+
+__attribute__((target("avx2")))
+static int
+avx2_ints(const char **pos, const char *end, int32_t *out, size_t n)
+{
+    const unsigned char *p = (const unsigned char *)*pos;
+    const unsigned char *e = (const unsigned char *)end;
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i bytes;
+    __m256i v;
+    __m128i half;
+    int h;
+    uint32_t mask;
+    uint64_t raw[32];
+    uint64_t u;
+    size_t got;
+    size_t i;
+
+    while (n > 0) {
+        if (n >= 32 && e - p >= 32) {
+            bytes = _mm256_loadu_si256((const __m256i *)p);
+            mask = (uint32_t)_mm256_movemask_epi8(bytes);
+            if (mask == 0) {
+                for (h = 0; h < 2; h++) {
+                    half = h ? _mm256_extracti128_si256(bytes, 1)
+                             : _mm256_castsi256_si128(bytes);
+                    for (i = 0; i < 2; i++) {
+                        v = _mm256_cvtepu8_epi32(half);
+                        v = _mm256_xor_si256(_mm256_srli_epi32(v, 1),
+                                             _mm256_sub_epi32(zero, _mm256_and_si256(v, one)));
+                        _mm256_storeu_si256((__m256i *)out, v);
+                        half = _mm_srli_si128(half, 8);
+                        out += 8;
+                    }
+                }
+                p += 32;
+                n -= 32;
+                continue;
+            }
+            got = decode_window(&p, mask, 0xffffffff, raw, n);
+            for (i = 0; i < got; i++) {
+                if ((raw[i] >> 32) != 0) {
+                    return EILSEQ;
+                }
+                out[i] = (int32_t)unzigzag(raw[i]);
+            }
+            out += got;
+            n -= got;
+            if (got > 0) {
+                continue;
+            }
+        }
+        if (decode_one(&p, e, &u) || (u >> 32) != 0) {
+            return EILSEQ;
+        }
+        *out++ = (int32_t)unzigzag(u);
+        n--;
+    }
+
+    *pos = (const char *)p;
+    return 0;
+}
+
+#endif
+
+int
+varint_use_kernel(const char *name)
+{
+    int is_auto = strcmp(name, "auto") == 0;
+
+#ifdef VARINT_X86
+    __builtin_cpu_init();
+    if ((is_auto || strcmp(name, "avx2") == 0)
+        && __builtin_cpu_supports("avx2")) {
+        decode_longs = avx2_longs;
+        decode_ints = avx2_ints;
+        kernel_name = "avx2";
+        return 0;
+    }
+    if ((is_auto || strcmp(name, "sse4.1") == 0)
+        && __builtin_cpu_supports("sse4.1")) {
+        decode_longs = sse41_longs;
+        decode_ints = sse41_ints;
+        kernel_name = "sse4.1";
+        return 0;
+    }
+#endif
+    if (is_auto || strcmp(name, "scalar") == 0) {
+        decode_longs = scalar_longs;
+        decode_ints = scalar_ints;
+        kernel_name = "scalar";
+        return 0;
+    }
+    return -1;
+}
+
+const char *
+varint_kernel_name(void)
+{
+    if (kernel_name == NULL) {
+        varint_use_kernel("auto");
+    }
+    return kernel_name;
+}
+
+int
+varint_decode_longs(const char **pos, const char *end, int64_t *out, size_t n)
+{
+    if (decode_longs == NULL) {
+        varint_use_kernel("auto");
+    }
+    return decode_longs(pos, end, out, n);
+}
+
+int
+varint_decode_ints(const char **pos, const char *end, int32_t *out, size_t n)
+{
+    if (decode_ints == NULL) {
+        varint_use_kernel("auto");
+    }
+    return decode_ints(pos, end, out, n);
+}
+
+int
+varint_decode_array(const char *buf, size_t len, int width, void *out,
+                    size_t n)
+{
+    const unsigned char *p = (const unsigned char *)buf;
+    const unsigned char *e = (const unsigned char *)buf + len;
+    const char *pos;
+    uint64_t u;
+    int64_t count;
+    size_t done = 0;
+    int rval;
+
+    for (;;) {
+        if (decode_one(&p, e, &u)) {
+            return EILSEQ;
+        }
+        count = unzigzag(u);
+        if (count == 0) {
+            break;
+        }
+        if (count < 0) {
+            /* followed by the block's size in bytes, which we don't need */
+            if (count == INT64_MIN || decode_one(&p, e, &u)) {
+                return EILSEQ;
+            }
+            count = -count;
+        }
+        if ((uint64_t)count > n - done) {
+            return EILSEQ;
+        }
+        pos = (const char *)p;
+        if (width == 4) {
+            rval = varint_decode_ints(&pos, (const char *)e,
+                                      (int32_t *)out + done, (size_t)count);
+        } else {
+            rval = varint_decode_longs(&pos, (const char *)e,
+                                       (int64_t *)out + done, (size_t)count);
+        }
+        if (rval) {
+            return rval;
+        }
+        p = (const unsigned char *)pos;
+        done += (size_t)count;
+    }
+
+    return done == n ? 0 : EILSEQ;
+}
@@ -0,0 +1,57 @@
+/*
+ * Copyright 2015 Byhiras (Europe) Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef INC_VARINT_H
+#define INC_VARINT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Decoding runs of zigzag varints, the Avro encoding of int and long,
+ * into native integers.  On x86 the kernel is chosen at run time from
+ * the SSE4.1 and AVX2 ones, which take runs of one byte values sixteen
+ * or thirty two at a time, with a plain loop as the fallback.
+ *
+ * The decode functions read n values starting at *pos and leave *pos
+ * after them.  They return 0, or EILSEQ if the input is truncated, a
+ * varint is too long, or an int is out of range.
+ */
+int varint_decode_longs(const char **pos, const char *end,
+                        int64_t *out, size_t n);
+
+int varint_decode_ints(const char **pos, const char *end,
+                       int32_t *out, size_t n);
+
+/*
+ * Decode an encoded Avro array of n ints (width 4) or longs (width 8),
+ * with its blocks, into out.  Returns 0, or EILSEQ if it doesn't hold
+ * exactly n items.
+ */
+int varint_decode_array(const char *buf, size_t len, int width,
+                        void *out, size_t n);
+
+/* "scalar", "sse4.1" or "avx2" */
+const char *varint_kernel_name(void);
+
+/*
+ * Use the named kernel, or "auto" for the best one this CPU supports.
+ * Returns 0, or -1 if it isn't available.  For benchmarks and tests.
+ */
+int varint_use_kernel(const char *name);
+
+#endif
@@ -0,0 +1,124 @@
+#!/usr/bin/env python
+
+# Copyright 2015 Byhiras (Europe) Limited
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+
+import os
+import sys
+import shutil
+import subprocess
+import tempfile
+
+import pytest
+
+import pyavroc
+
+
+SCHEMA = '''{
+    "type": "record",
+    "name": "Rec",
+    "fields": [ {"name": "attr1", "type": "int"},
+                {"name": "attr2", "type": "string"},
+                {"name": "attr3", "type": {"type": "array", "items": "long"}} ]
+    }'''
+
+
+def _run_fresh(name):
+    # the allocator is installed once per process, before Avro-C is used
+    env = dict(os.environ)
+    env['PYTHONPATH'] = os.pathsep.join(
+        [os.path.dirname(os.path.abspath(__file__))] + sys.path)
+    subprocess.check_call([sys.executable, '-c',
+                           'import test_allocator; test_allocator.%s()' % name],
+                          env=env)
+
+
+def check_modes():
+    dirname = tempfile.mkdtemp()
+    filename = os.path.join(dirname, 'test.avro')
+
+    recs = [{'attr1': i, 'attr2': 'hello %d' % i, 'attr3': list(range(i % 10))}
+            for i in range(5000)]
+
+    # "system" leaves Avro-C's own allocator in place
+    assert pyavroc.set_allocator('system') == 'system'
+    assert pyavroc.allocator_stats()['allocations'] == 0
+
+    for mode in ('pymem', 'arena', 'system'):
+        assert pyavroc.set_allocator(mode) in ('system', 'pymem', 'arena')
+        assert pyavroc.allocator_stats()['mode'] == mode
+
+        for codec in ('null', 'deflate'):
+            with open(filename, 'w') as fp:
+                writer = pyavroc.AvroFileWriter(fp, SCHEMA, codec=codec,
+                                                block_size=1024)
+                for rec in recs:
+                    writer.write(rec)
+                writer.close()
+
+            before = pyavroc.allocator_stats(reset_peak=True)
+            with open(filename) as fp:
+                reader = pyavroc.AvroFileReader(fp)
+                assert list(reader) == recs
+            del reader
+            after = pyavroc.allocator_stats()
+
+            assert after['peak_bytes'] > before['live_bytes']
+            assert after['allocations'] > before['allocations']
+            assert after['live_bytes'] == before['live_bytes']
+
+    shutil.rmtree(dirname)
+
+
+def check_switch():
+    # values made in one mode are freed correctly in another
+    pyavroc.set_allocator('arena')
+    serializer = pyavroc.AvroSerializer(SCHEMA)
+    pyavroc.set_allocator('pymem')
+    deserializer = pyavroc.AvroDeserializer(SCHEMA)
+    rec = {'attr1': 1, 'attr2': 'x' * 100000, 'attr3': [1, 2, 3]}
+    assert deserializer.deserialize(serializer.serialize(rec)) == rec
+    pyavroc.set_allocator('system')
+    serializer.close()
+    deserializer.close()
+
+    with pytest.raises(ValueError):
+        pyavroc.set_allocator('jemalloc')
+
+
+def check_too_late():
+    # Avro-C would free what it has already allocated through our allocator
+    serializer = pyavroc.AvroSerializer(SCHEMA)
+    with pytest.raises(RuntimeError):
+        pyavroc.set_allocator('arena')
+    with pytest.raises(RuntimeError):
+        pyavroc.set_allocator('pymem')
+    assert pyavroc.set_allocator('system') == 'system'
+    assert pyavroc.allocator_stats()['allocations'] == 0
+    rec = {'attr1': 1, 'attr2': 'x', 'attr3': []}
+    assert pyavroc.AvroDeserializer(SCHEMA).deserialize(
+        serializer.serialize(rec)) == rec
+
+
+def test_allocator_modes():
+    _run_fresh('check_modes')
+
+
+def test_allocator_switch():
+    _run_fresh('check_switch')
+
+
+def test_allocator_too_late():
+    _run_fresh('check_too_late')
@@ -106,3 +106,267 @@ def test_enum():
     deserializer = pyavroc.AvroDeserializer(schema)
     for s in symbols:
         assert deserializer.deserialize(serializer.serialize(s)) == s
+
+
+def test_strings():
+    schema = '{"type": "map", "values": "string"}'
+    serializer = pyavroc.AvroSerializer(schema)
+    deserializer = pyavroc.AvroDeserializer(schema)
+    strings = ['a' * n for n in range(40)]
+    # non-ASCII in each position, around the 16 and 32 byte boundaries
+    strings += [u'x' * i + u'\u00e9' + u'y' * (33 - i) for i in range(34)]
+    strings += [u'\u20ac', u'\U0001f600' * 5]
+    rec = dict((u'k%d\u00e8' % i, s) for i, s in enumerate(strings))
+
+    rec_bytes = serializer.serialize(rec)
+    assert rec_bytes == Serializer(schema).serialize(rec)
+    assert deserializer.deserialize(rec_bytes) == rec
+
+    with pytest.raises(TypeError):
+        serializer.serialize({'k': 1})
+    if sys.version_info >= (3,):
+        with pytest.raises(TypeError):
+            serializer.serialize({'k': b'bytes'})
+        with pytest.raises(ValueError):
+            serializer.serialize({'k': u'\ud800'})
+        # invalid UTF-8
+        with pytest.raises(ValueError):
+            deserializer.deserialize(b'\x02\x02k\x04a\xff\x00')
+
+
+def test_deserialize_many():
+    serializer = Serializer(SCHEMA)
+    deserializer = pyavroc.AvroDeserializer(SCHEMA)
+    records = [{'name': 'name-%d' % i, 'office': 'office-%d' % i,
+                'favorite_number': i if i % 2 else None} for i in range(100)]
+    datums = [serializer.serialize(rec) for rec in records]
+
+    assert deserializer.deserialize_many(datums) == records
+    assert deserializer.deserialize_many([]) == []
+    with pytest.raises(ValueError):
+        deserializer.deserialize_many(datums[:2] + [b'\x02'])
+
+
+def test_deserialize_stats():
+    serializer = pyavroc.AvroSerializer(SCHEMA)
+    deserializer = pyavroc.AvroDeserializer(SCHEMA)
+    records = [{'name': 'name-%d' % i, 'office': 'office-%d' % i,
+                'favorite_number': i} for i in range(100)]
+    data, offsets = serializer.serialize_many(records)
+    deserializer.deserialize_many(
+        [data[offsets[i]:offsets[i + 1]] for i in range(100)])
+
+    assert serializer.stats['records'] == 100
+    assert serializer.stats['uncompressed_bytes'] == len(data)
+    assert serializer.stats['allocations'] >= 1
+    assert deserializer.stats['records'] == 100
+    assert deserializer.stats['uncompressed_bytes'] == len(data)
+    assert deserializer.stats['decode_ns'] > 0
+    assert 'encode_ns' in serializer.stats
+
+
+def test_deserialize_stream():
+    serializer = Serializer(SCHEMA)
+    deserializer = pyavroc.AvroDeserializer(SCHEMA)
+    records = [{'name': 'name-%d' % i, 'office': 'office-%d' % i,
+                'favorite_number': i if i % 2 else None} for i in range(100)]
+    datums = [serializer.serialize(rec) for rec in records]
+    buf = b''.join(datums)
+
+    assert deserializer.deserialize_stream(buf) == (records, len(buf))
+    assert deserializer.deserialize_stream(buf, count=10) == \
+        (records[:10], len(b''.join(datums[:10])))
+    assert deserializer.deserialize_stream(b'') == ([], 0)
+
+    # a partial datum at the end
+    with pytest.raises(ValueError):
+        deserializer.deserialize_stream(buf[:-1])
+    with pytest.raises(ValueError):
+        deserializer.deserialize_stream(buf, count=101)
+
+    # null datums take no bytes, so only a count says when to stop
+    deserializer = pyavroc.AvroDeserializer('"null"')
+    with pytest.raises(ValueError):
+        deserializer.deserialize_stream(b'\x00')
+    assert deserializer.deserialize_stream(b'\x00', count=3) == ([None] * 3, 0)
+    assert deserializer.deserialize_stream(b'') == ([], 0)
+
+
+def test_deserialize_buffers():
+    serializer = Serializer(SCHEMA)
+    deserializer = pyavroc.AvroDeserializer(SCHEMA)
+    record = {'name': 'name', 'office': 'office', 'favorite_number': 42}
+    rec_bytes = serializer.serialize(record)
+
+    # slices of a larger receive buffer, without copying
+    recv_buf = bytearray(b'\xff' * 3 + rec_bytes * 2)
+    view = memoryview(recv_buf)
+    assert deserializer.deserialize(bytearray(rec_bytes)) == record
+    assert deserializer.deserialize(view[3:3 + len(rec_bytes)]) == record
+    assert deserializer.deserialize_many(
+        [view[3:3 + len(rec_bytes)], bytearray(rec_bytes)]) == [record, record]
+    assert deserializer.deserialize_stream(view[3:]) == \
+        ([record, record], 2 * len(rec_bytes))
+
+
+def test_reader_schema():
+    reader_schema = '''{
+      "type": "record",
+      "name": "User",
+      "fields": [
+        {"name": "name", "type": "string"},
+        {"name": "favorite_number",  "type": ["long", "null"]}
+      ]
+    }'''
+    serializer = Serializer(SCHEMA)
+    deserializer = pyavroc.AvroDeserializer(SCHEMA, reader_schema=reader_schema)
+    obj_deserializer = pyavroc.AvroDeserializer(SCHEMA, types=True,
+                                                reader_schema=reader_schema)
+    for i in range(10):
+        rec_bytes = serializer.serialize(
+            {'name': 'name-%d' % i, 'office': 'office-%d' % i,
+             'favorite_number': i})
+        expected = {'name': 'name-%d' % i, 'favorite_number': i}
+        assert deserializer.deserialize(rec_bytes) == expected
+        assert deserializer.deserialize_stream(rec_bytes * 2) == \
+            ([expected, expected], 2 * len(rec_bytes))
+        rec = obj_deserializer.deserialize(rec_bytes)
+        assert rec.name == 'name-%d' % i
+        assert not hasattr(rec, 'office')
+
+    with pytest.raises(ValueError):
+        pyavroc.AvroDeserializer(SCHEMA, reader_schema='"int"')
+
+
+def test_reader_schema_shared():
+    # the same pair of schemas with different formatting, and a different
+    # reader schema for the same writer
+    names_only = '{"type": "record", "name": "User", "fields": [{"name": "name", "type": "string"}]}'
+    spaced = json.dumps(json.loads(names_only), indent=4)
+    offices = '{"type": "record", "name": "User", "fields": [{"name": "office", "type": "string"}]}'
+    serializer = Serializer(SCHEMA)
+    rec_bytes = serializer.serialize({'name': 'name', 'office': 'office',
+                                      'favorite_number': 1})
+
+    deserializers = [pyavroc.AvroDeserializer(SCHEMA, reader_schema=reader)
+                     for reader in (names_only, spaced, offices) * 3]
+    for i, deserializer in enumerate(deserializers):
+        if i % 3 == 2:
+            assert deserializer.deserialize(rec_bytes) == {'office': 'office'}
+        else:
+            assert deserializer.deserialize(rec_bytes) == {'name': 'name'}
+    del deserializers
+    assert pyavroc.AvroDeserializer(SCHEMA, reader_schema=spaced) \
+        .deserialize(rec_bytes) == {'name': 'name'}
+
+
+def test_single_object():
+    old_schema = '''{
+      "type": "record",
+      "name": "User",
+      "fields": [
+        {"name": "office", "type": "string"},
+        {"name": "name", "type": "string"}
+      ]
+    }'''
+    reader_schema = '''{
+      "type": "record",
+      "name": "User",
+      "fields": [
+        {"name": "name", "type": "string"}
+      ]
+    }'''
+    serializer = pyavroc.AvroSerializer(SCHEMA, single_object=True)
+    old_serializer = pyavroc.AvroSerializer(old_schema, single_object=True)
+    rec = {'name': 'name', 'office': 'office', 'favorite_number': 7}
+    rec_bytes = serializer.serialize(rec)
+    old_rec_bytes = old_serializer.serialize({'name': 'old', 'office': 'x'})
+
+    deserializer = pyavroc.AvroDeserializer(SCHEMA, single_object=True)
+    assert deserializer.deserialize(rec_bytes) == rec
+    assert deserializer.deserialize_stream(rec_bytes * 2) == \
+        ([rec, rec], 2 * len(rec_bytes))
+    with pytest.raises(ValueError):
+        deserializer.deserialize(old_rec_bytes)
+    with pytest.raises(ValueError):
+        deserializer.deserialize(rec_bytes[10:])
+
+    deserializer.add_schema(old_schema)
+    assert deserializer.deserialize_many([rec_bytes, old_rec_bytes]) == \
+        [rec, {'name': 'old', 'office': 'x'}]
+
+    # each writer schema is resolved to the reader schema
+    deserializer = pyavroc.AvroDeserializer(SCHEMA, single_object=True,
+                                            reader_schema=reader_schema)
+    deserializer.add_schema(old_schema)
+    assert deserializer.deserialize_many([rec_bytes, old_rec_bytes]) == \
+        [{'name': 'name'}, {'name': 'old'}]
+
+    with pytest.raises(ValueError):
+        pyavroc.AvroDeserializer(SCHEMA).add_schema(old_schema)
+
+
+def _confluent(schema_id, rec_bytes):
+    return b'\x00' + bytes(bytearray([(schema_id >> 24) & 0xff,
+                                      (schema_id >> 16) & 0xff,
+                                      (schema_id >> 8) & 0xff,
+                                      schema_id & 0xff])) + rec_bytes
+
+
+def test_multi_schema():
+    other_schema = '["null", "long"]'
+    rec = {'name': 'name', 'office': 'office', 'favorite_number': 7}
+    msg1 = _confluent(1, Serializer(SCHEMA).serialize(rec))
+    msg2 = _confluent(70000, Serializer(other_schema).serialize(42))
+
+    deserializer = pyavroc.MultiSchemaDeserializer({1: SCHEMA, 70000: other_schema})
+    assert deserializer.deserialize(msg1) == rec
+    assert deserializer.deserialize(memoryview(msg2)) == 42
+    assert deserializer.deserialize_many([msg1, msg2, msg1]) == [rec, 42, rec]
+
+    with pytest.raises(ValueError):
+        deserializer.deserialize(_confluent(2, b''))
+    with pytest.raises(ValueError):
+        deserializer.deserialize(b'\x01' + msg1[1:])
+    with pytest.raises(ValueError):
+        deserializer.deserialize(msg1[:3])
+
+    # the callback is only asked once per id
+    asked = []
+
+    def lookup(schema_id):
+        asked.append(schema_id)
+        return {1: SCHEMA}.get(schema_id)
+
+    deserializer = pyavroc.MultiSchemaDeserializer(lookup=lookup, types=True)
+    assert deserializer.deserialize(msg1).name == 'name'
+    assert deserializer.deserialize(msg1).office == 'office'
+    assert asked == [1]
+    with pytest.raises(ValueError):
+        deserializer.deserialize(msg2)
+    deserializer.add_schema(70000, other_schema)
+    assert deserializer.deserialize(msg2) == 42
+
+    # a callback that closes the deserializer
+    def closing_lookup(schema_id):
+        deserializer.close()
+        return SCHEMA
+
+    deserializer = pyavroc.MultiSchemaDeserializer(lookup=closing_lookup)
+    with pytest.raises(IOError):
+        deserializer.deserialize(msg1)
+    with pytest.raises(IOError):
+        deserializer.deserialize(msg1)
+    with pytest.raises(IOError):
+        deserializer.add_schema(1, SCHEMA)
+
+    reader_schema = '''{
+      "type": "record",
+      "name": "User",
+      "fields": [{"name": "name", "type": "string"}]
+    }'''
+    deserializer = pyavroc.MultiSchemaDeserializer({1: SCHEMA},
+                                                   reader_schema=reader_schema)
+    assert deserializer.deserialize(msg1) == {'name': 'name'}
+    with pytest.raises(ValueError):
+        deserializer.add_schema(70000, other_schema)
@@ -95,6 +95,52 @@ def test_serialize_union():
         assert deserializer.deserialize(serializer.serialize(datum)) == datum
 
 
+def test_serialize_union_int_range():
+    schema = '["int", "long"]'
+    serializer = pyavroc.AvroSerializer(schema)
+    deserializer = pyavroc.AvroDeserializer(schema)
+    for datum in 0, 2 ** 31 - 1, 2 ** 31, -2 ** 31, -2 ** 31 - 1, 2 ** 62:
+        assert pyavroc.validate(datum, schema) == \
+            (0 if -2 ** 31 <= datum < 2 ** 31 else 1)
+        assert deserializer.deserialize(serializer.serialize(datum)) == datum
+    assert serializer.serialize(5)[:1] == b'\x00'
+    assert serializer.serialize(2 ** 31)[:1] == b'\x02'
+    with pytest.raises(ValueError):
+        pyavroc.AvroSerializer('["int", "null"]').serialize(2 ** 31)
+
+
+def test_serialize_union_of_dicts_errors():
+    schema = """\
+    {"type": "record",
+    "name": "Outer",
+    "fields": [{"name": "inner",
+                "type": [{"type": "record", "name": "A",
+                          "fields": [{"name": "a", "type": "double"}]},
+                         {"type": "record", "name": "B",
+                          "fields": [{"name": "b", "type": ["null", "double"]}]}]}]}
+    """
+    serializer = pyavroc.AvroSerializer(schema)
+
+    class OutOfMemory(object):
+        def __float__(self):
+            raise MemoryError('no memory')
+
+    # an object is matched to the record branch by its class name
+    class A(object):
+        def __getattr__(self, name):
+            raise RuntimeError('broken')
+
+    # a dict that doesn't fit the first branch is tried against the next
+    assert serializer.serialize({"inner": {"b": 1.0}}) == \
+        b'\x02\x02' + serializer.serialize({"inner": {"a": 1.0}})[1:]
+    # but other errors are passed on
+    with pytest.raises(MemoryError):
+        serializer.serialize({"inner": {"a": OutOfMemory()}})
+    with pytest.raises(ValueError) as excinfo:
+        serializer.serialize({"inner": A()})
+    assert 'broken' in str(excinfo.value)
+
+
 def test_unicode_map_keys():
     schema = """\
     {"type": "record",
@@ -143,3 +189,169 @@ def test_serialize_reuse_record_type():
             }
     obytes = ser.serialize(datum)
     assert obytes
+
+
+def test_serialize_many():
+    avtypes = pyavroc.create_types(SCHEMA)
+    serializer = pyavroc.AvroSerializer(SCHEMA)
+    recs = [avtypes.User(name="name-%d" % i, office="office-%d" % i,
+                         favorite_number=i if i % 2 else None)
+            for i in range(100)]
+    recs.append({"name": "X" * (1024 * 1024), "office": "", "favorite_number": 1})
+    data, offsets = serializer.serialize_many(recs)
+    assert len(offsets) == len(recs) + 1
+    assert offsets[0] == 0 and offsets[-1] == len(data)
+    view = memoryview(data)
+    for i, rec in enumerate(recs):
+        assert view[offsets[i]:offsets[i + 1]].tobytes() == serializer.serialize(rec)
+
+    data, offsets = serializer.serialize_many([])
+    assert data == b'' and list(offsets) == [0]
+
+    with pytest.raises(ValueError):
+        serializer.serialize_many(recs[:3] + [{"name": 1}])
+    with pytest.raises(TypeError):
+        serializer.serialize_many(1)
+
+
+def test_serialize_into():
+    serializer = pyavroc.AvroSerializer(SCHEMA)
+    rec = {"name": "name", "office": "office", "favorite_number": 42}
+    expected = serializer.serialize(rec)
+
+    buf = bytearray(100)
+    n = serializer.serialize_into(rec, buf)
+    assert n == len(expected)
+    n2 = serializer.serialize_into(rec, buf, offset=n)
+    assert bytes(buf[:n + n2]) == expected * 2
+
+    buf = bytearray(len(expected) + 2)
+    assert serializer.serialize_into(rec, memoryview(buf)[1:], 1) == len(expected)
+    assert bytes(buf[2:]) == expected
+
+    assert serializer.size(rec) == len(expected)
+    with pytest.raises(ValueError) as excinfo:
+        serializer.serialize_into(rec, bytearray(serializer.size(rec) - 1))
+    assert 'need %d bytes' % len(expected) in str(excinfo.value)
+    buf = bytearray(serializer.size(rec))
+    assert serializer.serialize_into(rec, buf) == len(buf)
+    assert bytes(buf) == expected
+
+    # the single object header counts too
+    framed = pyavroc.AvroSerializer(SCHEMA, single_object=True)
+    assert framed.size(rec) == len(framed.serialize(rec))
+    with pytest.raises(ValueError):
+        serializer.size({"name": 1})
+    with pytest.raises(ValueError):
+        serializer.serialize_into(rec, bytearray(10), 11)
+    with pytest.raises(TypeError):
+        serializer.serialize_into(rec, b'read only buffer')
+
+
+def test_buffer_shrinks():
+    serializer = pyavroc.AvroSerializer(SCHEMA)
+    initial_size = serializer.buffer_size
+    long_str = 'X' * (10 * 1024 * 1024)
+    big = {"name": long_str, "office": long_str}
+    small = {"name": "name", "office": "office"}
+    assert len(serializer.serialize(big)) > 2 * len(long_str)
+    assert serializer.buffer_size > 2 * len(long_str)
+    for i in range(100):
+        serializer.serialize(small)
+    assert serializer.buffer_size == initial_size
+    assert len(serializer.serialize(big)) > 2 * len(long_str)
+
+
+def _rabin(data):
+    empty = 0xc15d213aa4d7a795
+    fp = empty
+    for b in bytearray(data):
+        for i in range(8):
+            if (fp ^ b) & 1:
+                fp = (fp >> 1) ^ empty
+            else:
+                fp >>= 1
+            b >>= 1
+    return fp
+
+
+def test_serialize_single_object():
+    canonical = ('{"name":"User","type":"record","fields":['
+                 '{"name":"office","type":"string"},'
+                 '{"name":"name","type":"string"},'
+                 '{"name":"favorite_number","type":["int","null"]}]}')
+    fingerprint = _rabin(canonical.encode('ascii'))
+    header = b'\xc3\x01' + bytes(bytearray((fingerprint >> (8 * i)) & 0xff
+                                           for i in range(8)))
+
+    serializer = pyavroc.AvroSerializer(SCHEMA)
+    so_serializer = pyavroc.AvroSerializer(SCHEMA, single_object=True)
+    rec = {"name": "name", "office": "office", "favorite_number": 1}
+    rec_bytes = serializer.serialize(rec)
+    assert so_serializer.serialize(rec) == header + rec_bytes
+
+    data, offsets = so_serializer.serialize_many([rec, rec])
+    assert data == (header + rec_bytes) * 2
+    assert list(offsets) == [0, len(header + rec_bytes), len(data)]
+
+    buf = bytearray(100)
+    assert so_serializer.serialize_into(rec, buf, 1) == len(header + rec_bytes)
+    assert bytes(buf[1:1 + len(header + rec_bytes)]) == header + rec_bytes
+
+
+def test_schema_object():
+    canonical = ('{"name":"User","type":"record","fields":['
+                 '{"name":"office","type":"string"},'
+                 '{"name":"name","type":"string"},'
+                 '{"name":"favorite_number","type":["int","null"]}]}')
+    schema = pyavroc.Schema(SCHEMA)
+    assert pyavroc.Schema(SCHEMA) is schema
+    assert schema.json == SCHEMA
+    assert schema.canonical_form == canonical
+    assert schema.fingerprint == _rabin(canonical.encode('ascii'))
+
+    rec = {"name": "name", "office": "office", "favorite_number": 1}
+    rec_bytes = pyavroc.AvroSerializer(SCHEMA).serialize(rec)
+    assert pyavroc.AvroSerializer(schema).serialize(rec) == rec_bytes
+    deserializer = pyavroc.AvroDeserializer(schema, reader_schema=schema)
+    assert deserializer.deserialize(rec_bytes).name == "name"
+    assert pyavroc.validate(rec, schema) == 0
+    assert hasattr(pyavroc.create_types(schema), 'User')
+
+    with pytest.raises(IOError):
+        pyavroc.Schema('{"type": "nosuchtype"}')
+    with pytest.raises(TypeError):
+        pyavroc.Schema(1)
+
+
+def test_serialize_checks():
+    serializer = pyavroc.AvroSerializer(SCHEMA)
+    with pytest.raises(ValueError) as excinfo:
+        serializer.serialize({"name": "name"})
+    assert "when writing to User.office, missing required field" \
+        in str(excinfo.value)
+    with pytest.raises(ValueError) as excinfo:
+        serializer.serialize({"name": "name", "office": "office",
+                              "favorite_number": 2 ** 31})
+    assert "when writing to User.favorite_number, " in str(excinfo.value)
+
+    schema = '''{"type": "record", "name": "Outer", "fields": [
+        {"name": "items", "type": {"type": "array", "items":
+            {"type": "record", "name": "Inner",
+             "fields": [{"name": "x", "type": "int"}]}}},
+        {"name": "extra", "type": [
+            {"type": "record", "name": "Point",
+             "fields": [{"name": "x", "type": "int"},
+                        {"name": "y", "type": "int"}]},
+            {"type": "map", "values": "string"}]}]}'''
+    serializer = pyavroc.AvroSerializer(schema)
+    deserializer = pyavroc.AvroDeserializer(schema)
+    with pytest.raises(TypeError) as excinfo:
+        serializer.serialize({"items": [{"x": 1}, {"x": "one"}],
+                              "extra": {}})
+    assert "when writing to Outer.items[1].x, " in str(excinfo.value)
+
+    # a dict that isn't a Point is written as the map
+    for extra in ({"x": 1, "y": 2}, {"x": "1", "y": "2"}):
+        datum = {"items": [], "extra": extra}
+        assert deserializer.deserialize(serializer.serialize(datum)) == datum
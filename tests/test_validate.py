@@ -16,7 +16,7 @@
 
 import sys
 
-from pyavroc import validate
+from pyavroc import validate, Schema
 
 # Based on the test_io module from the official Python API.  One
 # difference is that the C-level JSON parser expects a top-level '{'
@@ -70,3 +70,46 @@ def test_validate_recursive():
     """
     datum = {'value': {'car': {'value': 'head'}, 'cdr': {'value': None}}}
     assert validate(datum, schema) == 0
+
+
+def test_validator():
+    for schema, datum, exp_res in TEST_CASES:
+        validator = Schema(schema).validator()
+        assert validator.validate(datum) == exp_res
+        assert validator.validate_many([datum, datum]) == [exp_res, exp_res]
+
+
+def test_validator_recursive():
+    schema = """\
+    {"type": "record",
+    "name": "Lisp",
+    "fields": [{"name": "value",
+                "type": ["null", "string",
+                         {"type": "record",
+                          "name": "Cons",
+                          "fields": [{"name": "car", "type": "Lisp"},
+                                     {"name": "cdr", "type": "Lisp"}]}]}]}
+    """
+    validator = Schema(schema).validator()
+    assert Schema(schema).validator() is validator
+    good = {'value': {'car': {'value': 'head'}, 'cdr': {'value': None}}}
+    bad = {'value': {'car': {'value': 1}, 'cdr': {'value': None}}}
+    assert validator.validate_many([good, bad, good]) == [0, -1, 0]
+    assert validator.validate_many([good, good, bad],
+                                   first_failure=True) == 2
+    assert validator.validate_many([good, good], first_failure=True) is None
+
+
+def test_validate_ranges():
+    for validator in (lambda d, s: validate(d, s),
+                      lambda d, s: Schema(s).validator().validate(d)):
+        assert validator(2 ** 31 - 1, '["int"]') == 0
+        assert validator(2 ** 31, '["int"]') == -1
+        assert validator(-2 ** 31 - 1, '["int"]') == -1
+        assert validator(2 ** 31, '["int", "long"]') == 1
+        assert validator(2 ** 63 - 1, '["long"]') == 0
+        assert validator(2 ** 63, '["long"]') == -1
+        fixed = '{"type": "fixed", "name": "Test", "size": 2}'
+        assert validator('AB', fixed) == 0
+        assert validator('A', fixed) == -1
+        assert validator('ABC', fixed) == -1
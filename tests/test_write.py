@@ -20,6 +20,8 @@ import os
 import shutil
 import tempfile
 import re
+import array
+import threading
 
 import pytest
 
@@ -305,3 +307,688 @@ def test_bad_file_type():
     with pytest.raises(TypeError):
         # try to open a reader on a list
         reader = pyavroc.AvroFileReader(list(), types=av_types)
+
+def test_write_threads():
+    schema = '''{
+        "type": "record",
+        "name": "Rec",
+        "fields": [ {"name": "attr1", "type": "int"},
+                    {"name": "attr2", "type": "string"} ]
+        }'''
+
+    dirname = tempfile.mkdtemp()
+    filename = os.path.join(dirname, 'test.avro')
+
+    recs = [{'attr1': i, 'attr2': 'hello %d' % i} for i in range(10000)]
+
+    for threads in (1, 2, 4):
+        with open(filename, 'w') as fp:
+            writer = pyavroc.AvroFileWriter(fp, schema, codec='deflate',
+                                            block_size=1024, threads=threads)
+            for rec in recs:
+                writer.write(rec)
+            writer.close()
+
+        with open(filename) as fp:
+            reader = pyavroc.AvroFileReader(fp)
+            read_recs = list(reader)
+
+        assert read_recs == recs
+
+    with pytest.raises(ValueError):
+        with open(filename, 'w') as fp:
+            pyavroc.AvroFileWriter(fp, schema, codec='snappy', threads=2)
+
+    shutil.rmtree(dirname)
+
+def test_read_pipe():
+    schema = '''{
+        "type": "record",
+        "name": "Rec",
+        "fields": [ {"name": "attr1", "type": "int"},
+                    {"name": "attr2", "type": "string"} ]
+        }'''
+
+    dirname = tempfile.mkdtemp()
+    filename = os.path.join(dirname, 'test.avro')
+
+    recs = [{'attr1': i, 'attr2': 'hello %d' % i} for i in range(10000)]
+
+    for codec in ('null', 'deflate', 'snappy', 'lzma'):
+        try:
+            with open(filename, 'w') as fp:
+                writer = pyavroc.AvroFileWriter(fp, schema, codec=codec)
+                for rec in recs:
+                    writer.write(rec)
+                writer.close()
+        except (IOError, ValueError):
+            # not built into this Avro-C
+            continue
+
+        with open(filename, 'rb') as fp:
+            data = fp.read()
+
+        rfd, wfd = os.pipe()
+
+        def feed():
+            with os.fdopen(wfd, 'wb') as fp:
+                fp.write(data)
+
+        feeder = threading.Thread(target=feed)
+        feeder.start()
+        with os.fdopen(rfd, 'rb') as fp:
+            reader = pyavroc.AvroFileReader(fp)
+            # only readable once, so no raw datums
+            with pytest.raises(IOError):
+                reader.iter_raw()
+            read_recs = list(reader)
+            del reader
+        feeder.join()
+
+        assert read_recs == recs
+
+    shutil.rmtree(dirname)
+
+def test_write_append():
+    schema = '''{
+        "type": "record",
+        "name": "Rec",
+        "fields": [ {"name": "attr1", "type": "int"} ]
+        }'''
+
+    dirname = tempfile.mkdtemp()
+    filename = os.path.join(dirname, 'test.avro')
+
+    # appending to an empty file starts a new one
+    with open(filename, 'a+') as fp:
+        writer = pyavroc.AvroFileWriter(fp, schema, codec='deflate',
+                                        mode='append')
+        writer.write({'attr1': 1})
+        writer.close()
+
+    # the schema comes from the file
+    with open(filename, 'r+') as fp:
+        writer = pyavroc.AvroFileWriter(fp, mode='append')
+        writer.write({'attr1': 2})
+        writer.write({'attr1': 3})
+        writer.close()
+
+    with open(filename, 'a+') as fp:
+        writer = pyavroc.AvroFileWriter(fp, schema, mode='append', threads=2)
+        writer.write({'attr1': 4})
+        writer.close()
+
+    with open(filename) as fp:
+        read_recs = list(pyavroc.AvroFileReader(fp))
+
+    assert read_recs == [{'attr1': i} for i in range(1, 5)]
+
+    with pytest.raises(ValueError):
+        with open(filename, 'r+') as fp:
+            pyavroc.AvroFileWriter(fp, '["null", "int"]', mode='append')
+
+    with pytest.raises(ValueError):
+        with open(filename, 'r+') as fp:
+            pyavroc.AvroFileWriter(fp, schema, mode='x')
+
+    shutil.rmtree(dirname)
+
+def test_write_raw():
+    schema = '''{
+        "type": "record",
+        "name": "Rec",
+        "fields": [ {"name": "attr1", "type": "int"},
+                    {"name": "attr2", "type": ["null", "string"]} ]
+        }'''
+
+    dirname = tempfile.mkdtemp()
+    filename = os.path.join(dirname, 'test.avro')
+
+    recs = [{'attr1': i, 'attr2': None if i % 2 else 'x' * i}
+            for i in range(100)]
+    serializer = pyavroc.AvroSerializer(schema)
+    datums = [serializer.serialize(rec) for rec in recs]
+
+    for threads in (1, 2):
+        with open(filename, 'w') as fp:
+            writer = pyavroc.AvroFileWriter(fp, schema, codec='deflate',
+                                            threads=threads)
+            writer.write_raw(datums[0])
+            writer.write_raw(bytearray(datums[1]), validate=True)
+            writer.write_raw_many(datums[2:50])
+            writer.write_raw_many(datums[50:], validate=True)
+
+            # a truncated datum, a bad union index and trailing garbage
+            for bad in (datums[2][:-1], b'\x02\x08', datums[3] + b'\x00'):
+                with pytest.raises(ValueError):
+                    writer.write_raw(bad, validate=True)
+            with pytest.raises(ValueError):
+                writer.write_raw_many([b'\x02\x08'], validate=True)
+            writer.close()
+
+        with open(filename) as fp:
+            read_recs = list(pyavroc.AvroFileReader(fp))
+
+        assert read_recs == recs
+
+    shutil.rmtree(dirname)
+
+def test_write_raw_sized_blocks():
+    schema = '''{
+        "type": "record",
+        "name": "Rec",
+        "fields": [ {"name": "items", "type": {"type": "array", "items": ["null", "int"]}},
+                    {"name": "flags", "type": {"type": "map", "values": "boolean"}} ]
+        }'''
+
+    dirname = tempfile.mkdtemp()
+    filename = os.path.join(dirname, 'test.avro')
+
+    # blocks with a negative count give their size in bytes
+    good = b'\x01\x02\x00\x00' + b'\x01\x06\x02k\x01\x00'
+
+    with open(filename, 'w') as fp:
+        writer = pyavroc.AvroFileWriter(fp, schema)
+        writer.write_raw(good, validate=True)
+
+        # a bad union index, a bad boolean, and a size that doesn't match
+        for bad in (b'\x01\x02\x08\x00\x00',
+                    b'\x00\x01\x06\x02k\x05\x00',
+                    b'\x01\x04\x00\x00\x00\x00'):
+            with pytest.raises(ValueError):
+                writer.write_raw(bad, validate=True)
+        writer.close()
+
+    with open(filename) as fp:
+        assert list(pyavroc.AvroFileReader(fp)) == [{'items': [None],
+                                                     'flags': {'k': True}}]
+
+    shutil.rmtree(dirname)
+
+def test_write_raw_huge_count():
+    schema = '''{
+        "type": "record",
+        "name": "Rec",
+        "fields": [ {"name": "nulls", "type": {"type": "array", "items": "null"}},
+                    {"name": "ints", "type": {"type": "array", "items": "int"}},
+                    {"name": "flags", "type": {"type": "map", "values": "null"}} ]
+        }'''
+
+    # a block count of 2 ** 62, zigzag encoded
+    huge = b'\x80' * 8 + b'\x80\x01'
+
+    dirname = tempfile.mkdtemp()
+    filename = os.path.join(dirname, 'test.avro')
+
+    with open(filename, 'w') as fp:
+        writer = pyavroc.AvroFileWriter(fp, schema)
+        # nulls take no bytes, so they are counted rather than walked
+        writer.write_raw(huge + b'\x00' + b'\x00' + b'\x00', validate=True)
+        # but every int and map key takes a byte at least
+        for bad in (b'\x00' + huge + b'\x00' + b'\x00',
+                    b'\x00' + b'\x00' + huge + b'\x00'):
+            with pytest.raises(ValueError):
+                writer.write_raw(bad, validate=True)
+        writer.close()
+
+    shutil.rmtree(dirname)
+
+def test_read_raw():
+    schema = '''{
+        "type": "record",
+        "name": "Rec",
+        "fields": [ {"name": "attr1", "type": "int"},
+                    {"name": "attr2", "type": ["null", "string"]} ]
+        }'''
+
+    dirname = tempfile.mkdtemp()
+    filename = os.path.join(dirname, 'test.avro')
+
+    recs = [{'attr1': i, 'attr2': None if i % 2 else 'x' * i}
+            for i in range(1000)]
+    serializer = pyavroc.AvroSerializer(schema)
+    datums = [serializer.serialize(rec) for rec in recs]
+
+    for codec in ('null', 'deflate'):
+        with open(filename, 'w') as fp:
+            writer = pyavroc.AvroFileWriter(fp, schema, codec=codec,
+                                            block_size=1024)
+            for rec in recs:
+                writer.write(rec)
+            writer.close()
+
+        with open(filename) as fp:
+            reader = pyavroc.AvroFileReader(fp)
+            assert list(reader.iter_raw()) == datums
+
+        # mixing decoded and raw reads
+        with open(filename) as fp:
+            reader = pyavroc.AvroFileReader(fp)
+            assert [next(reader) for i in range(3)] == recs[:3]
+            raw = reader.iter_raw()
+            assert [next(raw) for i in range(3)] == datums[3:6]
+            assert list(reader) == recs[6:]
+
+        with open(filename) as fp:
+            reader = pyavroc.AvroFileReader(fp)
+            next(reader)
+            batches = list(reader.iter_raw(blocks=True))
+
+        assert len(batches) > 1
+        read_datums = []
+        for data, offsets in batches:
+            assert offsets[0] == 0 and offsets[-1] == len(data)
+            read_datums.extend(data[offsets[i]:offsets[i + 1]]
+                               for i in range(len(offsets) - 1))
+        assert read_datums == datums[1:]
+
+    shutil.rmtree(dirname)
+
+def test_read_raw_codecs():
+    schema = '''{
+        "type": "record",
+        "name": "Rec",
+        "fields": [ {"name": "attr1", "type": "int"},
+                    {"name": "attr2", "type": "string"} ]
+        }'''
+
+    dirname = tempfile.mkdtemp()
+    filename = os.path.join(dirname, 'test.avro')
+
+    recs = [{'attr1': i, 'attr2': 'hello %d' % i} for i in range(3000)]
+    serializer = pyavroc.AvroSerializer(schema)
+    datums = [serializer.serialize(rec) for rec in recs]
+
+    for codec in ('null', 'deflate', 'snappy', 'lzma'):
+        try:
+            with open(filename, 'w') as fp:
+                writer = pyavroc.AvroFileWriter(fp, schema, codec=codec,
+                                                block_size=1024)
+                for rec in recs:
+                    writer.write(rec)
+                writer.close()
+        except (IOError, ValueError):
+            # not built into this Avro-C
+            continue
+
+        # Avro-C reads the first records, then hands over to the blocks
+        with open(filename) as fp:
+            reader = pyavroc.AvroFileReader(fp)
+            assert [next(reader) for i in range(1500)] == recs[:1500]
+            if codec in ('null', 'deflate'):
+                assert list(reader.iter_raw()) == datums[1500:]
+            else:
+                with pytest.raises(IOError):
+                    reader.iter_raw()
+                assert list(reader) == recs[1500:]
+
+    shutil.rmtree(dirname)
+
+def test_read_reader_schema():
+    schema = '''{
+        "type": "record",
+        "name": "Rec",
+        "fields": [ {"name": "attr1", "type": "int"},
+                    {"name": "attr2", "type": "string"} ]
+        }'''
+    reader_schema = '''{
+        "type": "record",
+        "name": "Rec",
+        "fields": [ {"name": "attr1", "type": "double"} ]
+        }'''
+
+    dirname = tempfile.mkdtemp()
+    filename = os.path.join(dirname, 'test.avro')
+
+    with open(filename, 'w') as fp:
+        writer = pyavroc.AvroFileWriter(fp, schema)
+        for i in range(10):
+            writer.write({'attr1': i, 'attr2': 'hello %d' % i})
+        writer.close()
+
+    with open(filename) as fp:
+        reader = pyavroc.AvroFileReader(fp, reader_schema=reader_schema)
+        read_recs = list(reader)
+
+    assert read_recs == [{'attr1': float(i)} for i in range(10)]
+
+    with pytest.raises(ValueError):
+        with open(filename) as fp:
+            pyavroc.AvroFileReader(fp, reader_schema='"string"')
+
+    shutil.rmtree(dirname)
+
+def test_stats():
+    schema = '''{
+        "type": "record",
+        "name": "Rec",
+        "fields": [ {"name": "attr1", "type": "int"},
+                    {"name": "attr2", "type": "string"} ]
+        }'''
+
+    dirname = tempfile.mkdtemp()
+    filename = os.path.join(dirname, 'test.avro')
+
+    recs = [{'attr1': i, 'attr2': 'hello %d' % i} for i in range(1000)]
+
+    with open(filename, 'w') as fp:
+        # blocks are only counted when pyavroc writes them itself
+        writer = pyavroc.AvroFileWriter(fp, schema, codec='deflate',
+                                        block_size=1024, threads=2)
+        for rec in recs:
+            writer.write(rec)
+        writer.close()
+    stats = writer.stats
+
+    assert stats['records'] == 1000
+    assert stats['blocks'] > 1
+    assert 0 < stats['compressed_bytes'] < stats['uncompressed_bytes']
+    assert stats['compress_ns'] > 0
+    assert stats['encode_ns'] > 0
+    assert stats['convert_ns'] > 0
+
+    with open(filename) as fp:
+        reader = pyavroc.AvroFileReader(fp)
+        assert reader.stats['records'] == 0
+        assert list(reader) == recs
+        read_stats = reader.stats
+
+    # Avro-C reads the blocks unless a feature needs them
+    assert read_stats['records'] == 1000
+    assert read_stats['blocks'] == 0
+    assert read_stats['decode_ns'] > 0
+
+    with open(filename) as fp:
+        reader = pyavroc.AvroFileReader(fp, bytes_views=True)
+        assert list(reader) == recs
+        read_stats = reader.stats
+
+    assert read_stats['records'] == 1000
+    assert read_stats['blocks'] == stats['blocks']
+    assert read_stats['compressed_bytes'] == stats['compressed_bytes']
+    assert read_stats['uncompressed_bytes'] == stats['uncompressed_bytes']
+    assert read_stats['decompress_ns'] > 0
+    assert read_stats['decode_ns'] > 0
+
+    shutil.rmtree(dirname)
+
+def test_read_bytes_views():
+    schema = '''{
+        "type": "record",
+        "name": "Blob",
+        "fields": [ {"name": "id", "type": "int"},
+                    {"name": "data", "type": "bytes"},
+                    {"name": "parts", "type": {"type": "array", "items": "bytes"}},
+                    {"name": "meta", "type": {"type": "map", "values": "bytes"}},
+                    {"name": "extra", "type": ["null", "bytes"]} ]
+        }'''
+
+    dirname = tempfile.mkdtemp()
+    filename = os.path.join(dirname, 'test.avro')
+
+    recs = [{'id': i, 'data': b'x' * i, 'parts': [b'a%d' % i, b''],
+             'meta': {'k': b'v%d' % i}, 'extra': None if i % 2 else b'e'}
+            for i in range(2000)]
+
+    for codec in ('null', 'deflate'):
+        with open(filename, 'w') as fp:
+            writer = pyavroc.AvroFileWriter(fp, schema, codec=codec,
+                                            block_size=4096)
+            for rec in recs:
+                writer.write(rec)
+            writer.close()
+
+        with open(filename) as fp:
+            reader = pyavroc.AvroFileReader(fp, bytes_views=True)
+            read_recs = list(reader)
+        del reader
+
+        for rec, read_rec in zip(recs, read_recs):
+            assert isinstance(read_rec['data'], memoryview)
+            assert read_rec['data'].readonly
+            assert isinstance(read_rec['parts'][0], memoryview)
+            assert isinstance(read_rec['meta']['k'], bytes)
+            # the views outlive the reader
+            assert read_rec['data'].tobytes() == rec['data']
+            assert [p.tobytes() for p in read_rec['parts']] == rec['parts']
+            assert read_rec['meta'] == rec['meta']
+            if rec['extra'] is None:
+                assert read_rec['extra'] is None
+            else:
+                assert read_rec['extra'].tobytes() == rec['extra']
+
+        with open(filename) as fp:
+            with pytest.raises(ValueError):
+                pyavroc.AvroFileReader(fp, reader_schema=schema,
+                                       bytes_views=True)
+
+    for codec in ('snappy', 'lzma'):
+        try:
+            with open(filename, 'w') as fp:
+                writer = pyavroc.AvroFileWriter(fp, schema, codec=codec)
+                writer.write(recs[0])
+                writer.close()
+        except (IOError, ValueError):
+            # not built into this Avro-C
+            continue
+
+        with open(filename) as fp:
+            with pytest.raises(ValueError):
+                pyavroc.AvroFileReader(fp, bytes_views=True)
+            fp.seek(0)
+            with pytest.raises(ValueError):
+                pyavroc.AvroFileReader(fp, typed_arrays=True)
+
+    shutil.rmtree(dirname)
+
+def test_read_typed_arrays():
+    schema = '''{
+        "type": "record",
+        "name": "Series",
+        "fields": [ {"name": "small", "type": {"type": "array", "items": "int"}},
+                    {"name": "large", "type": {"type": "array", "items": "long"}},
+                    {"name": "nested", "type": {"type": "array",
+                                                "items": {"type": "array", "items": "long"}}},
+                    {"name": "byname", "type": {"type": "map",
+                                                "values": {"type": "array", "items": "int"}}},
+                    {"name": "maybe", "type": ["null", {"type": "array", "items": "int"}]},
+                    {"name": "ratios", "type": {"type": "array", "items": "float"}},
+                    {"name": "values", "type": {"type": "array", "items": "double"}},
+                    {"name": "blob", "type": "bytes"} ]
+        }'''
+
+    dirname = tempfile.mkdtemp()
+    filename = os.path.join(dirname, 'test.avro')
+
+    recs = [{'small': [j % 100 - 50 for j in range(i % 70)],
+             'large': [(j - 3) * (1 << 40) + i for j in range(i % 7)],
+             'nested': [[i, -i], [], [1 << 62]],
+             'byname': {'k': [i, i + 1]},
+             'maybe': None if i % 2 else [-(1 << 31), (1 << 31) - 1],
+             'ratios': [j / 4.0 for j in range(i % 5)],
+             'values': [i * 1e100, -0.5] * (i % 40),
+             'blob': b'b%d' % i}
+            for i in range(2000)]
+
+    for codec in ('null', 'deflate'):
+        with open(filename, 'w') as fp:
+            writer = pyavroc.AvroFileWriter(fp, schema, codec=codec,
+                                            block_size=4096)
+            for rec in recs:
+                writer.write(rec)
+            writer.close()
+
+        for bytes_views in (False, True):
+            with open(filename) as fp:
+                reader = pyavroc.AvroFileReader(fp, typed_arrays=True,
+                                                bytes_views=bytes_views)
+                read_recs = list(reader)
+            del reader
+
+            for rec, read_rec in zip(recs, read_recs):
+                assert isinstance(read_rec['small'], array.array)
+                assert read_rec['small'].typecode == 'i'
+                assert isinstance(read_rec['large'], array.array)
+                assert read_rec['large'].itemsize == 8
+                assert isinstance(read_rec['nested'][0], array.array)
+                assert isinstance(read_rec['byname']['k'], list)
+                assert read_rec['ratios'].typecode == 'f'
+                assert read_rec['values'].typecode == 'd'
+                assert read_rec['small'].tolist() == rec['small']
+                assert read_rec['large'].tolist() == rec['large']
+                assert [a.tolist() for a in read_rec['nested']] == rec['nested']
+                assert read_rec['ratios'].tolist() == rec['ratios']
+                assert read_rec['values'].tolist() == rec['values']
+                assert read_rec['byname'] == rec['byname']
+                if rec['maybe'] is None:
+                    assert read_rec['maybe'] is None
+                else:
+                    assert read_rec['maybe'].tolist() == rec['maybe']
+                assert bytes(read_rec['blob']) == rec['blob']
+
+        with open(filename) as fp:
+            with pytest.raises(ValueError):
+                pyavroc.AvroFileReader(fp, reader_schema=schema,
+                                       typed_arrays=True)
+
+    shutil.rmtree(dirname)
+
+def test_read_dedup_strings():
+    schema = '''{
+        "type": "record",
+        "name": "Visit",
+        "fields": [ {"name": "id", "type": "string"},
+                    {"name": "country", "type": "string"},
+                    {"name": "tags", "type": {"type": "map", "values": "string"}},
+                    {"name": "referrer", "type": ["null", "string"]} ]
+        }'''
+
+    dirname = tempfile.mkdtemp()
+    filename = os.path.join(dirname, 'test.avro')
+
+    countries = ['GB', 'FR', u'C\u00f4te d\u2019Ivoire', 'x' * 300]
+    recs = [{'id': 'visit %d' % i,
+             'country': countries[i % len(countries)],
+             'tags': {'source': 'ad' if i % 2 else 'search'},
+             'referrer': None if i % 3 else 'example.com'}
+            for i in range(5000)]
+
+    with open(filename, 'w') as fp:
+        writer = pyavroc.AvroFileWriter(fp, schema)
+        for rec in recs:
+            writer.write(rec)
+        writer.close()
+
+    for dedup_strings, dedup_size in ((True, 1024), (True, 2),
+                                      (['country', 'referrer'], 1024)):
+        with open(filename) as fp:
+            reader = pyavroc.AvroFileReader(fp, dedup_strings=dedup_strings,
+                                            dedup_size=dedup_size)
+            read_recs = list(reader)
+            stats = reader.stats
+
+        assert read_recs == recs
+        if dedup_size == 1024:
+            # short strings are shared, long ones never cached
+            assert read_recs[0]['country'] is read_recs[4]['country']
+            assert read_recs[3]['country'] is not read_recs[7]['country']
+            assert read_recs[0]['referrer'] is read_recs[3]['referrer']
+            assert stats['string_cache_hits'] > 0
+            assert stats['string_cache_misses'] > 0
+        if dedup_strings is not True:
+            assert read_recs[0]['id'] is not read_recs[4]['id']
+            assert read_recs[1]['tags']['source'] is not read_recs[3]['tags']['source']
+
+    with open(filename) as fp:
+        reader = pyavroc.AvroFileReader(fp)
+        list(reader)
+        assert reader.stats['string_cache_hits'] == 0
+
+    with open(filename) as fp:
+        with pytest.raises(TypeError):
+            pyavroc.AvroFileReader(fp, dedup_strings='country')
+        with pytest.raises(ValueError):
+            pyavroc.AvroFileReader(fp, dedup_strings=True, dedup_size=0)
+
+    serializer = pyavroc.AvroSerializer(schema)
+    deserializer = pyavroc.AvroDeserializer(schema, types=True,
+                                            dedup_strings=['country'])
+    read_recs = [deserializer.deserialize(serializer.serialize(rec))
+                 for rec in recs[:10]]
+    assert read_recs[0].country == 'GB'
+    assert read_recs[0].country is read_recs[4].country
+    assert deserializer.stats['string_cache_hits'] == 5
+
+    shutil.rmtree(dirname)
+
+def test_read_into():
+    np = pytest.importorskip('numpy')
+
+    schema = '''{
+        "type": "record",
+        "name": "Reading",
+        "fields": [ {"name": "id", "type": "long"},
+                    {"name": "label", "type": "string"},
+                    {"name": "value", "type": ["null", "double"]},
+                    {"name": "count", "type": ["null", "int"]},
+                    {"name": "ok", "type": "boolean"},
+                    {"name": "level", "type": {"type": "enum", "name": "Level",
+                                               "symbols": ["LOW", "HIGH"]}} ]
+        }'''
+
+    dirname = tempfile.mkdtemp()
+    filename = os.path.join(dirname, 'test.avro')
+
+    recs = [{'id': i, 'label': 'sensor %d' % i,
+             'value': None if i % 5 == 0 else i / 2.0,
+             'count': None if i % 3 == 0 else i,
+             'ok': i % 2 == 0, 'level': ['LOW', 'HIGH'][i % 2]}
+            for i in range(1000)]
+
+    dtype = np.dtype([('id', 'i8'), ('value', 'f8'), ('count', 'i4'),
+                      ('count_null', '?'), ('ok', '?'), ('level', 'u1')])
+
+    for codec in ('null', 'deflate'):
+        with open(filename, 'w') as fp:
+            writer = pyavroc.AvroFileWriter(fp, schema, codec=codec,
+                                            block_size=1024)
+            for rec in recs:
+                writer.write(rec)
+            writer.close()
+
+        for reader_schema in (None, schema):
+            with open(filename) as fp:
+                reader = pyavroc.AvroFileReader(fp, reader_schema=reader_schema)
+                batch = np.zeros(300, dtype)
+                rows = []
+                while True:
+                    n = reader.read_into(batch)
+                    rows.extend(batch[:n].tolist())
+                    if n < len(batch):
+                        break
+
+            assert len(rows) == len(recs)
+            for rec, row in zip(recs, rows):
+                assert row[0] == rec['id']
+                if rec['value'] is None:
+                    assert np.isnan(row[1])
+                else:
+                    assert row[1] == rec['value']
+                assert row[2] == (rec['count'] or 0)
+                assert row[3] == (rec['count'] is None)
+                assert row[4] == rec['ok']
+                assert row[5] == ['LOW', 'HIGH'].index(rec['level'])
+
+    with open(filename) as fp:
+        reader = pyavroc.AvroFileReader(fp)
+        with pytest.raises(ValueError):
+            # nullable, with nowhere to put the null
+            reader.read_into(np.zeros(10, [('count', 'i4')]))
+        with pytest.raises(ValueError):
+            reader.read_into(np.zeros(10, [('label', 'i4')]))
+        with pytest.raises(ValueError):
+            reader.read_into(np.zeros(10, [('missing', 'i4')]))
+        with pytest.raises(ValueError):
+            reader.read_into(np.zeros(10, 'i8'))
+
+    shutil.rmtree(dirname)